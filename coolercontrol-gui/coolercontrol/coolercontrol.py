@@ -205,7 +205,10 @@ class Initialize(QMainWindow):
                     import PySide6
                     return Initialize._get_version_attribute(PySide6)
                 case "matplotlib":
-                    import matplotlib
+                    try:
+                        import matplotlib
+                    except ImportError:
+                        return "not installed"  # it is optional
                     return Initialize._get_version_attribute(matplotlib)
                 case "numpy":
                     import numpy
@@ -451,8 +454,6 @@ class MainWindow(QMainWindow):
         self.dynamic_buttons.uncheck_all_channel_buttons()
 
     def showEvent(self, event: QShowEvent) -> None:
-        if self.ui.system_overview_canvas.event_source:
-            self.ui.system_overview_canvas.event_source.interval = 100
         self.ui.system_overview_canvas.resume()
 
     def resizeEvent(self, event: QEvent) -> None:
@@ -15,15 +15,20 @@
 #  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 # ----------------------------------------------------------------------------------------------------------------------
 
+from __future__ import annotations
+
 from dataclasses import dataclass, field
+from typing import TYPE_CHECKING
 
 from PySide6.QtWidgets import QWidget
 
 from coolercontrol.models.speed_profile import SpeedProfile
 from coolercontrol.models.temp_source import TempSource
-from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
 from coolercontrol.view.uis.controls.ui_speed_control import Ui_SpeedControl
 
+if TYPE_CHECKING:
+    from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
+
 
 @dataclass(frozen=True)
 class SpeedDeviceControl:
@@ -16,13 +16,13 @@
 # ----------------------------------------------------------------------------------------------------------------------
 
 import dataclasses
+import json
 import logging
 from collections import defaultdict
 from datetime import timedelta, datetime
 from operator import attrgetter
 from typing import Optional
 
-import matplotlib
 import numpy
 import requests
 from dataclass_wizard import JSONWizard
@@ -38,10 +38,11 @@ from coolercontrol.models.base_driver import BaseDriver
 from coolercontrol.models.device import Device, DeviceType
 from coolercontrol.models.device_info import DeviceInfo
 from coolercontrol.models.settings import Setting, LightingSettings, LcdSettings
-from coolercontrol.models.status import Status
+from coolercontrol.models.status import Status, TempStatus, ChannelStatus
 from coolercontrol.models.temp_source import TempSource
 from coolercontrol.repositories.devices_repository import DevicesRepository
 from coolercontrol.services.settings_observer import SettingsObserver
+from coolercontrol.services.utils import ColorUtils
 from coolercontrol.settings import Settings, UserSettings
 
 log = logging.getLogger(__name__)
@@ -115,6 +116,82 @@ class StatusResponse(JSONWizard):
     devices: list[StatusDto]
 
 
+class StatusDecoder:
+    """
+    A schema-specific decoder for the status responses, which are requested every second and can contain the
+    whole status history. It avoids the reflection of the generic JSONWizard decoding and reuses the temp and
+    channel status objects, which are immutable, when they haven't changed since the last decoded status.
+    """
+
+    def __init__(self) -> None:
+        self._temps: dict[tuple[str, str], TempStatus] = {}
+        self._channels: dict[tuple[str, str], ChannelStatus] = {}
+
+    def decode(self, response_content: bytes | str) -> StatusResponse:
+        devices: list[StatusDto] = []
+        for device_json in json.loads(response_content)["devices"]:
+            uid: str = device_json["uid"]
+            devices.append(StatusDto(
+                type=DeviceType(device_json["type"]),
+                type_index=device_json["type_index"],
+                uid=uid,
+                status_history=[self._decode_status(uid, status_json) for status_json in device_json["status_history"]],
+            ))
+        return StatusResponse(devices=devices)
+
+    def _decode_status(self, uid: str, status_json: dict) -> Status:
+        return Status(
+            timestamp=self._parse_timestamp(status_json["timestamp"]),
+            firmware_version=status_json.get("firmware_version"),
+            temps=[self._decode_temp(uid, temp_json) for temp_json in status_json["temps"]],
+            channels=[self._decode_channel(uid, channel_json) for channel_json in status_json["channels"]],
+        )
+
+    def _decode_temp(self, uid: str, temp_json: dict) -> TempStatus:
+        key = (uid, temp_json["name"])
+        previous_temp = self._temps.get(key)
+        if previous_temp is not None and previous_temp.temp == temp_json["temp"]:
+            return previous_temp
+        temp_status = TempStatus(
+            name=temp_json["name"],
+            temp=temp_json["temp"],
+            frontend_name=temp_json["frontend_name"],
+            external_name=temp_json["external_name"],
+        )
+        self._temps[key] = temp_status
+        return temp_status
+
+    def _decode_channel(self, uid: str, channel_json: dict) -> ChannelStatus:
+        key = (uid, channel_json["name"])
+        rpm = channel_json.get("rpm")
+        duty = channel_json.get("duty")
+        pwm_mode = channel_json.get("pwm_mode")
+        previous_channel = self._channels.get(key)
+        if previous_channel is not None and previous_channel.rpm == rpm \
+                and previous_channel.duty == duty and previous_channel.pwm_mode == pwm_mode:
+            return previous_channel
+        channel_status = ChannelStatus(name=channel_json["name"], rpm=rpm, duty=duty, pwm_mode=pwm_mode)
+        self._channels[key] = channel_status
+        return channel_status
+
+    @staticmethod
+    def _parse_timestamp(timestamp: str) -> datetime:
+        """
+        The daemon sends RFC 3339 timestamps with up to 9 fractional digits,
+        while datetime.fromisoformat only accepts up to 6 before Python 3.11.
+        """
+        if timestamp.endswith("Z"):
+            timestamp = timestamp[:-1] + "+00:00"
+        fraction_start = timestamp.find(".")
+        if fraction_start == -1:
+            return datetime.fromisoformat(timestamp)
+        fraction_end = fraction_start + 1
+        while fraction_end < len(timestamp) and timestamp[fraction_end].isdigit():
+            fraction_end += 1
+        fraction = timestamp[fraction_start + 1:fraction_end][:6].ljust(6, "0")
+        return datetime.fromisoformat(f"{timestamp[:fraction_start]}.{fraction}{timestamp[fraction_end:]}")
+
+
 @dataclasses.dataclass
 class DaemonSettingsDto(JSONWizard):
     class _(JSONWizard.Meta):
@@ -209,6 +286,7 @@ class DaemonRepo(DevicesRepository):
         self._hwmon_temps_enabled: bool = Settings.user.value(UserSettings.ENABLE_HWMON_TEMPS, defaultValue=False, type=bool)
         self._hwmon_filter_enabled: bool = Settings.user.value(UserSettings.ENABLE_HWMON_FILTER, defaultValue=True, type=bool)
         self._excluded_channel_names: dict[str, list[str]] = defaultdict(list)
+        self._status_decoder = StatusDecoder()
         self._client: Session = requests.Session()
         retries = Retry(total=3, backoff_factor=1, status_forcelist=[429, 500, 502, 503, 504])
         adapter = TimeoutHTTPAdapter(max_retries=retries)
@@ -248,7 +326,7 @@ class DaemonRepo(DevicesRepository):
 
     def _load_current_status(self) -> None:
         response = self._client.post(BASE_URL + PATH_STATUS, json={})
-        status_response: StatusResponse = StatusResponse.from_json(response.text)
+        status_response: StatusResponse = self._status_decoder.decode(response.content)
         duplicate_status_logged: bool = False
         first_status_timestamp: datetime | None = None
         for device in status_response.devices:
@@ -357,7 +435,7 @@ class DaemonRepo(DevicesRepository):
         #   (disabled for now)
         log.warning("There is a gap in statuses in the status_history of: %s seconds Attempting to fill.", time_delta.seconds)
         response = self._client.post(BASE_URL + PATH_STATUS, json={"since": str(last_status_in_history.timestamp)})
-        status_response_since_last_status: StatusResponse = StatusResponse.from_json(response.text)
+        status_response_since_last_status: StatusResponse = self._status_decoder.decode(response.content)
         for device_dto in status_response_since_last_status.devices:
             if device_dto.type == DeviceType.COMPOSITE and not self._composite_temps_enabled:
                 continue
@@ -382,7 +460,7 @@ class DaemonRepo(DevicesRepository):
     def _load_all_statuses(self):
         # status
         response = self._client.post(BASE_URL + PATH_STATUS, json={"all": True})
-        status_response: StatusResponse = StatusResponse.from_json(response.text)
+        status_response: StatusResponse = self._status_decoder.decode(response.content)
         for device in status_response.devices:
             self.devices[device.uid].status_history.clear()
             self.devices[device.uid].status_history = device.status_history
@@ -437,8 +515,7 @@ class DaemonRepo(DevicesRepository):
         if not number_of_colors:
             return []
         colors_selectors = numpy.linspace(0.1, 0.35, number_of_colors)
-        color_map = matplotlib.cm.get_cmap("autumn")(colors_selectors)
-        return [matplotlib.cm.colors.to_hex(color) for color in color_map]
+        return ColorUtils.color_map_hex("autumn", colors_selectors)
 
     def _update_gpu_device_colors(self) -> None:
         gpu_devices: list[Device] = [
@@ -464,8 +541,7 @@ class DaemonRepo(DevicesRepository):
         if not number_of_colors:
             return []
         colors_selectors = numpy.linspace(0, 1, number_of_colors)
-        color_map = matplotlib.cm.get_cmap("Wistia")(colors_selectors)
-        return [matplotlib.cm.colors.to_hex(color) for color in color_map]
+        return ColorUtils.color_map_hex("Wistia", colors_selectors)
 
     def _update_normal_device_colors(self) -> None:
         all_other_devices: list[Device] = [
@@ -496,8 +572,7 @@ class DaemonRepo(DevicesRepository):
         if not number_of_colors:
             return []
         colors_selectors = numpy.linspace(0, 1, number_of_colors)
-        color_map = matplotlib.cm.get_cmap("cool")(colors_selectors)
-        return [matplotlib.cm.colors.to_hex(color) for color in color_map]
+        return ColorUtils.color_map_hex("cool", colors_selectors)
 
     def _update_composite_device_colors(self) -> None:
         composite_devices: list[Device] = [
@@ -528,8 +603,7 @@ class DaemonRepo(DevicesRepository):
         if not number_of_colors:
             return []
         colors_selectors = numpy.linspace(0.5, 0.9, number_of_colors)
-        color_map = matplotlib.cm.get_cmap("copper")(colors_selectors)
-        return [matplotlib.cm.colors.to_hex(color) for color in color_map]
+        return ColorUtils.color_map_hex("copper", colors_selectors)
 
     def _request_if_device_is_legacy690(self, device_dto: DeviceDto) -> None:
         is_legacy_690: bool = Legacy690Dialog(device_dto.type_index).ask()
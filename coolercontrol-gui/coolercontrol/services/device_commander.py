@@ -15,8 +15,10 @@
 #  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 # ----------------------------------------------------------------------------------------------------------------------
 
+from __future__ import annotations
+
 import logging
-from typing import Callable
+from typing import Callable, TYPE_CHECKING
 
 from apscheduler.schedulers.background import BackgroundScheduler
 from apscheduler.triggers.date import DateTrigger
@@ -32,7 +34,9 @@ from coolercontrol.services.dynamic_controls.lighting_controls import LightingCo
 from coolercontrol.services.notifications import Notifications
 from coolercontrol.services.utils import MathUtils
 from coolercontrol.settings import Settings as SavedSettings
-from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
+
+if TYPE_CHECKING:
+    from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
 
 log = logging.getLogger(__name__)
 
@@ -87,7 +91,8 @@ class DeviceCommander:
             self._add_to_device_jobs(
                 lambda: self._notifications.settings_applied(
                     self._daemon_repo.set_settings(device_uid, setting)
-                )
+                ),
+                f'{device_uid}_{channel}'
             )
             return  # nothing more to do in this case
         else:
@@ -98,15 +103,16 @@ class DeviceCommander:
         self._add_to_device_jobs(
             lambda: self._notifications.settings_applied(
                 self._daemon_repo.set_settings(device_uid, setting)
-            )
+            ),
+            f'{device_uid}_{channel}'
         )
 
     def set_lighting(self, subject: LightingControls) -> None:
         if subject.current_set_settings is None:
             return
         device_id, lighting_setting = subject.current_set_settings
-        if lighting_setting.lighting_mode.type != LightingModeType.LC:
-            return  # only LC lighting modes are currently supported
+        if lighting_setting.lighting_mode.type not in [LightingModeType.LC, LightingModeType.CUSTOM]:
+            return  # only LC and the daemon's custom lighting modes are currently supported
         associated_device: Device | None = next(
             (
                 device for device in self._daemon_repo.devices.values()
@@ -123,7 +129,8 @@ class DeviceCommander:
         self._add_to_device_jobs(
             lambda: self._notifications.settings_applied(
                 self._daemon_repo.set_settings(associated_device.uid, lighting_setting)
-            )
+            ),
+            f'{associated_device.uid}_{lighting_setting.channel_name}'
         )
 
     def set_lcd_screen(self, subject: LcdControls) -> None:
@@ -149,11 +156,18 @@ class DeviceCommander:
         self._add_to_device_jobs(
             lambda: self._notifications.settings_applied(
                 self._daemon_repo.set_settings(associated_device.uid, lcd_setting)
-            )
+            ),
+            f'{associated_device.uid}_{lcd_setting.channel_name}'
         )
 
-    def _add_to_device_jobs(self, set_function: Callable) -> None:
+    def _add_to_device_jobs(self, set_function: Callable, channel_id: str) -> None:
+        """
+        Settings are applied in the background. A pending setting for the same channel is replaced,
+        so that for ex. dragging a profile only sends the latest setting once the daemon is ready.
+        """
         self._base_scheduler.add_job(
             set_function,
             DateTrigger(),  # defaults to now()
+            id=f'set_settings_{channel_id}',
+            replace_existing=True,
         )
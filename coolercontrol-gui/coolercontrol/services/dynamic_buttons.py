@@ -18,7 +18,8 @@
 from __future__ import annotations
 
 import logging
-from typing import TYPE_CHECKING
+from functools import partial
+from typing import TYPE_CHECKING, Callable
 
 from PySide6.QtCore import Qt, QObject, Slot
 from PySide6.QtWidgets import QHBoxLayout, QBoxLayout, QToolButton, QWidget, QGroupBox
@@ -52,6 +53,8 @@ class DynamicButtons(QObject):
         self._main_window = main_window
         self._left_menu: PyLeftMenu = main_window.ui.left_menu
         self._menu_btn_device_layouts: dict[str, DeviceLayouts] = {}
+        # controls are only created once their channel is first shown, startup scales with what is viewed:
+        self._channel_button_control_factories: dict[str, Callable[[], QWidget]] = {}
         self._channel_button_device_controls: dict[str, QWidget] = {}
         self._dynamic_controls = DynamicControls(devices_view_model)
 
@@ -194,8 +197,8 @@ class DynamicButtons(QObject):
             )
             channel_button.clicked.connect(self.channel_button_toggled)  # pylint: disable=no-member
             speed_layout.addWidget(channel_button)
-            self._channel_button_device_controls[channel_button_id] = \
-                self._dynamic_controls.create_speed_control(channel, channel_button_id)
+            self._channel_button_control_factories[channel_button_id] = \
+                partial(self._dynamic_controls.create_speed_control, channel, channel_button_id)
         return speed_box
 
     def _create_lighting_control_layout(self,
@@ -226,8 +229,8 @@ class DynamicButtons(QObject):
             )
             channel_button.clicked.connect(self.channel_button_toggled)  # pylint: disable=no-member
             lighting_layout.addWidget(channel_button)
-            self._channel_button_device_controls[channel_button_id] = \
-                self._dynamic_controls.create_lighting_control(channel, channel_button_id)
+            self._channel_button_control_factories[channel_button_id] = \
+                partial(self._dynamic_controls.create_lighting_control, channel, channel_button_id)
         return lighting_box
 
     def _create_other_control_layout(self, btn_id: str, lcd_channels: dict[str, ChannelInfo]) -> ChannelGroupBox | None:
@@ -255,8 +258,8 @@ class DynamicButtons(QObject):
         )
         lcd_button.clicked.connect(self.channel_button_toggled)  # pylint: disable=no-member
         other_layout.addWidget(lcd_button)
-        self._channel_button_device_controls[lcd_button_id] = \
-            self._dynamic_controls.create_lcd_control(lcd_button_id)
+        self._channel_button_control_factories[lcd_button_id] = \
+            partial(self._dynamic_controls.create_lcd_control, lcd_button_id)
         return other_box
 
     def _set_device_page_stylesheet(self) -> None:
@@ -324,6 +327,10 @@ class DynamicButtons(QObject):
         self._dynamic_controls.pause_all_animations()
 
     def _show_corresponding_device_column_control_widget(self, channel_btn_id: str) -> None:
+        if channel_btn_id not in self._channel_button_device_controls:
+            log.debug('Creating control widget on first view for: %s', channel_btn_id)
+            self._channel_button_device_controls[channel_btn_id] = \
+                self._channel_button_control_factories[channel_btn_id]()
         for btn_id, widget in self._channel_button_device_controls.items():
             if btn_id == channel_btn_id:
                 self._dynamic_controls.resume_animation(btn_id)
@@ -15,7 +15,10 @@
 #  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 # ----------------------------------------------------------------------------------------------------------------------
 
+from __future__ import annotations
+
 import logging
+from typing import TYPE_CHECKING
 
 from PySide6.QtCore import QObject, Slot, Qt
 from PySide6.QtWidgets import QWidget, QLabel, QSizePolicy, QVBoxLayout
@@ -28,12 +31,14 @@ from coolercontrol.models.speed_profile import SpeedProfile
 from coolercontrol.models.temp_source import TempSource
 from coolercontrol.services.utils import ButtonUtils
 from coolercontrol.settings import Settings, ProfileSetting, UserSettings
-from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
 from coolercontrol.view.uis.controls.speed_control_style import SPEED_CONTROL_STYLE
 from coolercontrol.view.uis.controls.ui_speed_control import Ui_SpeedControl
 from coolercontrol.view.widgets import PyToggle
 from coolercontrol.view_models.devices_view_model import DevicesViewModel
 
+if TYPE_CHECKING:
+    from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
+
 log = logging.getLogger(__name__)
 
 
@@ -44,13 +49,18 @@ class SpeedControls(QObject):
         self._devices_view_model = devices_view_model
         self._clipboard: ClipboardBuffer = ClipboardBuffer()  # same clipboard is used for all devices
         self._channel_button_device_controls: dict[str, SpeedDeviceControl] = {}
+        self._active_channel_buttons: set[str] = set()
 
     def create_speed_control(self, channel_name: str, channel_button_id: str) -> QWidget:
         """Creates the speed control Widget for specific channel button"""
         device_control_widget, speed_control = self._setup_speed_control_ui(channel_button_id)
-        temp_sources_and_profiles, speed_graph = self._initialize_speed_control_dynamic_properties(
-            speed_control, channel_name, channel_button_id
-        )
+        try:
+            temp_sources_and_profiles, speed_graph = self._initialize_speed_control_dynamic_properties(
+                speed_control, channel_name, channel_button_id
+            )
+        except ImportError as err:
+            log.error('The speed control graph requires matplotlib, which could not be imported: %s', err)
+            return QLabel('Speed control graphs require matplotlib to be installed.')
         self._channel_button_device_controls[channel_button_id] = SpeedDeviceControl(
             control_widget=device_control_widget,
             control_ui=speed_control,
@@ -60,18 +70,27 @@ class SpeedControls(QObject):
         return device_control_widget
 
     def resume_speed_graph_animation(self, channel_button_id: str) -> None:
+        """Restarts the animation timer and device updates of a control that is being shown"""
+        if channel_button_id in self._active_channel_buttons:
+            return
         if controls := self._channel_button_device_controls.get(channel_button_id):
+            self._devices_view_model.subscribe(controls.speed_graph)
             controls.speed_graph.resume()
+            self._active_channel_buttons.add(channel_button_id)
 
     def pause_speed_graph_animation(self, channel_button_id: str) -> None:
-        if controls := self._channel_button_device_controls.get(channel_button_id):
-            controls.speed_graph.close_context_menu(animate=False)  # auto-close on transitions
-            controls.speed_graph.pause()
+        """Stops the animation timer and device updates of a control that is no longer visible"""
+        if channel_button_id not in self._active_channel_buttons:
+            return
+        controls = self._channel_button_device_controls[channel_button_id]
+        controls.speed_graph.close_context_menu(animate=False)  # auto-close on transitions
+        controls.speed_graph.pause()
+        self._devices_view_model.unsubscribe(controls.speed_graph)
+        self._active_channel_buttons.discard(channel_button_id)
 
     def pause_all_speed_graph_animations(self) -> None:
-        for controls in self._channel_button_device_controls.values():
-            controls.speed_graph.close_context_menu(animate=False)  # auto-close on transitions
-            controls.speed_graph.pause()
+        for channel_button_id in list(self._active_channel_buttons):
+            self.pause_speed_graph_animation(channel_button_id)
 
     @staticmethod
     def _setup_speed_control_ui(channel_button_id: str) -> tuple[QWidget, Ui_SpeedControl]:
@@ -102,6 +121,9 @@ class SpeedControls(QObject):
             channel_name: str,
             channel_button_id: str
     ) -> tuple[dict[TempSource, list[SpeedProfile]], SpeedControlCanvas]:
+        # matplotlib is only imported once a speed graph is first shown:
+        # pylint: disable-next=import-outside-toplevel
+        from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
         speed_control.speed_control_box.setTitle(channel_name.capitalize())
         speed_control.temp_combo_box.setObjectName(channel_button_id)
         speed_control.temp_combo_box.clear()
@@ -166,6 +188,8 @@ class SpeedControls(QObject):
             speed_control_graph_canvas.pwm_mode = int(pwm_toggle.isChecked())
 
         speed_control_graph_canvas.pause()  # pause all animations by default
+        # suspended until shown, the initial devices are kept from the first subscription:
+        self._devices_view_model.unsubscribe(speed_control_graph_canvas)
         init_status.complete = True
         return temp_sources_and_profiles, speed_control_graph_canvas
 
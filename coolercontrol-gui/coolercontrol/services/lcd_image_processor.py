@@ -0,0 +1,183 @@
+#  CoolerControl - monitor and control your cooling and other devices
+#  Copyright (c) 2022  Guy Boldon
+#  |
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  |
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#  |
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+# ----------------------------------------------------------------------------------------------------------------------
+
+import hashlib
+import logging
+import os
+import threading
+import time
+from pathlib import Path
+
+from PIL import Image, ImageOps, ImageSequence
+from PySide6.QtCore import QThread, Signal, SignalInstance
+
+from coolercontrol.settings import Settings
+
+log = logging.getLogger(__name__)
+_LCD_TOTAL_MEMORY_KB: int = 24_320
+_CACHE_DIR_NAME: str = "lcd_image_cache"
+_CACHE_MAX_BYTES: int = 200_000_000
+_HASH_CHUNK_SIZE: int = 1_048_576
+_STALE_TMP_SECONDS: int = 3_600
+
+
+class LcdImageCache:
+    """
+    A size-bounded cache of processed LCD images.
+    Entries are keyed by the content hash of the source image and the target resolution, so re-selecting
+    the same image, even from another path, doesn't need to be processed again.
+    The least recently used entries are removed when the cache grows over its maximum size,
+    except for entries that are pinned because they are currently shown, and images still being written.
+    """
+
+    def __init__(self, cache_dir: Path | None = None, max_bytes: int = _CACHE_MAX_BYTES) -> None:
+        self._cache_dir: Path = cache_dir if cache_dir is not None else Settings.tmp_path.joinpath(_CACHE_DIR_NAME)
+        self._cache_dir.mkdir(mode=0o700, exist_ok=True)
+        self._max_bytes: int = max_bytes
+        # pruning happens in the processor threads, pinning in the UI thread:
+        self._pinned_lock: threading.Lock = threading.Lock()
+        self._pinned: dict[Path, int] = {}
+
+    def pin(self, entry: Path) -> None:
+        with self._pinned_lock:
+            self._pinned[entry] = self._pinned.get(entry, 0) + 1
+
+    def unpin(self, entry: Path) -> None:
+        with self._pinned_lock:
+            count = self._pinned.get(entry, 0) - 1
+            if count > 0:
+                self._pinned[entry] = count
+            else:
+                self._pinned.pop(entry, None)
+
+    @staticmethod
+    def content_hash(image_path: Path) -> str:
+        sha256 = hashlib.sha256()
+        with open(image_path, "rb") as image_file:
+            while chunk := image_file.read(_HASH_CHUNK_SIZE):
+                sha256.update(chunk)
+        return sha256.hexdigest()
+
+    def entry_path(self, content_hash: str, width_height: int, is_gif: bool) -> Path:
+        suffix = "gif" if is_gif else "png"
+        return self._cache_dir.joinpath(f"{content_hash}_{width_height}.{suffix}")
+
+    def get(self, content_hash: str, width_height: int) -> Path | None:
+        for is_gif in (True, False):
+            entry = self.entry_path(content_hash, width_height, is_gif)
+            if entry.is_file():
+                entry.touch()  # marks the entry as recently used
+                return entry
+        return None
+
+    def prune(self) -> None:
+        entries = []
+        for entry in self._cache_dir.iterdir():
+            try:
+                stat = entry.stat()
+            except FileNotFoundError:
+                continue  # removed by another processor in the meantime
+            if not entry.is_file():
+                continue
+            if entry.name.endswith(".tmp"):
+                # in-flight images are never pruned, only leftovers from a crash
+                if time.time() - stat.st_mtime > _STALE_TMP_SECONDS:
+                    entry.unlink(missing_ok=True)
+                continue
+            entries.append((entry, stat))
+        entries.sort(key=lambda entry_stat: entry_stat[1].st_mtime, reverse=True)
+        with self._pinned_lock:
+            pinned = set(self._pinned)
+        total_bytes: int = 0
+        for entry, stat in entries:
+            total_bytes += stat.st_size
+            if total_bytes > self._max_bytes and entry not in pinned:
+                log.debug("Removing LCD image from cache: %s", entry)
+                entry.unlink(missing_ok=True)
+
+
+class LcdImageProcessor(QThread):
+    """
+    Processes an image for the LCD screen in its own QThread, so that large GIFs don't freeze the UI.
+    The image is resized and cropped to the LCD resolution and saved in the LcdImageCache.
+    If the image has already been processed, the cached file is returned without re-encoding.
+    """
+    progress: SignalInstance = Signal(int)  # type: ignore
+    processed: SignalInstance = Signal(object)  # type: ignore
+    failed: SignalInstance = Signal(str)  # type: ignore
+
+    def __init__(self, image_path: Path, width_height: int, cache: LcdImageCache) -> None:
+        super().__init__()
+        self.image_path: Path = image_path
+        self._width_height: int = width_height
+        self._cache: LcdImageCache = cache
+
+    def run(self) -> None:
+        tmp_path: Path | None = None
+        try:
+            content_hash = self._cache.content_hash(self.image_path)
+            cached_image_path = self._cache.get(content_hash, self._width_height)
+            if cached_image_path is not None:
+                log.debug("Using cached LCD image: %s", cached_image_path)
+                self.processed.emit(cached_image_path)
+                return
+            with Image.open(self.image_path) as image:
+                is_gif: bool = image.format is not None and image.format == "GIF"
+                processed_path = self._cache.entry_path(content_hash, self._width_height, is_gif)
+                # write to a temporary file first, so that the cache never contains partial entries:
+                tmp_path = processed_path.with_name(f".{processed_path.name}.tmp")
+                if is_gif:
+                    self._process_gif(image, tmp_path)
+                else:
+                    self._process_image(image, tmp_path)
+            self._verify_image_size(tmp_path.stat().st_size)
+            os.replace(tmp_path, processed_path)
+            self._cache.prune()
+            self.processed.emit(processed_path)
+        except BaseException as exc:
+            log.error("Image could not be processed: %s", exc)
+            if tmp_path is not None:
+                tmp_path.unlink(missing_ok=True)
+            self.failed.emit(str(exc))
+
+    def _process_gif(self, image: Image, processed_path: Path) -> None:
+        frame_count: int = getattr(image, "n_frames", 1)
+        resized_frames: list[Image] = []
+        for index, frame in enumerate(ImageSequence.Iterator(image)):
+            # fit() resizes and crops, keeping aspect ratio
+            resized_frames.append(ImageOps.fit(frame.copy(), (self._width_height, self._width_height)))
+            self.progress.emit(int((index + 1) * 90 / frame_count))
+        starting_image = resized_frames[0]
+        starting_image.info = image.info
+        starting_image.save(
+            processed_path, format="GIF", save_all=True, append_images=resized_frames[1:], loop=0,
+        )
+        self.progress.emit(100)
+
+    def _process_image(self, image: Image, processed_path: Path) -> None:
+        resized_image = ImageOps.fit(image, (self._width_height, self._width_height))
+        resized_image.save(processed_path, format="PNG")
+        self.progress.emit(100)
+
+    @staticmethod
+    def _verify_image_size(image_size_bytes: int) -> None:
+        """Verify the processed file size to make sure it'll fit in LCD memory"""
+        if image_size_bytes / 1_000 >= _LCD_TOTAL_MEMORY_KB:
+            raise ValueError(
+                f"Image file after processing must be less than 24MB. Current size: "
+                f"{round((image_size_bytes / 1_000_000), 2)}MB"
+            )
@@ -17,6 +17,7 @@
 
 from functools import lru_cache
 
+import numpy as np
 from numpy import ndarray
 
 from coolercontrol.models.device import DeviceType
@@ -91,3 +92,55 @@ class MathUtils:
     @staticmethod
     def convert_linespace_to_list(linespace_result: ndarray) -> list[int]:
         return list(map(lambda number: int(number), linespace_result))
+
+    @staticmethod
+    def decimate_min_max(x: ndarray, y: ndarray, bucket_width: float) -> tuple[ndarray, ndarray]:
+        """
+        Reduces a line to two points for every bucket_width of x, the min and the max of y,
+        so that peaks are preserved when there are more samples than pixels. x must be sorted.
+        """
+        if len(x) < 3 or bucket_width <= 0:
+            return x, y
+        buckets = np.floor(x / bucket_width)
+        starts = np.flatnonzero(np.diff(buckets)) + 1
+        starts = np.insert(starts, 0, 0)
+        if len(starts) * 2 >= len(x):
+            return x, y
+        ends = np.append(starts[1:], len(x)) - 1
+        decimated_x = np.empty(len(starts) * 2)
+        decimated_x[0::2] = x[starts]
+        decimated_x[1::2] = x[ends]
+        decimated_y = np.empty(len(starts) * 2)
+        decimated_y[0::2] = np.minimum.reduceat(y, starts)
+        decimated_y[1::2] = np.maximum.reduceat(y, starts)
+        return decimated_x, decimated_y
+
+
+class ColorUtils:
+    """Native versions of the matplotlib color maps used for device colors, so that matplotlib isn't needed for them"""
+
+    # the segment data of the matplotlib color maps, as x positions and values for red, green and blue:
+    _COLOR_MAP_SEGMENTS: dict[str, tuple[list[float], list[float], list[float], list[float]]] = {
+        'autumn': ([0.0, 1.0], [1.0, 1.0], [0.0, 1.0], [0.0, 0.0]),
+        'cool': ([0.0, 1.0], [0.0, 1.0], [1.0, 0.0], [1.0, 1.0]),
+        'copper': ([0.0, 0.809524, 1.0], [0.0, 1.0, 1.0], [0.0, 0.7812 * 0.809524, 0.7812],
+                   [0.0, 0.4975 * 0.809524, 0.4975]),
+        'Wistia': ([0.0, 0.25, 0.5, 0.75, 1.0],
+                   [0.8941176470588236, 1.0, 1.0, 1.0, 0.9882352941176471],
+                   [1.0, 0.9098039215686274, 0.7411764705882353, 0.6274509803921569, 0.4980392156862745],
+                   [0.47843137254901963, 0.10196078431372549, 0.0, 0.0, 0.0]),
+    }
+    _COLOR_MAP_SIZE: int = 256
+
+    @staticmethod
+    def color_map_hex(color_map_name: str, color_selectors: ndarray) -> list[str]:
+        """Returns the hex colors for the given selectors in the range of 0-1, like calling the matplotlib color map"""
+        x_positions, reds, greens, blues = ColorUtils._COLOR_MAP_SEGMENTS[color_map_name]
+        # matplotlib color maps are a lookup table of 256 colors:
+        lookup_indexes = np.clip((color_selectors * ColorUtils._COLOR_MAP_SIZE).astype(int),
+                                 0, ColorUtils._COLOR_MAP_SIZE - 1)
+        lookup_positions = lookup_indexes / (ColorUtils._COLOR_MAP_SIZE - 1)
+        colors = np.stack(
+            [np.interp(lookup_positions, x_positions, values) for values in (reds, greens, blues)], axis=-1
+        )
+        return ['#' + ''.join(format(round(value * 255), '02x') for value in color) for color in colors]
@@ -80,6 +80,7 @@ class UserSettings(str, Enum):
     ENABLE_HWMON_FILTER = "enable_hwmon_filter"
     ENABLE_HWMON_TEMPS = "enable_hwmon_temps"
     MENU_OPEN = "menu_open"
+    ENABLE_NATIVE_CHARTS = "enable_native_charts"
 
     def __str__(self) -> str:
         return str.__str__(self)
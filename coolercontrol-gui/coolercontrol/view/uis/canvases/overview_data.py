@@ -0,0 +1,169 @@
+#  CoolerControl - monitor and control your cooling and other devices
+#  Copyright (c) 2022  Guy Boldon
+#  |
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  |
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#  |
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+# ----------------------------------------------------------------------------------------------------------------------
+
+from collections import defaultdict
+from dataclasses import dataclass, field
+
+import numpy as np
+
+from coolercontrol.models.device import Device, STATUS_LENGTH_MAX
+from coolercontrol.models.status import Status
+from coolercontrol.repositories.daemon_repo import MAX_UPDATE_TIMESTAMP_VARIATION
+
+
+class OverviewLabels:
+    """The line labels used in the system overview, which are also the names used to hide lines in the legend"""
+
+    @staticmethod
+    def create_cpu_label(channel_name: str, number_cpus: int, current_cpu_id: int) -> str:
+        prefix = f"#{current_cpu_id} " if number_cpus > 1 else ""
+        return f'{prefix}{channel_name}' if channel_name.startswith("CPU") else f"{prefix}CPU {channel_name.capitalize()}"
+
+    @staticmethod
+    def create_gpu_label(channel_name: str, number_gpus: int, current_gpu_id: int) -> str:
+        prefix = f"#{current_gpu_id} " if number_gpus > 1 else ""
+        return f'{prefix}{channel_name}' if channel_name.startswith("GPU") else f"{prefix}GPU {channel_name.capitalize()}"
+
+    @staticmethod
+    def create_device_label(devices: list[Device], device_name: str, channel_name: str, device_id: int) -> str:
+        has_same_name_as_other_device: bool = any(
+            device.name_short == device_name and device.type_id != device_id
+            for device in devices
+        )
+        prefix = f'LC#{device_id} ' if has_same_name_as_other_device else ''
+        return f'{prefix}{device_name} {channel_name.capitalize()}'
+
+
+class RingBuffer:
+    """
+    A preallocated ring buffer of plot values. Every value is written twice, once in each half of the array,
+    so that the most recent values are always available as a contiguous view without copying.
+    """
+
+    def __init__(self, capacity: int) -> None:
+        self._capacity: int = capacity
+        self._data: np.ndarray = np.zeros(2 * capacity)
+        self._next: int = 0
+        self._size: int = 0
+
+    def __len__(self) -> int:
+        return self._size
+
+    @property
+    def values(self) -> np.ndarray:
+        """A view of the stored values, from oldest to newest"""
+        end = self._next + self._capacity
+        return self._data[end - self._size:end]
+
+    def append(self, value: float) -> None:
+        self._data[self._next] = value
+        self._data[self._next + self._capacity] = value
+        self._next = (self._next + 1) % self._capacity
+        self._size = min(self._size + 1, self._capacity)
+
+    def drop_oldest(self, count: int) -> None:
+        self._size -= min(count, self._size)
+
+    def clear(self) -> None:
+        self._next = 0
+        self._size = 0
+
+
+@dataclass(frozen=True)
+class DeviceData:
+    """This class improves graph efficiency by storing a copy of data in the preferred format and only adding new data"""
+    device_status_history: list[Status]
+    _temps: dict[str, RingBuffer] = field(
+        default_factory=lambda: defaultdict(lambda: RingBuffer(STATUS_LENGTH_MAX)), init=False)
+    _duties: dict[str, RingBuffer] = field(
+        default_factory=lambda: defaultdict(lambda: RingBuffer(STATUS_LENGTH_MAX)), init=False)
+    _timestamps: RingBuffer = field(default_factory=lambda: RingBuffer(STATUS_LENGTH_MAX), init=False)
+    _ages_seconds: np.ndarray = field(default_factory=lambda: np.zeros(STATUS_LENGTH_MAX), init=False)
+
+    @property
+    def temps(self) -> dict[str, np.ndarray]:
+        self._synchronize_data()
+        return {name: temps.values for name, temps in self._temps.items()}
+
+    @property
+    def duties(self) -> dict[str, np.ndarray]:
+        self._synchronize_data()
+        return {name: duties.values for name, duties in self._duties.items()}
+
+    @property
+    def ages_seconds(self) -> np.ndarray:
+        self._synchronize_data()
+        return self._ages_seconds[:len(self._timestamps)]
+
+    def temp(self, name: str) -> np.ndarray:
+        """The values of a single temp, from oldest to newest"""
+        self._synchronize_data()
+        return self._temps[name].values if name in self._temps else np.empty(0)
+
+    def duty(self, name: str) -> np.ndarray:
+        """The values of a single channel duty, from oldest to newest"""
+        self._synchronize_data()
+        return self._duties[name].values if name in self._duties else np.empty(0)
+
+    @property
+    def timestamps(self) -> np.ndarray:
+        """The timestamps of the samples in seconds, from oldest to newest"""
+        self._synchronize_data()
+        return self._timestamps.values
+
+    @property
+    def revision(self) -> tuple[int, float]:
+        """Changes whenever samples have been added or removed"""
+        if not len(self._timestamps):
+            return 0, 0.0
+        return len(self._timestamps), self._timestamps.values[-1]
+
+    def clear_cached_data(self) -> None:
+        self._temps.clear()
+        self._duties.clear()
+        self._timestamps.clear()
+
+    def _synchronize_data(self) -> None:
+        self._remove_outdated_data()
+        statuses_to_sync = len(self.device_status_history) - len(self._timestamps)
+        if statuses_to_sync > 0:
+            for status in self.device_status_history[-statuses_to_sync:]:
+                self._timestamps.append(status.timestamp.timestamp())
+                for temp_status in status.temps:
+                    self._temps[temp_status.name].append(temp_status.temp)
+                for channel_status in status.channels:
+                    if channel_status.duty is not None:
+                        self._duties[channel_status.name].append(channel_status.duty)
+            most_recent_timestamp = (
+                    self.device_status_history[-1].timestamp + MAX_UPDATE_TIMESTAMP_VARIATION
+            ).timestamp()
+            ages_seconds = self._ages_seconds[:len(self._timestamps)]
+            np.subtract(most_recent_timestamp, self._timestamps.values, out=ages_seconds)
+            np.floor(ages_seconds, out=ages_seconds)
+
+    def _remove_outdated_data(self) -> None:
+        """This removes stored data that has been removed from the status_history"""
+        if not len(self._timestamps) or not self.device_status_history:
+            return
+        oldest_timestamp = self.device_status_history[0].timestamp.timestamp()
+        outdated_count = int(np.searchsorted(self._timestamps.values, oldest_timestamp))
+        if outdated_count > 0:
+            self._timestamps.drop_oldest(outdated_count)
+            for temps in self._temps.values():
+                temps.drop_oldest(outdated_count)
+            for duties in self._duties.values():
+                duties.drop_oldest(outdated_count)
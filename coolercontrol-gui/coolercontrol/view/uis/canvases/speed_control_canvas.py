@@ -45,6 +45,7 @@ from coolercontrol.view.uis.canvases.canvas_context_menu import CanvasContextMen
 from coolercontrol.view.uis.canvases.canvas_input_box import CanvasInputBox
 from coolercontrol.view_models.device_subject import DeviceSubject
 from coolercontrol.view_models.observer import Observer
+from coolercontrol.view_models.speed_control_subject import SpeedControlSubject
 from coolercontrol.view_models.subject import Subject
 
 log = logging.getLogger(__name__)
@@ -63,7 +64,7 @@ _MARKER_TEXT_X_AXIS_MAX_THRESHOLD: float = 0.89
 _DEFAULT_NUMBER_PROFILE_POINTS: int = 5
 
 
-class SpeedControlCanvas(FigureCanvasQTAgg, FuncAnimation, Observer, Subject):
+class SpeedControlCanvas(FigureCanvasQTAgg, FuncAnimation, Observer, SpeedControlSubject):
     """Class to plot and animate Speed control and status"""
 
     def __init__(self,
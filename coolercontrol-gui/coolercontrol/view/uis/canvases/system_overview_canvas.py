@@ -16,11 +16,9 @@
 # ----------------------------------------------------------------------------------------------------------------------
 
 import logging
-from collections import defaultdict
-from dataclasses import dataclass, field
-from datetime import datetime
 from operator import attrgetter
 
+import numpy as np
 from matplotlib.animation import FuncAnimation
 from matplotlib.artist import Artist
 from matplotlib.backend_bases import PickEvent, DrawEvent, MouseEvent, MouseButton
@@ -31,10 +29,11 @@ from matplotlib.lines import Line2D
 from matplotlib.text import Text
 
 from coolercontrol.models.device import Device, DeviceType
-from coolercontrol.models.status import Status
-from coolercontrol.repositories.daemon_repo import MAX_UPDATE_TIMESTAMP_VARIATION, DaemonRepo
+from coolercontrol.repositories.daemon_repo import DaemonRepo
 from coolercontrol.services.settings_observer import SettingsObserver
+from coolercontrol.services.utils import MathUtils
 from coolercontrol.settings import Settings
+from coolercontrol.view.uis.canvases.overview_data import DeviceData, OverviewLabels
 from coolercontrol.view_models.device_observer import DeviceObserver
 from coolercontrol.view_models.device_subject import DeviceSubject
 
@@ -97,6 +96,8 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
         # Lines
         self.lines: list[Line2D] = []
         self.legend_artists: dict[Artist, Line2D] = {}
+        self._line_data_revisions: dict[Line2D, tuple[tuple[int, float], float]] = {}
+        self._line_data_lengths: dict[Line2D, int] = {}
 
         # Interactions
         self.fig.canvas.mpl_connect('pick_event', self._on_pick)
@@ -157,6 +158,12 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
             self.legend_artists[legend_text] = ax_line
         return legend
 
+    def resume(self) -> None:
+        """Resumes the animation, with a quick first redraw"""
+        if self.event_source:
+            self.event_source.interval = 100
+        super().resume()
+
     def redraw_workaround(self) -> None:
         """In some situations artifacts appear from hiding and showing the graph, in this case we manually clear"""
         self._redraw_canvas()
@@ -169,6 +176,8 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
         for data in self._lc_devices_data.values():
             data.clear_cached_data()
         self._composite_data.clear_cached_data()
+        self._line_data_revisions.clear()
+        self._line_data_lengths.clear()
 
     def _set_cpu_data(self) -> None:
         if not self._cpu_lines_initialized:
@@ -176,13 +185,15 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
         cpus = self._get_devices_with_type(DeviceType.CPU)
         for cpu in cpus:
             for name, temps in self._cpu_data[cpu].temps.items():
-                self._get_line_by_label(
-                    self._create_cpu_label(name, len(cpus), cpu.type_id)
-                ).set_data(self._cpu_data[cpu].ages_seconds, temps)
+                self._set_line_data(
+                    self._get_line_by_label(OverviewLabels.create_cpu_label(name, len(cpus), cpu.type_id)),
+                    self._cpu_data[cpu], temps
+                )
             for name, duties in self._cpu_data[cpu].duties.items():
-                self._get_line_by_label(
-                    self._create_cpu_label(name, len(cpus), cpu.type_id)
-                ).set_data(self._cpu_data[cpu].ages_seconds, duties)
+                self._set_line_data(
+                    self._get_line_by_label(OverviewLabels.create_cpu_label(name, len(cpus), cpu.type_id)),
+                    self._cpu_data[cpu], duties
+                )
 
     def _set_gpu_data(self) -> None:
         if not self._gpu_lines_initialized:
@@ -190,73 +201,90 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
         gpus = self._get_devices_with_type(DeviceType.GPU)
         for gpu in gpus:
             for name, temps in self._gpu_data[gpu].temps.items():
-                self._get_line_by_label(
-                    self._create_gpu_label(name, len(gpus), gpu.type_id)
-                ).set_data(self._gpu_data[gpu].ages_seconds, temps)
+                self._set_line_data(
+                    self._get_line_by_label(OverviewLabels.create_gpu_label(name, len(gpus), gpu.type_id)),
+                    self._gpu_data[gpu], temps
+                )
             for name, duties in self._gpu_data[gpu].duties.items():
-                self._get_line_by_label(
-                    self._create_gpu_label(name, len(gpus), gpu.type_id)
-                ).set_data(self._gpu_data[gpu].ages_seconds, duties)
+                self._set_line_data(
+                    self._get_line_by_label(OverviewLabels.create_gpu_label(name, len(gpus), gpu.type_id)),
+                    self._gpu_data[gpu], duties
+                )
 
     def _set_lc_device_data(self) -> None:
         if not self._liquidctl_lines_initialized:
             return
         for device in self._get_devices_with_type(DeviceType.LIQUIDCTL):
             for name, temps in self._lc_devices_data[device].temps.items():
-                self._get_line_by_label(
-                    self._create_device_label(device.name_short, name, device.type_id)
-                ).set_data(self._lc_devices_data[device].ages_seconds, temps)
+                self._set_line_data(
+                    self._get_line_by_label(self._create_device_label(device.name_short, name, device.type_id)),
+                    self._lc_devices_data[device], temps
+                )
             for name, duty in self._lc_devices_data[device].duties.items():
-                self._get_line_by_label(
-                    self._create_device_label(device.name_short, name, device.type_id)
-                ).set_data(self._lc_devices_data[device].ages_seconds, duty)
+                self._set_line_data(
+                    self._get_line_by_label(self._create_device_label(device.name_short, name, device.type_id)),
+                    self._lc_devices_data[device], duty
+                )
 
     def _set_hwmon_device_data(self) -> None:
         if not self._hwmon_lines_initialized:
             return
         for device in self._get_devices_with_type(DeviceType.HWMON):
             for name, temps in self._hwmon_devices_data[device].temps.items():
-                self._get_line_by_label(
-                    self._create_device_label(device.name, name, device.type_id)
-                ).set_data(self._hwmon_devices_data[device].ages_seconds, temps)
+                self._set_line_data(
+                    self._get_line_by_label(self._create_device_label(device.name, name, device.type_id)),
+                    self._hwmon_devices_data[device], temps
+                )
             for name, duty in self._hwmon_devices_data[device].duties.items():
-                self._get_line_by_label(
-                    self._create_device_label(device.name, name, device.type_id)
-                ).set_data(self._hwmon_devices_data[device].ages_seconds, duty)
+                self._set_line_data(
+                    self._get_line_by_label(self._create_device_label(device.name, name, device.type_id)),
+                    self._hwmon_devices_data[device], duty
+                )
 
     def _set_composite_data(self) -> None:
         composite_device = self._get_first_device_with_type(DeviceType.COMPOSITE)
         if self._composite_lines_initialized and composite_device:
             for name, temps in self._composite_data.temps.items():
-                self._get_line_by_label(name).set_data(self._composite_data.ages_seconds, temps)
+                self._set_line_data(self._get_line_by_label(name), self._composite_data, temps)
+
+    def _set_line_data(self, line: Line2D, device_data: DeviceData, values: np.ndarray) -> None:
+        """
+        Sets the visible part of the line's data, decimated to the min and max of every horizontal pixel.
+        This is only recomputed when new samples have arrived or the canvas has been resized or zoomed.
+        """
+        if line.axes is None:
+            return  # no initialized plot line was found for this data
+        ages_seconds = device_data.ages_seconds
+        self._line_data_lengths[line] = len(ages_seconds)
+        x_limit_seconds = self.axes.get_xlim()[0]
+        seconds_per_pixel = x_limit_seconds / max(self.axes.bbox.width, 1.0)
+        revision = device_data.revision, seconds_per_pixel
+        if self._line_data_revisions.get(line) == revision:
+            return
+        self._line_data_revisions[line] = revision
+        length = min(len(ages_seconds), len(values))  # align the newest samples
+        ages_seconds = ages_seconds[len(ages_seconds) - length:]
+        values = values[len(values) - length:]
+        # ages are descending, the sample just outside the graph is kept so the line reaches the edge:
+        visible_count = int(np.searchsorted(ages_seconds[::-1], x_limit_seconds, side='right'))
+        visible_start = max(length - visible_count - 1, 0)
+        line.set_data(
+            *MathUtils.decimate_min_max(ages_seconds[visible_start:], values[visible_start:], seconds_per_pixel)
+        )
 
     def verify_data_lengths(self):
         """
-        Verify that all lines have the same data length and attempts to correct the issue if possible.
-        This is helpful for correcting status update issues and keeping the graph working, instead of raising an exception
+        Verify that all lines have the same data length and clears the cached data to reload the statuses if not.
+        Each line's data is aligned on its own, which keeps the graph working instead of raising an exception.
         """
-        if not self.lines:
+        if not self.lines or self.lines[0] not in self._line_data_lengths:
             return
-        x_length = len(self.lines[0].get_xdata(orig=True))  # we assume cpu is the most stable of status_history
-        warning_logged: bool = False
-        for line in self.lines:
-            line_length = len(line.get_xdata(orig=True))
-            if line_length != x_length:
-                if not warning_logged:
-                    log.warning("There are unequal status history lengths for system overview lines. Compensating and clearing cache.")
-                    self.clear_cached_graph_data()
-                    DaemonRepo.reload_all_statuses = True
-                    warning_logged = True
-                if line_length > x_length:
-                    x_data = list(line.get_xdata(orig=True))[-x_length:]
-                    y_data = list(line.get_ydata(orig=True))[-x_length:]
-                else:  # length is smaller
-                    x_data = list(line.get_xdata(orig=True))
-                    y_data = list(line.get_ydata(orig=True))
-                    for _ in range(x_length - line_length):
-                        x_data.append(0)
-                        y_data.append(0)
-                line.set_data(x_data, y_data)
+        # we assume cpu is the most stable of status_history
+        x_length = self._line_data_lengths[self.lines[0]]
+        if any(length != x_length for length in self._line_data_lengths.values()):
+            log.warning("There are unequal status history lengths for system overview lines. Clearing cache.")
+            self.clear_cached_graph_data()
+            DaemonRepo.reload_all_statuses = True
 
     def _get_first_device_with_type(self, device_type: DeviceType) -> Device | None:
         return next(
@@ -273,7 +301,7 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
             lines_cpu.extend(
                 Line2D(
                     [], [], color=cpu.color(temp_status.name),
-                    label=self._create_cpu_label(temp_status.name, len(cpus), cpu.type_id),
+                    label=OverviewLabels.create_cpu_label(temp_status.name, len(cpus), cpu.type_id),
                     linewidth=2,
                 )
                 for temp_status in cpu.status.temps
@@ -281,7 +309,7 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
             lines_cpu.extend(
                 Line2D(
                     [], [], color=cpu.color(channel_status.name),
-                    label=self._create_cpu_label(channel_status.name, len(cpus), cpu.type_id),
+                    label=OverviewLabels.create_cpu_label(channel_status.name, len(cpus), cpu.type_id),
                     linestyle=("dashdot" if channel_status.name.startswith("fan") else "dashed"),
                     linewidth=1,
                 )
@@ -300,7 +328,7 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
             lines_gpu.extend(
                 Line2D(
                     [], [], color=gpu.color(temp_status.name),
-                    label=self._create_gpu_label(temp_status.name, len(gpus), gpu.type_id),
+                    label=OverviewLabels.create_gpu_label(temp_status.name, len(gpus), gpu.type_id),
                     linewidth=2
                 )
                 for temp_status in gpu.status.temps
@@ -308,7 +336,7 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
             lines_gpu.extend(
                 Line2D(
                     [], [], color=gpu.color(channel_status.name),
-                    label=self._create_gpu_label(channel_status.name, len(gpus), gpu.type_id),
+                    label=OverviewLabels.create_gpu_label(channel_status.name, len(gpus), gpu.type_id),
                     linestyle=("dashdot" if channel_status.name.startswith("fan") else "dashed"),
                     linewidth=1,
                 )
@@ -391,23 +419,8 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
         self._composite_lines_initialized = True
         log.debug('initialized composite lines')
 
-    @staticmethod
-    def _create_cpu_label(channel_name: str, number_cpus: int, current_cpu_id: int) -> str:
-        prefix = f"#{current_cpu_id} " if number_cpus > 1 else ""
-        return f'{prefix}{channel_name}' if channel_name.startswith("CPU") else f"{prefix}CPU {channel_name.capitalize()}"
-
-    @staticmethod
-    def _create_gpu_label(channel_name: str, number_gpus: int, current_gpu_id: int) -> str:
-        prefix = f"#{current_gpu_id} " if number_gpus > 1 else ""
-        return f'{prefix}{channel_name}' if channel_name.startswith("GPU") else f"{prefix}GPU {channel_name.capitalize()}"
-
     def _create_device_label(self, device_name: str, channel_name: str, device_id: int) -> str:
-        has_same_name_as_other_device: bool = any(
-            device.name_short == device_name and device.type_id != device_id
-            for device in self._devices
-        )
-        prefix = f'LC#{device_id} ' if has_same_name_as_other_device else ''
-        return f'{prefix}{device_name} {channel_name.capitalize()}'
+        return OverviewLabels.create_device_label(self._devices, device_name, channel_name, device_id)
 
     def _redraw_canvas(self) -> None:
         self._blit_cache.clear()
@@ -486,63 +499,3 @@ class SystemOverviewCanvas(FigureCanvasQTAgg, FuncAnimation, DeviceObserver):
         """We override this so that our animation is redrawn quickly after a plot resize"""
         super()._end_redraw(event)
         self.event_source.interval = 100
-
-
-@dataclass(frozen=True)
-class DeviceData:
-    """This class improves graph efficiency by storing a copy of data in the preferred format and only adding new data"""
-    device_status_history: list[Status]
-    _temps: dict[str, list[float]] = field(default_factory=lambda: defaultdict(list), init=False)
-    _duties: dict[str, list[float]] = field(default_factory=lambda: defaultdict(list), init=False)
-    _ages_seconds: list[int] = field(default_factory=list, init=False)
-    _ages_timestamps: list[datetime] = field(default_factory=list, init=False)
-
-    @property
-    def temps(self) -> dict[str, list[float]]:
-        self._synchronize_data()
-        return self._temps
-
-    @property
-    def duties(self) -> dict[str, list[float]]:
-        self._synchronize_data()
-        return self._duties
-
-    @property
-    def ages_seconds(self) -> list[int]:
-        return self._ages_seconds
-
-    def clear_cached_data(self) -> None:
-        self._temps.clear()
-        self._duties.clear()
-        self._ages_seconds.clear()
-        self._ages_timestamps.clear()
-
-    def _synchronize_data(self) -> None:
-        self._remove_outdated_data()
-        current_data_size = len(self._ages_seconds)
-        statuses_to_sync = len(self.device_status_history) - current_data_size
-        if statuses_to_sync > 0:
-            for status in self.device_status_history[-statuses_to_sync:]:
-                for temp_status in status.temps:
-                    self._temps[temp_status.name].append(temp_status.temp)
-                for channel_status in status.channels:
-                    if channel_status.duty is not None:
-                        self._duties[channel_status.name].append(channel_status.duty)
-            self._ages_seconds.clear()
-            self._ages_timestamps.clear()
-            most_recent_timestamp = self.device_status_history[-1].timestamp + MAX_UPDATE_TIMESTAMP_VARIATION
-            for status in self.device_status_history:
-                self._ages_seconds.append((most_recent_timestamp - status.timestamp).seconds)
-                self._ages_timestamps.append(status.timestamp)
-
-    def _remove_outdated_data(self) -> None:
-        """This removes stored data that has been removed from the status_history"""
-        if not self._ages_seconds or not self.device_status_history:
-            return
-        while self.device_status_history[0].timestamp != self._ages_timestamps[0]:
-            self._ages_timestamps.pop(0)
-            self._ages_seconds.pop(0)
-            for temp in self._temps.values():
-                temp.pop(0)
-            for duty in self._duties.values():
-                duty.pop(0)
@@ -0,0 +1,384 @@
+#  CoolerControl - monitor and control your cooling and other devices
+#  Copyright (c) 2022  Guy Boldon
+#  |
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  |
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#  |
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+# ----------------------------------------------------------------------------------------------------------------------
+
+import logging
+import time
+from dataclasses import dataclass, field
+from operator import attrgetter
+
+import numpy as np
+from PySide6.QtCore import Qt, QTimer, QRectF, QPointF
+from PySide6.QtGui import (QPainter, QPainterPath, QPen, QColor, QPixmap, QTransform, QPaintEvent, QResizeEvent,
+                           QMouseEvent, QWheelEvent, QFontMetrics)
+from PySide6.QtWidgets import QWidget, QSizePolicy
+
+from coolercontrol.models.device import Device, DeviceType
+from coolercontrol.repositories.daemon_repo import MAX_UPDATE_TIMESTAMP_VARIATION
+from coolercontrol.services.settings_observer import SettingsObserver
+from coolercontrol.services.utils import MathUtils
+from coolercontrol.settings import Settings
+from coolercontrol.view.uis.canvases.overview_data import DeviceData, OverviewLabels
+from coolercontrol.view_models.device_observer import DeviceObserver
+from coolercontrol.view_models.device_subject import DeviceSubject
+
+log = logging.getLogger(__name__)
+DRAW_INTERVAL_MS: int = 1_000
+_Y_MIN: float = -1.0
+_Y_MAX: float = 101.0
+_Y_TICKS: list[int] = [0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100]
+# zoom level: (x limit in seconds, x ticks)
+_ZOOM_LEVELS: dict[int, tuple[int, list[tuple[int, str]]]] = {
+    1: (60, [(30, '30s'), (60, '1m')]),
+    2: (5 * 60, [(60, '1m'), (180, '3m'), (300, '5m')]),
+    3: (15 * 60, [(60, '1m'), (300, '5m'), (600, '10m'), (900, '15m')]),
+    4: (30 * 60, [(60, '1m'), (300, '5m'), (600, '10m'), (900, '15m'), (1200, '20m'), (1800, '30m')]),
+}
+_MARGIN: int = 8
+_LEGEND_LINE_LENGTH: int = 24
+_HIDDEN_LINE_ALPHA: float = 0.2
+
+
+@dataclass
+class PainterLine:
+    """A line of the overview, whose path is kept in timestamp coordinates so that new samples are only appended"""
+    label: str
+    device_data: DeviceData
+    status_name: str
+    is_temp: bool
+    pen: QPen
+    visible: bool = True
+    path: QPainterPath = field(default_factory=QPainterPath)
+    first_timestamp: float = 0.0
+    last_timestamp: float = 0.0
+    seconds_per_pixel: float = 0.0
+
+    def values(self) -> np.ndarray:
+        return self.device_data.temp(self.status_name) if self.is_temp else self.device_data.duty(self.status_name)
+
+    def reset_path(self) -> None:
+        self.path = QPainterPath()
+        self.first_timestamp = 0.0
+        self.last_timestamp = 0.0
+
+
+class SystemOverviewPainter(QWidget, DeviceObserver):
+    """
+    Class to plot and animate the System Overview histogram with native Qt painting.
+    The axes are cached in a pixmap and only the line paths are painted every frame.
+    """
+
+    def __init__(self,
+                 bg_color: str = Settings.theme['app_color']['bg_one'],
+                 text_color: str = Settings.theme['app_color']['text_foreground'],
+                 ) -> None:
+        super().__init__()
+        self._bg_color = QColor(bg_color)
+        self._text_color = QColor(text_color)
+        self._settings_observer = SettingsObserver()
+        self._settings_observer.connect_clear_graph_history(self.clear_cached_graph_data)
+        self._devices: list[Device] = []
+        self._devices_data: dict[Device, DeviceData] = {}
+        self.lines: list[PainterLine] = []
+        self.zoom_level: int = 1
+        self.x_limit, self._x_ticks = _ZOOM_LEVELS[self.zoom_level]
+        # paths are relative to this, to keep the coordinates small:
+        self._time_base: float = time.time()
+        self._axes_pixmap: QPixmap | None = None
+        self._legend_pixmap: QPixmap | None = None
+        self._legend_rows: list[tuple[QRectF, PainterLine]] = []
+        self._plot_rect: QRectF = QRectF()
+        self.setSizePolicy(QSizePolicy.Expanding, QSizePolicy.Expanding)
+        self._draw_timer = QTimer(self)
+        self._draw_timer.setInterval(DRAW_INTERVAL_MS)
+        self._draw_timer.timeout.connect(self.update)
+        self._draw_timer.start()
+
+    def notify_me(self, subject: DeviceSubject) -> None:  # type: ignore
+        if self._devices:
+            return
+        self._devices = subject.devices
+        self._initialize_lines()
+        self.update()
+
+    def pause(self) -> None:
+        self._draw_timer.stop()
+
+    def resume(self) -> None:
+        self._draw_timer.start()
+        self.update()
+
+    def redraw_workaround(self) -> None:
+        """Kept for interface compatibility with the matplotlib canvas, a full repaint is all that is needed"""
+        self._invalidate_pixmaps()
+        self.update()
+
+    def clear_cached_graph_data(self) -> None:
+        for data in self._devices_data.values():
+            data.clear_cached_data()
+        for line in self.lines:
+            line.reset_path()
+
+    def paintEvent(self, event: QPaintEvent) -> None:
+        painter = QPainter(self)
+        if self._axes_pixmap is None:
+            self._axes_pixmap = self._create_axes_pixmap()
+        painter.drawPixmap(0, 0, self._axes_pixmap)
+        painter.setRenderHint(QPainter.Antialiasing)
+        painter.setClipRect(self._plot_rect)
+        pixels_per_second = self._plot_rect.width() / self.x_limit
+        for line in self.lines:
+            self._update_path(line, 1.0 / pixels_per_second)
+            if not line.visible or line.path.isEmpty():
+                continue
+            # the x-axis is the age of a sample, relative to the newest status of the device:
+            newest_timestamp = line.last_timestamp + MAX_UPDATE_TIMESTAMP_VARIATION.total_seconds()
+            y_scale = -self._plot_rect.height() / (_Y_MAX - _Y_MIN)
+            painter.setTransform(QTransform(
+                pixels_per_second, 0.0, 0.0, y_scale,
+                self._plot_rect.right() - newest_timestamp * pixels_per_second,
+                self._plot_rect.bottom() - _Y_MIN * y_scale,
+            ))
+            painter.setPen(line.pen)
+            painter.drawPath(line.path)
+        painter.resetTransform()
+        painter.setClipping(False)
+        if self._legend_pixmap is None:
+            self._legend_pixmap = self._create_legend_pixmap()
+        painter.drawPixmap(self._legend_origin(), self._legend_pixmap)
+        painter.end()
+
+    def resizeEvent(self, event: QResizeEvent) -> None:
+        self._invalidate_pixmaps()
+        super().resizeEvent(event)
+
+    def mousePressEvent(self, event: QMouseEvent) -> None:
+        if event.button() == Qt.RightButton:
+            self._set_zoom_level(self.zoom_level + 1 if self.zoom_level < len(_ZOOM_LEVELS) else 1)
+        elif event.button() == Qt.LeftButton:
+            self._toggle_line_at(event.position())
+
+    def wheelEvent(self, event: QWheelEvent) -> None:
+        if event.angleDelta().y() < 0 and self.zoom_level < len(_ZOOM_LEVELS):
+            self._set_zoom_level(self.zoom_level + 1)
+        elif event.angleDelta().y() > 0 and self.zoom_level > 1:
+            self._set_zoom_level(self.zoom_level - 1)
+
+    def _update_path(self, line: PainterLine, seconds_per_pixel: float) -> None:
+        """Appends new samples to the line's path, which is only rebuilt when it holds too much or the scale changed"""
+        timestamps = line.device_data.timestamps
+        values = line.values()
+        length = min(len(timestamps), len(values))  # align the newest samples
+        if not length:
+            line.reset_path()
+            return
+        timestamps = timestamps[len(timestamps) - length:] - self._time_base
+        values = values[len(values) - length:]
+        window_start = timestamps[-1] - self.x_limit
+        if line.path.isEmpty() \
+                or line.seconds_per_pixel != seconds_per_pixel \
+                or line.first_timestamp < window_start - self.x_limit / 2 \
+                or line.last_timestamp > timestamps[-1]:
+            # the sample just outside the graph is kept so the line reaches the edge:
+            visible_start = max(int(np.searchsorted(timestamps, window_start)) - 1, 0)
+            x_data, y_data = MathUtils.decimate_min_max(
+                timestamps[visible_start:], values[visible_start:], seconds_per_pixel
+            )
+            line.path = QPainterPath(QPointF(x_data[0], y_data[0]))
+            for x, y in zip(x_data[1:], y_data[1:]):
+                line.path.lineTo(x, y)
+            line.first_timestamp = x_data[0]
+            line.seconds_per_pixel = seconds_per_pixel
+        else:
+            for i in range(int(np.searchsorted(timestamps, line.last_timestamp, side='right')), length):
+                line.path.lineTo(timestamps[i], values[i])
+        line.last_timestamp = timestamps[-1]
+
+    def _set_zoom_level(self, zoom_level: int) -> None:
+        self.zoom_level = zoom_level
+        self.x_limit, self._x_ticks = _ZOOM_LEVELS[zoom_level]
+        self._axes_pixmap = None
+        self.update()
+
+    def _toggle_line_at(self, position: QPointF) -> None:
+        """hide/show specific lines from the legend"""
+        legend_position = position - QPointF(self._legend_origin())
+        for row_rect, line in self._legend_rows:
+            if row_rect.contains(legend_position):
+                line.visible = not line.visible
+                Settings.overview_line_is_visible(line.label, line.visible)
+                self._legend_pixmap = None
+                self.update()
+                return
+
+    def _invalidate_pixmaps(self) -> None:
+        self._axes_pixmap = None
+        self._legend_pixmap = None
+
+    def _new_pixmap(self, width: float, height: float) -> QPixmap:
+        device_pixel_ratio = self.devicePixelRatioF()
+        pixmap = QPixmap(int(width * device_pixel_ratio), int(height * device_pixel_ratio))
+        pixmap.setDevicePixelRatio(device_pixel_ratio)
+        return pixmap
+
+    def _create_axes_pixmap(self) -> QPixmap:
+        pixmap = self._new_pixmap(self.width(), self.height())
+        pixmap.fill(self._bg_color)
+        font_metrics = QFontMetrics(self.font())
+        y_label_width = font_metrics.horizontalAdvance('100°/%')
+        self._plot_rect = QRectF(
+            _MARGIN + y_label_width + _MARGIN, _MARGIN,
+            max(self.width() - y_label_width - 4 * _MARGIN, 1),
+            max(self.height() - font_metrics.height() - 3 * _MARGIN, 1),
+        )
+        painter = QPainter(pixmap)
+        painter.setFont(self.font())
+        grid_color = QColor(self._text_color)
+        grid_color.setAlphaF(0.5)
+        grid_pen = QPen(grid_color, 1, Qt.DotLine)
+        text_pen = QPen(self._text_color)
+        for y_tick in _Y_TICKS:
+            y = self._plot_rect.bottom() - (y_tick - _Y_MIN) * self._plot_rect.height() / (_Y_MAX - _Y_MIN)
+            painter.setPen(grid_pen)
+            painter.drawLine(QPointF(self._plot_rect.left(), y), QPointF(self._plot_rect.right(), y))
+            painter.setPen(text_pen)
+            painter.drawText(
+                QRectF(_MARGIN, y - font_metrics.height() / 2, y_label_width, font_metrics.height()),
+                Qt.AlignRight | Qt.AlignVCenter, f'{y_tick}°/%'
+            )
+        for x_tick, x_label in self._x_ticks:
+            x = self._plot_rect.right() - x_tick * self._plot_rect.width() / self.x_limit
+            painter.setPen(grid_pen)
+            painter.drawLine(QPointF(x, self._plot_rect.top()), QPointF(x, self._plot_rect.bottom()))
+            painter.setPen(text_pen)
+            label_width = font_metrics.horizontalAdvance(x_label)
+            painter.drawText(
+                QRectF(x - label_width / 2, self._plot_rect.bottom() + _MARGIN, label_width, font_metrics.height()),
+                Qt.AlignCenter, x_label
+            )
+        painter.setPen(text_pen)
+        painter.drawLine(self._plot_rect.bottomLeft(), self._plot_rect.bottomRight())
+        painter.drawLine(self._plot_rect.bottomLeft(), self._plot_rect.topLeft())
+        painter.end()
+        return pixmap
+
+    def _legend_origin(self) -> QPointF:
+        return self._plot_rect.topLeft() + QPointF(_MARGIN, _MARGIN)
+
+    def _create_legend_pixmap(self) -> QPixmap:
+        font_metrics = QFontMetrics(self.font())
+        row_height = font_metrics.height() + 2
+        label_width = max((font_metrics.horizontalAdvance(line.label) for line in self.lines), default=0)
+        width = _MARGIN + _LEGEND_LINE_LENGTH + _MARGIN + label_width + _MARGIN
+        height = _MARGIN + row_height * len(self.lines) + _MARGIN
+        pixmap = self._new_pixmap(width, height)
+        pixmap.fill(Qt.transparent)
+        self._legend_rows.clear()
+        if not self.lines:
+            return pixmap
+        painter = QPainter(pixmap)
+        painter.setRenderHint(QPainter.Antialiasing)
+        painter.setFont(self.font())
+        legend_bg_color = QColor(self._bg_color)
+        legend_bg_color.setAlphaF(0.9)
+        painter.setPen(QPen(self._text_color))
+        painter.setBrush(legend_bg_color)
+        painter.drawRoundedRect(QRectF(0.5, 0.5, width - 1, height - 1), 4, 4)
+        for i, line in enumerate(self.lines):
+            row_rect = QRectF(_MARGIN, _MARGIN + i * row_height, width - 2 * _MARGIN, row_height)
+            self._legend_rows.append((row_rect, line))
+            painter.setOpacity(1.0 if line.visible else _HIDDEN_LINE_ALPHA)
+            painter.setPen(line.pen)
+            painter.drawLine(
+                QPointF(row_rect.left(), row_rect.center().y()),
+                QPointF(row_rect.left() + _LEGEND_LINE_LENGTH, row_rect.center().y())
+            )
+            painter.setPen(QPen(self._text_color))
+            painter.drawText(
+                row_rect.adjusted(_LEGEND_LINE_LENGTH + _MARGIN, 0, 0, 0), Qt.AlignLeft | Qt.AlignVCenter, line.label
+            )
+        painter.end()
+        return pixmap
+
+    def _initialize_lines(self) -> None:
+        cpus = self._get_devices_with_type(DeviceType.CPU)
+        for cpu in cpus:
+            data = self._device_data_for(cpu)
+            for temp_status in cpu.status.temps:
+                label = OverviewLabels.create_cpu_label(temp_status.name, len(cpus), cpu.type_id)
+                self._add_line(label, cpu, data, temp_status.name, is_temp=True)
+            for channel_status in cpu.status.channels:
+                label = OverviewLabels.create_cpu_label(channel_status.name, len(cpus), cpu.type_id)
+                self._add_line(label, cpu, data, channel_status.name, is_temp=False)
+        gpus = self._get_devices_with_type(DeviceType.GPU)
+        for gpu in gpus:
+            data = self._device_data_for(gpu)
+            for temp_status in gpu.status.temps:
+                label = OverviewLabels.create_gpu_label(temp_status.name, len(gpus), gpu.type_id)
+                self._add_line(label, gpu, data, temp_status.name, is_temp=True)
+            for channel_status in sorted(gpu.status.channels, key=attrgetter("name")):
+                label = OverviewLabels.create_gpu_label(channel_status.name, len(gpus), gpu.type_id)
+                self._add_line(label, gpu, data, channel_status.name, is_temp=False)
+        for device in self._get_devices_with_type(DeviceType.LIQUIDCTL):
+            if device.lc_driver_type is None:
+                continue
+            data = self._device_data_for(device)
+            for temp_status in sorted(device.status.temps, key=attrgetter("name")):
+                label = OverviewLabels.create_device_label(
+                    self._devices, device.name_short, temp_status.name, device.type_id
+                )
+                self._add_line(label, device, data, temp_status.name, is_temp=True)
+            for channel_status in sorted(device.status.channels, key=attrgetter("name")):
+                if channel_status.duty is not None:
+                    label = OverviewLabels.create_device_label(
+                        self._devices, device.name_short, channel_status.name, device.type_id
+                    )
+                    self._add_line(label, device, data, channel_status.name, is_temp=False)
+        for device in self._get_devices_with_type(DeviceType.HWMON):
+            data = self._device_data_for(device)
+            for temp_status in sorted(device.status.temps, key=attrgetter("name")):
+                label = OverviewLabels.create_device_label(self._devices, device.name, temp_status.name, device.type_id)
+                self._add_line(label, device, data, temp_status.name, is_temp=True)
+            for channel_status in sorted(device.status.channels, key=attrgetter("name")):
+                label = OverviewLabels.create_device_label(
+                    self._devices, device.name, channel_status.name, device.type_id
+                )
+                self._add_line(label, device, data, channel_status.name, is_temp=False)
+        if composite_device := next(iter(self._get_devices_with_type(DeviceType.COMPOSITE)), None):
+            data = self._device_data_for(composite_device)
+            for temp_status in sorted(composite_device.status.temps, key=attrgetter("name")):
+                self._add_line(temp_status.name, composite_device, data, temp_status.name, is_temp=True)
+        self._legend_pixmap = None
+        log.debug('initialized %s system overview lines', len(self.lines))
+
+    def _device_data_for(self, device: Device) -> DeviceData:
+        self._devices_data[device] = DeviceData(device.status_history)
+        return self._devices_data[device]
+
+    def _add_line(self, label: str, device: Device, data: DeviceData, status_name: str, is_temp: bool) -> None:
+        if is_temp:
+            pen = QPen(QColor(device.color(status_name)), 2)
+        else:
+            line_style = Qt.DashDotLine if status_name.startswith('fan') else Qt.DashLine
+            pen = QPen(QColor(device.color(status_name)), 1, line_style)
+        pen.setCosmetic(True)  # the path is scaled, but not the line width and dashes
+        self.lines.append(PainterLine(
+            label=label, device_data=data, status_name=status_name, is_temp=is_temp, pen=pen,
+            visible=Settings.is_overview_line_visible(label)
+        ))
+
+    def _get_devices_with_type(self, device_type: DeviceType) -> list[Device]:
+        return [device for device in self._devices if device.type == device_type]
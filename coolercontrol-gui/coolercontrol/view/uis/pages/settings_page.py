@@ -87,6 +87,8 @@ class SettingsPage(QScrollArea):
         self.base_layout.addItem(self.spacer())
         self.setting_enable_hwmon_filter()
         self.base_layout.addItem(self.spacer())
+        self.setting_enable_native_charts()
+        self.base_layout.addItem(self.spacer())
         self.setting_ui_scaling()
 
         # self.notes_layout = QVBoxLayout()
@@ -328,6 +330,24 @@ class SettingsPage(QScrollArea):
         enable_hwmon_temps_layout.addWidget(enable_hwmon_temps_toggle)
         self.base_layout.addLayout(enable_hwmon_temps_layout)
 
+    def setting_enable_native_charts(self) -> None:
+        enable_native_charts_layout = QHBoxLayout()
+        enable_native_charts_label = QLabel(text='Native Overview')
+        enable_native_charts_label.setToolTip(
+            'Draws the system overview with native Qt painting instead of matplotlib, which uses much less CPU.'
+        )
+        enable_native_charts_layout.addWidget(enable_native_charts_label)
+        enable_native_charts_toggle = PyToggle(
+            bg_color=self.toggle_bg_color,
+            circle_color=self.toggle_circle_color,
+            active_color=self.toggle_active_color,
+            checked=Settings.user.value(UserSettings.ENABLE_NATIVE_CHARTS, defaultValue=True, type=bool)
+        )
+        enable_native_charts_toggle.setObjectName(UserSettings.ENABLE_NATIVE_CHARTS)
+        enable_native_charts_toggle.clicked.connect(self.setting_toggled)
+        enable_native_charts_layout.addWidget(enable_native_charts_toggle)
+        self.base_layout.addLayout(enable_native_charts_layout)
+
     def setting_startup_delay(self) -> None:
         startup_delay_layout = QHBoxLayout()
         startup_delay_label = QLabel(text='Startup Delay')
@@ -15,17 +15,25 @@
 #  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 # ----------------------------------------------------------------------------------------------------------------------
 
-from typing import no_type_check
+from __future__ import annotations
+
+import logging
+from typing import no_type_check, TYPE_CHECKING
 
 from PySide6.QtWidgets import QWidget, QVBoxLayout, QFrame, QHBoxLayout, QMainWindow
 
 from coolercontrol.settings import Settings, UserSettings
 from coolercontrol.view.core.functions import Functions
-from coolercontrol.view.uis.canvases.system_overview_canvas import SystemOverviewCanvas
+from coolercontrol.view.uis.canvases.system_overview_painter import SystemOverviewPainter
 from coolercontrol.view.uis.columns.ui_device_column import Ui_DeviceColumn
 from coolercontrol.view.uis.pages.ui_main_pages import Ui_MainPages
 from coolercontrol.view.widgets import PyWindow, PyLeftMenu, PyLeftColumn, PyTitleBar
 
+if TYPE_CHECKING:
+    from coolercontrol.view.uis.canvases.system_overview_canvas import SystemOverviewCanvas
+
+log = logging.getLogger(__name__)
+
 
 class UI_MainWindow(object):
 
@@ -55,7 +63,7 @@ class UI_MainWindow(object):
         self.device_layout: QVBoxLayout = None
         self.device_bg_frame: QFrame = None
         self.device_column: Ui_DeviceColumn = None
-        self.system_overview_canvas: SystemOverviewCanvas = None
+        self.system_overview_canvas: SystemOverviewPainter | SystemOverviewCanvas = None
 
     def setup_ui(self, parent: QMainWindow) -> None:
         if not parent.objectName():
@@ -279,4 +287,17 @@ class UI_MainWindow(object):
         parent.setCentralWidget(self.central_widget)
 
         # Add system overview chart:
-        self.system_overview_canvas = SystemOverviewCanvas()
+        self.system_overview_canvas = self._create_system_overview_canvas()
+
+    @staticmethod
+    def _create_system_overview_canvas() -> SystemOverviewPainter | SystemOverviewCanvas:
+        if Settings.user.value(UserSettings.ENABLE_NATIVE_CHARTS, defaultValue=True, type=bool):
+            return SystemOverviewPainter()
+        try:
+            # matplotlib is only imported when its canvas is used:
+            # pylint: disable-next=import-outside-toplevel
+            from coolercontrol.view.uis.canvases.system_overview_canvas import SystemOverviewCanvas
+            return SystemOverviewCanvas()
+        except ImportError as err:
+            log.error('The matplotlib system overview could not be loaded, using the native one: %s', err)
+            return SystemOverviewPainter()
@@ -15,24 +15,21 @@
 #  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 # ----------------------------------------------------------------------------------------------------------------------
 
-import io
 import logging
 from pathlib import Path
-from typing import Generator
 
-from PIL import Image, ImageOps, ImageSequence
-from PIL.ImageSequence import Iterator
+from PIL import Image
 from PySide6.QtCore import Qt, Signal, SignalInstance, QObject, QSize, QEvent
 from PySide6.QtGui import QPixmap, QMovie, QPainter, QPainterPath
 from PySide6.QtWidgets import QFileDialog, QPushButton
 
 from coolercontrol.dialogs.dialog_style import DIALOG_STYLE
+from coolercontrol.services.lcd_image_processor import LcdImageCache, LcdImageProcessor
 from coolercontrol.settings import Settings
 from coolercontrol.view.core.functions import Functions
 
 log = logging.getLogger(__name__)
 _WH: int = 320  # the Width and Height of our LCD screen resolution
-_LCD_TOTAL_MEMORY_KB: int = 24_320
 
 
 class ImageChooserButton(QPushButton):
@@ -55,6 +52,7 @@ class ImageChooserButton(QPushButton):
     }}
     """
     image_changed: SignalInstance = Signal(object)  # type: ignore
+    _image_cache: LcdImageCache | None = None  # shared by all buttons
 
     def __init__(self,
                  color: str,
@@ -81,6 +79,8 @@ class ImageChooserButton(QPushButton):
         self.image_path: Path | None = image
         self.image_path_processed: Path | None = None
         self.gif_movie: QMovie | None = None
+        self._image_processor: LcdImageProcessor | None = None
+        self._running_processors: set[LcdImageProcessor] = set()
         self.default_image_file: str = Functions.set_image("image_file_320.png")
         self._dialog_style_sheet = DIALOG_STYLE.format(
             _text_size=Settings.app["font"]["text_size"],
@@ -122,58 +122,71 @@ class ImageChooserButton(QPushButton):
             self.gif_movie.stop()
             self.gif_movie = None
         if image_path is None:
+            self._image_processor = None  # ignores any image still being processed
             self.image_path = None
-            self.image_path_processed = None
+            self._set_image_path_processed(None)
             self.setIcon(QPixmap(self.default_image_file))
             self.image_changed.emit(None)
         else:
             self.process_and_save_image(image_path)
 
     def process_and_save_image(self, image_path: Path) -> None:
-        """process the image so that liquidctl device time is minimized and make it how we want it."""
-        try:
-            image: Image = Image.open(image_path)
-            if image.format is not None and image.format == "GIF":
-                frames: Iterator = ImageSequence.Iterator(image)
-                frames = self._resize_frames(frames)
-                starting_image = next(frames)
-                starting_image.info = image.info
-                self.image_path_processed = Settings.tmp_path.joinpath("lcd_image.gif")
-                starting_image.save(
-                    self.image_path_processed, format="GIF", save_all=True, append_images=list(frames), loop=0,
-                )
-                processed_image: Image = Image.open(self.image_path_processed)
-                image_bytes = io.BytesIO()
-                processed_image.save(
-                    image_bytes, format="GIF", save_all=True, loop=0,
-                )
-                self._verify_image_size(image_bytes.getvalue())  # to_bytes() on gif files only gives first frame bytes
-                processed_image.close()
-                self.image_path = image_path
-                self.gif_movie = QMovie(str(self.image_path_processed))
-                self.gif_movie.frameChanged.connect(
-                    lambda: self.setIcon(self._convert_to_circular_pixmap(self.gif_movie.currentPixmap()))
-                )
-                self.gif_movie.start()
-            else:
-                image = ImageOps.fit(image, (_WH, _WH))  # fit() resizes and crops, keeping aspect ratio
-                self._verify_image_size(image.tobytes())
-                self.image_path_processed = Settings.tmp_path.joinpath("lcd_image.png")
-                image.save(self.image_path_processed)
-                self.image_path = image_path
-                self.setIcon(
-                    self._convert_to_circular_pixmap(image.toqpixmap()))
-            image.close()
-            self.image_changed.emit(image_path)
-        except BaseException as exc:
-            log.error("Image could not be loaded: %s", exc)
-            self.set_image(None)  # reset image
+        """
+        process the image so that liquidctl device time is minimized and make it how we want it.
+        Processing happens in the background and the result is applied once it's done.
+        """
+        if ImageChooserButton._image_cache is None:
+            ImageChooserButton._image_cache = LcdImageCache()
+        processor = LcdImageProcessor(image_path, _WH, ImageChooserButton._image_cache)
+        # bound slots are called in the UI thread, where the processor's sender() tells them apart:
+        processor.progress.connect(self._show_processing_progress)
+        processor.processed.connect(self._image_processed)
+        processor.failed.connect(self._image_processing_failed)
+        # keep a reference until the thread has finished, also when a newer image has been chosen in the meantime
+        processor.finished.connect(self._processor_finished)
+        self._running_processors.add(processor)
+        self._image_processor = processor
+        processor.start()
 
-    @staticmethod
-    def _resize_frames(frames: Iterator) -> Generator[Iterator, None, None]:
-        for frame in frames:
-            resized = frame.copy()
-            yield ImageOps.fit(resized, (_WH, _WH))
+    def _show_processing_progress(self, percent: int) -> None:
+        if self.sender() is self._image_processor:
+            self.setText(f"Processing {percent}%")
+
+    def _processor_finished(self) -> None:
+        self._running_processors.discard(self.sender())
+
+    def _set_image_path_processed(self, processed_path: Path | None) -> None:
+        """The shown image is pinned in the cache, so that other buttons' processing doesn't prune it"""
+        if self.image_path_processed is not None and ImageChooserButton._image_cache is not None:
+            ImageChooserButton._image_cache.unpin(self.image_path_processed)
+        if processed_path is not None and ImageChooserButton._image_cache is not None:
+            ImageChooserButton._image_cache.pin(processed_path)
+        self.image_path_processed = processed_path
+
+    def _image_processed(self, processed_path: Path) -> None:
+        processor = self.sender()
+        if processor is not self._image_processor:
+            return  # a newer image has been chosen
+        self._image_processor = None
+        self.setText("")
+        self.image_path = processor.image_path
+        self._set_image_path_processed(processed_path)
+        if processed_path.suffix == ".gif":
+            self.gif_movie = QMovie(str(processed_path))
+            self.gif_movie.frameChanged.connect(
+                lambda: self.setIcon(self._convert_to_circular_pixmap(self.gif_movie.currentPixmap()))
+            )
+            self.gif_movie.start()
+        else:
+            self.setIcon(self._convert_to_circular_pixmap(QPixmap(str(processed_path))))
+        self.image_changed.emit(processor.image_path)
+
+    def _image_processing_failed(self, _: str) -> None:
+        if self.sender() is not self._image_processor:
+            return
+        self._image_processor = None
+        self.setText("")
+        self.set_image(None)  # reset image
 
     @staticmethod
     def _convert_to_circular_pixmap(source_pixmap: QPixmap) -> QPixmap:
@@ -190,15 +203,6 @@ class ImageChooserButton(QPushButton):
         del painter
         return target_pixmap
 
-    @staticmethod
-    def _verify_image_size(image_bytes: bytes) -> None:
-        """Verify the in-memory data size to make sure it'll fit in LCD memory"""
-        if len(image_bytes) / 1_000 >= _LCD_TOTAL_MEMORY_KB:
-            raise ValueError(
-                f"Image file after processing must be less than 24MB. Current size: "
-                f"{round((len(image_bytes) / 1_000_000), 2)}MB"
-            )
-
     def mousePressEvent(self, event: QEvent) -> None:
         if event.button() == Qt.RightButton:
             self.set_image(None)
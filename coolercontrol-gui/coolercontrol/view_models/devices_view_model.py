@@ -19,6 +19,7 @@ import logging
 import time
 from typing import Callable
 
+from PySide6.QtCore import QObject, Qt, Signal, SignalInstance
 from apscheduler.executors.pool import ThreadPoolExecutor
 from apscheduler.job import Job
 from apscheduler.schedulers.background import BackgroundScheduler
@@ -32,15 +33,20 @@ from coolercontrol.services.dynamic_controls.lcd_controls import LcdControls
 from coolercontrol.services.dynamic_controls.lighting_controls import LightingControls
 from coolercontrol.services.notifications import Notifications
 from coolercontrol.services.sleep_listener import SleepListener
-from coolercontrol.view.uis.canvases.speed_control_canvas import SpeedControlCanvas
 from coolercontrol.view_models.device_observer import DeviceObserver
 from coolercontrol.view_models.device_subject import DeviceSubject
 from coolercontrol.view_models.observer import Observer
+from coolercontrol.view_models.speed_control_subject import SpeedControlSubject
 from coolercontrol.view_models.subject import Subject
 
 log = logging.getLogger(__name__)
 
 
+class StatusUpdateNotifier(QObject):
+    """Delivers status updates from the device communication thread to the Qt main thread"""
+    statuses_updated: SignalInstance = Signal()  # type: ignore
+
+
 class DevicesViewModel(DeviceSubject, Observer):
     """
     The View Model for interaction between the frontend and backend components.
@@ -50,6 +56,8 @@ class DevicesViewModel(DeviceSubject, Observer):
         and also UI state changes that need to be propagated to the devices
     _scheduler : The same background thread scheduler is used for all device communications, which helps
         keep any concurrent device communication interference to a minimum.
+        Observers are notified of status updates on the Qt main thread through a queued signal, so that the UI
+        is never blocked by, nor updated from, the communication thread.
     """
 
     _scheduler: BackgroundScheduler = BackgroundScheduler(
@@ -67,6 +75,10 @@ class DevicesViewModel(DeviceSubject, Observer):
         super().__init__()
         self._notifications: Notifications = Notifications()
         self._sleep_listener: SleepListener = SleepListener(self._scheduled_events)
+        self._status_update_notifier = StatusUpdateNotifier()
+        self._status_update_notifier.statuses_updated.connect(
+            self.notify_observers, Qt.ConnectionType.QueuedConnection
+        )
         self._scheduler.start()
 
     @property
@@ -103,7 +115,10 @@ class DevicesViewModel(DeviceSubject, Observer):
         job: Job = self._scheduler.add_job(
             self._update_statuses,
             IntervalTrigger(seconds=self._schedule_interval_seconds),
-            id='update_statuses'
+            id='update_statuses',
+            # a slow daemon response should skip polls instead of queueing them up:
+            coalesce=True,
+            max_instances=1,
         )
         self._scheduled_events.append(job)
 
@@ -127,14 +142,14 @@ class DevicesViewModel(DeviceSubject, Observer):
     def _update_statuses(self) -> None:
         for device_repo in self._device_repos:
             device_repo.update_statuses()
-        self.notify_observers()
+        self._status_update_notifier.statuses_updated.emit()
 
     def notify_me(self, subject: Subject) -> None:
         if self._device_commander is None:
             log.error('The LiquidctlRepo has not yet been initialized!!!')
             return
-        if isinstance(subject, SpeedControlCanvas):
-            self._device_commander.set_speed(subject)
+        if isinstance(subject, SpeedControlSubject):
+            self._device_commander.set_speed(subject)  # type: ignore
         elif isinstance(subject, LightingControls):
             self._device_commander.set_lighting(subject)
         elif isinstance(subject, LcdControls):
@@ -15,40 +15,219 @@
 #  along with this program.  If not, see <https://www.gnu.org/licenses/>.
 # ----------------------------------------------------------------------------------------------------------------------
 
+import heapq
+import inspect
+import itertools
 import logging
 import queue
-from concurrent.futures import Future, ThreadPoolExecutor
-from typing import Callable
+import threading
+import time
+from concurrent.futures import Future, ThreadPoolExecutor, TimeoutError as FutureTimeoutError
+from enum import IntEnum
+from typing import Callable, Generator, Any
+
+from models import DeviceTimeoutException, DeviceUnavailableException
 
 log = logging.getLogger(__name__)
 
+CIRCUIT_BREAKER_FAILURE_THRESHOLD: int = 5
+CIRCUIT_BREAKER_COOLDOWN_SECONDS: float = 10.0
+
+
+def deadline_from_ms(deadline_ms: int | None) -> float | None:
+    """Converts a remaining time budget in milliseconds to a deadline on the monotonic clock"""
+    return None if deadline_ms is None else time.monotonic() + deadline_ms / 1000
+
+
+class JobPriority(IntEnum):
+    """
+    Jobs of a lower value are run first. Within a priority, jobs are run in the order they were submitted.
+    A cooling command should never wait behind a cosmetic update.
+    """
+    CONTROL = 0  # speed writes and device setup
+    STATUS = 1
+    COSMETIC = 2  # lighting and LCD screens
+
+
+_SHUTDOWN_PRIORITY: int = len(JobPriority)  # after all remaining jobs
+
+
+class _CircuitBreaker:
+    """
+    Stops taking jobs of a priority for a device after repeated failures, so that a single bad device doesn't
+    build up a backlog and tie up server threads. After the cooldown, the next failure opens the circuit again
+    right away, while a success closes it. Each priority has its own breaker, so that failing lighting or LCD
+    jobs never block cooling commands.
+    """
+
+    def __init__(self, priority: JobPriority) -> None:
+        self._priority = priority
+        self._lock = threading.Lock()
+        self._consecutive_failures: int = 0
+        self._open_until: float = 0.0
+
+    def is_open(self) -> bool:
+        with self._lock:
+            return time.monotonic() < self._open_until
+
+    def record_success(self) -> None:
+        with self._lock:
+            self._consecutive_failures = 0
+            self._open_until = 0.0
+
+    def record_failure(self) -> None:
+        with self._lock:
+            self._consecutive_failures += 1
+            if self._consecutive_failures >= CIRCUIT_BREAKER_FAILURE_THRESHOLD:
+                if self._open_until < time.monotonic():
+                    log.error(
+                        f"Device {self._priority.name} jobs failed {self._consecutive_failures} times in a row, "
+                        f"pausing them for {CIRCUIT_BREAKER_COOLDOWN_SECONDS}s"
+                    )
+                self._open_until = time.monotonic() + CIRCUIT_BREAKER_COOLDOWN_SECONDS
+
 
 class _DeviceJob:
-    def __init__(self, future: Future, fn: Callable, **kwargs) -> None:
+    def __init__(
+            self, future: Future, fn: Callable, priority: JobPriority, deadline: float | None,
+            breaker: _CircuitBreaker, **kwargs
+    ) -> None:
         self.future = future
         self.fn = fn
+        self.priority = priority
+        self.deadline = deadline
+        self.breaker = breaker
         self.kwargs = kwargs
+        self.submitted_at: float = time.monotonic()
 
-    def run(self) -> None:
+    def run(self, yield_to_waiting_jobs: Callable[[JobPriority], None]) -> None:
         if not self.future.set_running_or_notify_cancel():
             return
+        if self.deadline is not None and time.monotonic() > self.deadline:
+            # the caller has already given up, so there is no use talking to the device
+            self.future.set_exception(DeviceTimeoutException("Deadline passed before the job was started"))
+            return
         try:
             result = self.fn(**self.kwargs)
+            if inspect.isgenerator(result):
+                result = self._run_steps(result, yield_to_waiting_jobs)
         except BaseException as exc:
+            if not isinstance(exc, ValueError):  # an invalid request says nothing about the device
+                self.breaker.record_failure()
             self.future.set_exception(exc)
             # Break a reference cycle with the exception 'exc'
             self = None
         else:
+            if self.deadline is None or time.monotonic() <= self.deadline:
+                # a late result doesn't make up for the caller's timeout, which was already counted as a failure
+                self.breaker.record_success()
             self.future.set_result(result)
 
+    def _run_steps(
+            self, steps: Generator[None, None, Any], yield_to_waiting_jobs: Callable[[JobPriority], None]
+    ) -> Any:
+        """
+        Jobs that are generators are run step by step. Each yield is a point where the device is in a
+        consistent state, so more important jobs that are waiting can run in between.
+        """
+        while True:
+            try:
+                next(steps)
+            except StopIteration as stop:
+                return stop.value
+            yield_to_waiting_jobs(self.priority)
+
+
+class _DeviceQueue:
+    """A job queue for a single device, with priorities and statistics"""
+
+    def __init__(self) -> None:
+        self.jobs: queue.PriorityQueue = queue.PriorityQueue()
+        self.breakers: dict[JobPriority, _CircuitBreaker] = {
+            priority: _CircuitBreaker(priority) for priority in JobPriority
+        }
+        self._sequence = itertools.count()
+        self._stats_lock = threading.Lock()
+        self._depth: dict[JobPriority, int] = {priority: 0 for priority in JobPriority}
+        self._jobs_run: int = 0
+        self._wait_time_total: float = 0.0
+        self._wait_time_max: float = 0.0
+        self._wait_time_last: float = 0.0
+
+    def put(self, device_job: _DeviceJob | None, priority: int) -> None:
+        if device_job is not None:
+            with self._stats_lock:
+                self._depth[device_job.priority] += 1
+        self.jobs.put((priority, next(self._sequence), device_job))
+
+    def get(self) -> _DeviceJob | None:
+        _, _, device_job = self.jobs.get()
+        self._started(device_job)
+        return device_job
+
+    def get_more_important(self, priority: JobPriority) -> _DeviceJob | None:
+        """Returns the next waiting job with a higher priority than the given one, if there is one"""
+        with self.jobs.mutex:
+            # the queue is a heap, so the first entry is the most important one
+            if not self.jobs.queue or self.jobs.queue[0][0] >= priority:
+                return None
+            # popped under the same lock, as cancelled jobs can be removed from the queue at any time
+            _, _, device_job = heapq.heappop(self.jobs.queue)
+        self._started(device_job)
+        return device_job
+
+    def remove(self, future: Future) -> None:
+        """Removes the waiting job of a cancelled future, so that jobs for an unresponsive device don't pile up"""
+        with self.jobs.mutex:
+            for index, (_, _, device_job) in enumerate(self.jobs.queue):
+                if device_job is not None and device_job.future is future:
+                    del self.jobs.queue[index]
+                    heapq.heapify(self.jobs.queue)
+                    break
+            else:
+                return  # the worker has already taken the job
+        with self._stats_lock:
+            self._depth[device_job.priority] -= 1
+
+    def _started(self, device_job: _DeviceJob | None) -> None:
+        if device_job is None:
+            return
+        wait_time = time.monotonic() - device_job.submitted_at
+        with self._stats_lock:
+            self._depth[device_job.priority] -= 1
+            self._jobs_run += 1
+            self._wait_time_total += wait_time
+            self._wait_time_max = max(self._wait_time_max, wait_time)
+            self._wait_time_last = wait_time
+
+    def stats(self) -> dict[str, Any]:
+        with self._stats_lock:
+            return {
+                "depth": sum(self._depth.values()),
+                "depth_per_priority": {priority.name.lower(): depth for priority, depth in self._depth.items()},
+                "jobs_run": self._jobs_run,
+                "wait_time_avg_ms": round(self._wait_time_total / self._jobs_run * 1000, 3)
+                if self._jobs_run else 0.0,
+                "wait_time_max_ms": round(self._wait_time_max * 1000, 3),
+                "wait_time_last_ms": round(self._wait_time_last * 1000, 3),
+                "circuit_open": any(breaker.is_open() for breaker in self.breakers.values()),
+                "circuit_open_per_priority": {
+                    priority.name.lower(): breaker.is_open() for priority, breaker in self.breakers.items()
+                },
+            }
+
+
+def _queue_worker(dev_queue: _DeviceQueue) -> None:
+    def yield_to_waiting_jobs(priority: JobPriority) -> None:
+        while (waiting_job := dev_queue.get_more_important(priority)) is not None:
+            waiting_job.run(yield_to_waiting_jobs)
 
-def _queue_worker(dev_queue: queue.SimpleQueue) -> None:
     try:
         while True:
-            device_job: _DeviceJob = dev_queue.get()
+            device_job = dev_queue.get()
             if device_job is None:
                 return
-            device_job.run()
+            device_job.run(yield_to_waiting_jobs)
             del device_job
     except BaseException:
         log.critical('Exception in worker', exc_info=True)
@@ -60,29 +239,63 @@ class DeviceExecutor:
     We simultaneously use a Thread Pool to handle communication with separate devices.
     This enables us to talk in parallel to multiple devices, but keep communication for each device synchronous,
     which results in a pretty big speedup for people who have multiple devices.
+    Each device queue runs jobs by priority, so that slow lighting and LCD jobs don't delay cooling commands.
     """
 
     def __init__(self) -> None:
-        self._device_channels: dict[int, queue.SimpleQueue] = {}
+        self._device_channels: dict[int, _DeviceQueue] = {}
         self._thread_pool: ThreadPoolExecutor = None
 
     def set_number_of_devices(self, number_of_devices: int) -> None:
         self._thread_pool = ThreadPoolExecutor(max_workers=number_of_devices)
         for dev_id in range(1, number_of_devices + 1):
-            dev_queue = queue.SimpleQueue()
+            dev_queue = _DeviceQueue()
             self._device_channels[dev_id] = dev_queue
             self._thread_pool.submit(_queue_worker, dev_queue)
 
-    def submit(self, device_id: int, fn: Callable, **kwargs) -> Future:
+    def submit(
+            self, device_id: int, fn: Callable, priority: JobPriority = JobPriority.CONTROL,
+            deadline: float | None = None, **kwargs
+    ) -> Future:
+        """
+        Submits a job for the device. If fn is a generator function,
+        more important jobs are run in between its steps.
+        Jobs whose deadline has passed by the time they would start are skipped.
+        """
         assert self._thread_pool is not None
+        dev_queue = self._device_channels[device_id]
+        breaker = dev_queue.breakers[priority]
+        if breaker.is_open():
+            raise DeviceUnavailableException(
+                f"Device #{device_id} is unavailable for {priority.name} jobs after repeated failures"
+            )
         future = Future()
-        device_job = _DeviceJob(future, fn, **kwargs)
-        self._device_channels[device_id].put(device_job)
+        device_job = _DeviceJob(future, fn, priority, deadline, breaker, **kwargs)
+        dev_queue.put(device_job, priority)
         return future
 
+    def run(
+            self, device_id: int, fn: Callable, priority: JobPriority = JobPriority.CONTROL,
+            deadline: float | None = None, **kwargs
+    ) -> Any:
+        """Submits a job and waits for its result, at most until the deadline"""
+        future = self.submit(device_id, fn, priority, deadline, **kwargs)
+        timeout = None if deadline is None else max(deadline - time.monotonic(), 0.0)
+        try:
+            return future.result(timeout)
+        except FutureTimeoutError as err:
+            dev_queue = self._device_channels[device_id]
+            if future.cancel():  # the job was still waiting, for ex. behind a job the device doesn't respond to
+                dev_queue.remove(future)
+            dev_queue.breakers[priority].record_failure()
+            raise DeviceTimeoutException(f"Device #{device_id} did not respond before the deadline") from err
+
+    def queue_stats(self) -> dict[int, dict[str, Any]]:
+        return {device_id: dev_queue.stats() for device_id, dev_queue in self._device_channels.items()}
+
     def shutdown(self) -> None:
         for channel in self._device_channels.values():
-            channel.put(None)  # ends queue_worker loops
+            channel.put(None, _SHUTDOWN_PRIORITY)  # ends queue_worker loops
         if self._thread_pool is not None:
             self._thread_pool.shutdown()
         self._device_channels.clear()
@@ -16,8 +16,10 @@
 # ----------------------------------------------------------------------------------------------------------------------
 
 import logging
+import time
+from functools import partial
 from http import HTTPStatus
-from typing import List, Tuple, Any, Union
+from typing import List, Tuple, Any, Union, Generator, Callable
 
 import liquidctl
 from fastapi import HTTPException
@@ -33,8 +35,9 @@ from liquidctl.driver.hydro_platinum import HydroPlatinum
 from liquidctl.driver.kraken2 import Kraken2
 from liquidctl.driver.smart_device import SmartDevice2, H1V2, SmartDevice
 
-from device_executor import DeviceExecutor
-from models import LiquidctlException, Device, Statuses, DeviceProperties
+from device_executor import DeviceExecutor, JobPriority
+from models import LiquidctlException, Device, Statuses, DeviceProperties, DeviceTimeoutException, \
+    DeviceUnavailableException
 from test_service_ext import TestServiceExtension, ENABLE_MOCKS
 
 log = logging.getLogger(__name__)
@@ -192,20 +195,18 @@ class DeviceService:
         if not self.devices:
             raise HTTPException(HTTPStatus.BAD_REQUEST, "No Devices found")
         log.info("Connecting to all Liquidctl Devices")
-        for device_id, lc_device in self.devices.items():
-            log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.connect() ")
-            if ENABLE_MOCKS:
-                connect_job = self.device_executor.submit(device_id, TestServiceExtension.connect_mock, lc_device=lc_device)
-            else:
-                # currently only smbus devices have options for connect()
-                connect_job = self.device_executor.submit(device_id, lc_device.connect)
-            try:
-                connect_job.result()
-            except RuntimeError as err:
-                if "already open" in str(err):
-                    log.warning("%s already connected", lc_device.description)
-                else:
-                    raise LiquidctlException("Unexpected Device Communication Error") from err
+        connect_jobs: dict[int, Callable] = {
+            device_id: partial(TestServiceExtension.connect_mock, lc_device=lc_device) if ENABLE_MOCKS
+            # currently only smbus devices have options for connect()
+            else lc_device.connect
+            for device_id, lc_device in self.devices.items()
+        }
+        errors = self._run_lifecycle_jobs("connect", connect_jobs)
+        for device_id, err in list(errors.items()):
+            if isinstance(err, RuntimeError) and "already open" in str(err):
+                log.warning("%s already connected", self.devices[device_id].description)
+                del errors[device_id]
+        self._raise_lifecycle_errors("connect", errors)
 
     def initialize_device(self, device_id: int, init_args: dict[str, str]) -> Statuses:
         if self.devices.get(device_id) is None:
@@ -229,7 +230,7 @@ class DeviceService:
             log.error('Device Communication Error', exc_info=os_exc)
             raise LiquidctlException("Unexpected Device Communication Error") from os_exc
 
-    def get_status(self, device_id: int) -> Statuses:
+    def get_status(self, device_id: int, deadline: float | None = None) -> Statuses:
         if self.devices.get(device_id) is None:
             raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
         log.debug(f"Getting status for device: {device_id}")
@@ -237,87 +238,220 @@ class DeviceService:
             lc_device = self.devices[device_id]
             log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.get_status() ")
             if ENABLE_MOCKS:
-                prepare_mock_job = self.device_executor.submit(
+                self.device_executor.run(
                     device_id,
-                    TestServiceExtension.prepare_for_mocks_get_status, lc_device=lc_device
+                    TestServiceExtension.prepare_for_mocks_get_status, JobPriority.STATUS, deadline, lc_device=lc_device
                 )
-                prepare_mock_job.result()
-            status_job = self.device_executor.submit(device_id, lc_device.get_status)
-            status: List[Tuple[str, Union[str, int, float], str]] = status_job.result()
+            status: List[Tuple[str, Union[str, int, float], str]] = self.device_executor.run(
+                device_id, lc_device.get_status, JobPriority.STATUS, deadline
+            )
             log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.get_status() RESPONSE: {status}")
             return self._stringify_status(status)
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
         except BaseException as err:
             log.error("Error getting status:", exc_info=err)
             raise LiquidctlException("Unexpected Device communication error") from err
 
-    def set_fixed_speed(self, device_id: int, speed_kwargs: dict[str, str | int]) -> None:
+    def set_fixed_speed(
+            self, device_id: int, speed_kwargs: dict[str, str | int], deadline: float | None = None
+    ) -> None:
         if self.devices.get(device_id) is None:
             raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
         log.debug(f"Setting fixes speed for device: {device_id} with args: {speed_kwargs}")
         try:
             lc_device = self.devices[device_id]
             log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.set_fixed_speed({speed_kwargs}) ")
-            status_job = self.device_executor.submit(device_id, lc_device.set_fixed_speed, **speed_kwargs)
-            status_job.result()
+            self.device_executor.run(
+                device_id, lc_device.set_fixed_speed, JobPriority.CONTROL, deadline, **speed_kwargs
+            )
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
         except BaseException as err:
             log.error("Error setting fixed speed:", exc_info=err)
             raise LiquidctlException("Unexpected Device communication error") from err
 
-    def set_speed_profile(self, device_id: int, speed_kwargs: dict[str, Any]) -> None:
+    def set_fixed_speeds(
+            self, device_id: int, speeds_kwargs: list[dict[str, str | int]], deadline: float | None = None
+    ) -> None:
+        """Sets multiple channels in a single device job, so other jobs don't interleave"""
+        if self.devices.get(device_id) is None:
+            raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
+        log.debug(f"Setting fixed speeds for device: {device_id} with args: {speeds_kwargs}")
+        try:
+            lc_device = self.devices[device_id]
+
+            def set_speeds() -> None:
+                for speed_kwargs in speeds_kwargs:
+                    log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.set_fixed_speed({speed_kwargs}) ")
+                    lc_device.set_fixed_speed(**speed_kwargs)
+
+            self.device_executor.run(device_id, set_speeds, JobPriority.CONTROL, deadline)
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
+        except BaseException as err:
+            log.error("Error setting fixed speeds:", exc_info=err)
+            raise LiquidctlException("Unexpected Device communication error") from err
+
+    def set_speed_profile(self, device_id: int, speed_kwargs: dict[str, Any], deadline: float | None = None) -> None:
         if self.devices.get(device_id) is None:
             raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
         log.debug(f"Setting speed profile for device: {device_id} with args: {speed_kwargs}")
         try:
             lc_device = self.devices[device_id]
             log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.set_speed_profile({speed_kwargs}) ")
-            status_job = self.device_executor.submit(device_id, lc_device.set_speed_profile, **speed_kwargs)
-            status_job.result()
+            self.device_executor.run(
+                device_id, lc_device.set_speed_profile, JobPriority.CONTROL, deadline, **speed_kwargs
+            )
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
         except BaseException as err:
             log.error("Error setting speed profile:", exc_info=err)
             raise LiquidctlException("Unexpected Device communication error") from err
 
-    def set_color(self, device_id: int, color_kwargs: dict[str, Any]) -> None:
+    def set_color(self, device_id: int, color_kwargs: dict[str, Any], deadline: float | None = None) -> None:
         if self.devices.get(device_id) is None:
             raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
         log.debug(f"Setting color for device: {device_id} with args: {color_kwargs}")
         try:
             lc_device = self.devices[device_id]
             log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.set_color({color_kwargs}) ")
-            status_job = self.device_executor.submit(device_id, lc_device.set_color, **color_kwargs)
-            status_job.result()
+            self.device_executor.run(
+                device_id, lc_device.set_color, JobPriority.COSMETIC, deadline, **color_kwargs
+            )
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
         except BaseException as err:
             log.error("Error setting color:", exc_info=err)
             raise LiquidctlException("Unexpected Device communication error") from err
 
-    def set_screen(self, device_id: int, screen_kwargs: dict[str, str]) -> None:
+    def set_screen(self, device_id: int, screen_kwargs: dict[str, str], deadline: float | None = None) -> None:
         if self.devices.get(device_id) is None:
             raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
         log.debug(f"Setting screen for device: {device_id} with args: {screen_kwargs}")
         try:
             lc_device = self.devices[device_id]
             log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.set_screen({screen_kwargs}) ")
-            status_job = self.device_executor.submit(device_id, lc_device.set_screen, **screen_kwargs)
-            status_job.result()
+            self.device_executor.run(
+                device_id, lc_device.set_screen, JobPriority.COSMETIC, deadline, **screen_kwargs
+            )
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
         except BaseException as err:
             log.error("Error setting screen:", exc_info=err)
             raise LiquidctlException("Unexpected Device communication error") from err
 
+    def set_screens(
+            self, device_id: int, screens_kwargs: list[dict[str, str]], deadline: float | None = None
+    ) -> list[str]:
+        """
+        Sets multiple screen settings back to back in a single device job,
+        with waiting cooling commands and status requests able to run between them.
+        Brightness and orientation errors don't abort the job and their modes are returned instead.
+        """
+        if self.devices.get(device_id) is None:
+            raise HTTPException(HTTPStatus.NOT_FOUND, f"Device with id:{device_id} not found")
+        log.debug(f"Setting screens for device: {device_id} with args: {screens_kwargs}")
+        try:
+            lc_device = self.devices[device_id]
+
+            def set_screens() -> Generator[None, None, list[str]]:
+                failed_modes: list[str] = []
+                for screen_kwargs in screens_kwargs:
+                    log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.set_screen({screen_kwargs}) ")
+                    if screen_kwargs["mode"] not in ["brightness", "orientation"]:
+                        lc_device.set_screen(**screen_kwargs)
+                    else:
+                        try:
+                            lc_device.set_screen(**screen_kwargs)
+                        except BaseException as err:
+                            log.error(f"Error setting screen {screen_kwargs['mode']}:", exc_info=err)
+                            failed_modes.append(screen_kwargs["mode"])
+                    yield
+                return failed_modes
+
+            return self.device_executor.run(device_id, set_screens, JobPriority.COSMETIC, deadline)
+        except (DeviceTimeoutException, DeviceUnavailableException):
+            raise  # passed on as is, for their own response status
+        except BaseException as err:
+            log.error("Error setting screens:", exc_info=err)
+            raise LiquidctlException("Unexpected Device communication error") from err
+
+    def get_queue_stats(self) -> dict[int, dict[str, Any]]:
+        return self.device_executor.queue_stats()
+
     def disconnect_all(self) -> None:
-        for device_id, lc_device in self.devices.items():
-            log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.disconnect() ")
-            disconnect_job = self.device_executor.submit(device_id, lc_device.disconnect)
-            disconnect_job.result()
+        disconnect_jobs: dict[int, Callable] = {
+            device_id: lc_device.disconnect for device_id, lc_device in self.devices.items()
+        }
+        errors = self._run_lifecycle_jobs("disconnect", disconnect_jobs)
         self.devices.clear()
+        self._raise_lifecycle_errors("disconnect", errors)
 
     def shutdown(self) -> None:
-        for device_id, lc_device in self.devices.items():
-            if isinstance(lc_device, CorsairHidPsu):  # attempt to reset fan control back to hardware
-                log.debug_lc(f"LC #{device_id} {lc_device.__class__.__name__}.initialize() ")
-                init_job = self.device_executor.submit(device_id, lc_device.initialize)
-                init_job.result()
-        self.disconnect_all()
+        reset_jobs: dict[int, Callable] = {
+            device_id: lc_device.initialize for device_id, lc_device in self.devices.items()
+            if isinstance(lc_device, CorsairHidPsu)  # attempt to reset fan control back to hardware
+        }
+        try:
+            self._raise_lifecycle_errors("initialize", self._run_lifecycle_jobs("initialize", reset_jobs))
+        except LiquidctlException:
+            pass  # already logged, we still want to disconnect all devices
+        try:
+            self.disconnect_all()
+        except LiquidctlException:
+            pass  # already logged, we still want to shut down the executor
         self.device_executor.shutdown()
 
+    def _run_lifecycle_jobs(self, operation: str, device_jobs: dict[int, Callable]) -> dict[int, BaseException]:
+        """
+        Submits the job for every device to its queue before waiting on any of them,
+        so that a slow device doesn't hold up the others. Returns the errors by device id.
+        """
+        if not device_jobs:
+            return {}
+        start_time: float = time.monotonic()
+        durations_ms: dict[int, float] = {}
+        errors: dict[int, BaseException] = {}
+        futures = {}
+        for device_id, job in device_jobs.items():
+            log.debug_lc(f"LC #{device_id} {self.devices[device_id].__class__.__name__}.{operation}() ")
+            try:
+                futures[device_id] = self.device_executor.submit(
+                    device_id, partial(self._timed_job, job, device_id, durations_ms)
+                )
+            except DeviceUnavailableException as err:
+                errors[device_id] = err
+        for device_id, future in futures.items():
+            try:
+                future.result()
+            except BaseException as err:
+                errors[device_id] = err
+        log.info(
+            f"{operation}() for {len(device_jobs)} devices took {(time.monotonic() - start_time) * 1000:.0f}ms. "
+            f"Per device: {', '.join(f'#{dev_id}: {ms:.0f}ms' for dev_id, ms in sorted(durations_ms.items()))}"
+        )
+        return errors
+
+    @staticmethod
+    def _raise_lifecycle_errors(operation: str, errors: dict[int, BaseException]) -> None:
+        """Logs the error for each device and raises a single exception for all of them"""
+        if not errors:
+            return
+        for device_id, err in errors.items():
+            log.error(f"LC #{device_id} {operation}() failed", exc_info=err)
+        raise LiquidctlException(
+            f"Unexpected Device Communication Error for devices: {sorted(errors)}"
+        ) from next(iter(errors.values()))
+
+    @staticmethod
+    def _timed_job(job: Callable, device_id: int, durations_ms: dict[int, float]) -> Any:
+        start_time: float = time.monotonic()
+        try:
+            return job()
+        finally:
+            durations_ms[device_id] = (time.monotonic() - start_time) * 1000
+
     @staticmethod
     def _stringify_status(
             statuses: List[Tuple[str, Union[str, int, float], str]]
@@ -26,6 +26,14 @@ class LiquidctlException(Exception):
     pass
 
 
+class DeviceTimeoutException(LiquidctlException):
+    pass
+
+
+class DeviceUnavailableException(LiquidctlException):
+    pass
+
+
 # Dataclasses are used for fast ORJSON Response serialization, all others use Pydantic
 
 @dataclass
@@ -65,6 +73,10 @@ class FixedSpeedRequest(BaseModel):
     duty: int
 
 
+class FixedSpeedBatchRequest(BaseModel):
+    speeds: list[FixedSpeedRequest]
+
+
 class SpeedProfileRequest(BaseModel):
     channel: str
     profile: list[tuple[int, int]]
@@ -84,3 +96,7 @@ class ScreenRequest(BaseModel):
     channel: str
     mode: str
     value: str | None
+
+
+class ScreenBatchRequest(BaseModel):
+    screens: list[ScreenRequest]
@@ -21,12 +21,14 @@ import signal
 from http import HTTPStatus
 
 import uvicorn
-from fastapi import FastAPI, Request
+from fastapi import FastAPI, Request, Header
 from fastapi.responses import ORJSONResponse
 
+from device_executor import deadline_from_ms
 from device_service import DeviceService
-from models import Handshake, LiquidctlException, LiquidctlError, Statuses, InitRequest, FixedSpeedRequest, \
-    SpeedProfileRequest, ColorRequest, ScreenRequest
+from models import Handshake, LiquidctlException, LiquidctlError, DeviceTimeoutException, \
+    DeviceUnavailableException, Statuses, InitRequest, FixedSpeedRequest, FixedSpeedBatchRequest, \
+    SpeedProfileRequest, ColorRequest, ScreenRequest, ScreenBatchRequest
 
 SYSTEMD_SOCKET_FD: int = 3
 DEFAULT_PORT: int = 11986  # 11987 is the gui std port
@@ -43,6 +45,23 @@ async def liquidctl_exception_handler(request: Request, exc: LiquidctlException)
     )
 
 
+@api.exception_handler(DeviceTimeoutException)
+async def device_timeout_exception_handler(request: Request, exc: DeviceTimeoutException) -> ORJSONResponse:
+    log.warning(f"{request.url.path}: {exc}")
+    return ORJSONResponse(
+        status_code=HTTPStatus.GATEWAY_TIMEOUT,
+        content=LiquidctlError(message=str(exc))
+    )
+
+
+@api.exception_handler(DeviceUnavailableException)
+async def device_unavailable_exception_handler(request: Request, exc: DeviceUnavailableException) -> ORJSONResponse:
+    return ORJSONResponse(
+        status_code=HTTPStatus.SERVICE_UNAVAILABLE,
+        content=LiquidctlError(message=str(exc))
+    )
+
+
 @api.get("/handshake")
 async def handshake():
     log.info("Exchanging handshake")
@@ -61,6 +80,12 @@ def connect_devices():
     return {"connected": True}
 
 
+@api.get("/devices/queues", response_class=ORJSONResponse)
+def get_device_queues() -> ORJSONResponse:
+    queue_stats = device_service.get_queue_stats()
+    return ORJSONResponse({"queues": queue_stats})
+
+
 @api.put("/devices/{device_id}/legacy690", response_class=ORJSONResponse)
 def set_device_as_legacy690(device_id: int) -> ORJSONResponse:
     device = device_service.set_device_as_legacy690(device_id)
@@ -68,33 +93,60 @@ def set_device_as_legacy690(device_id: int) -> ORJSONResponse:
 
 
 @api.put("/devices/{device_id}/speed/fixed", response_class=ORJSONResponse)
-def set_fixed_speed(device_id: int, speed_request: FixedSpeedRequest) -> ORJSONResponse:
+def set_fixed_speed(
+        device_id: int, speed_request: FixedSpeedRequest, deadline_ms: int | None = Header(default=None)
+) -> ORJSONResponse:
     speed_kwargs = speed_request.dict(exclude_none=True)
-    device_service.set_fixed_speed(device_id, speed_kwargs)
+    device_service.set_fixed_speed(device_id, speed_kwargs, deadline_from_ms(deadline_ms))
     return ORJSONResponse({"set_fixed_speed": True})
 
 
+@api.put("/devices/{device_id}/speed/fixed/batch", response_class=ORJSONResponse)
+def set_fixed_speeds(
+        device_id: int, speed_batch_request: FixedSpeedBatchRequest, deadline_ms: int | None = Header(default=None)
+) -> ORJSONResponse:
+    speeds_kwargs = [speed_request.dict(exclude_none=True) for speed_request in speed_batch_request.speeds]
+    device_service.set_fixed_speeds(device_id, speeds_kwargs, deadline_from_ms(deadline_ms))
+    return ORJSONResponse({"set_fixed_speeds": True})
+
+
 @api.put("/devices/{device_id}/speed/profile", response_class=ORJSONResponse)
-def set_fixed_speed(device_id: int, speed_request: SpeedProfileRequest) -> ORJSONResponse:
+def set_fixed_speed(
+        device_id: int, speed_request: SpeedProfileRequest, deadline_ms: int | None = Header(default=None)
+) -> ORJSONResponse:
     speed_kwargs = speed_request.dict(exclude_none=True)
-    device_service.set_speed_profile(device_id, speed_kwargs)
+    device_service.set_speed_profile(device_id, speed_kwargs, deadline_from_ms(deadline_ms))
     return ORJSONResponse({"set_speed_profile": True})
 
 
 @api.put("/devices/{device_id}/color", response_class=ORJSONResponse)
-def set_color(device_id: int, color_request: ColorRequest) -> ORJSONResponse:
+def set_color(
+        device_id: int, color_request: ColorRequest, deadline_ms: int | None = Header(default=None)
+) -> ORJSONResponse:
     color_kwargs = color_request.dict(exclude_none=True)
-    device_service.set_color(device_id, color_kwargs)
+    device_service.set_color(device_id, color_kwargs, deadline_from_ms(deadline_ms))
     return ORJSONResponse({"set_color": True})
 
 
 @api.put("/devices/{device_id}/screen", response_class=ORJSONResponse)
-def set_color(device_id: int, screen_request: ScreenRequest) -> ORJSONResponse:
+def set_color(
+        device_id: int, screen_request: ScreenRequest, deadline_ms: int | None = Header(default=None)
+) -> ORJSONResponse:
     screen_kwargs = screen_request.dict(exclude_none=False)  # need None value for liquid mode
-    device_service.set_screen(device_id, screen_kwargs)
+    device_service.set_screen(device_id, screen_kwargs, deadline_from_ms(deadline_ms))
     return ORJSONResponse({"set_screen": True})
 
 
+@api.put("/devices/{device_id}/screen/batch", response_class=ORJSONResponse)
+def set_screens(
+        device_id: int, screen_batch_request: ScreenBatchRequest, deadline_ms: int | None = Header(default=None)
+) -> ORJSONResponse:
+    # need None value for liquid mode
+    screens_kwargs = [screen_request.dict(exclude_none=False) for screen_request in screen_batch_request.screens]
+    failed_modes = device_service.set_screens(device_id, screens_kwargs, deadline_from_ms(deadline_ms))
+    return ORJSONResponse({"set_screens": True, "failed_modes": failed_modes})
+
+
 @api.post("/devices/{device_id}/initialize", response_class=ORJSONResponse)
 def init_device(device_id: int, init_request: InitRequest) -> ORJSONResponse:
     init_args = init_request.dict(exclude_none=True)
@@ -103,8 +155,8 @@ def init_device(device_id: int, init_request: InitRequest) -> ORJSONResponse:
 
 
 @api.get("/devices/{device_id}/status", response_class=ORJSONResponse)
-def get_status(device_id: int) -> ORJSONResponse:
-    status: Statuses = device_service.get_status(device_id)
+def get_status(device_id: int, deadline_ms: int | None = Header(default=None)) -> ORJSONResponse:
+    status: Statuses = device_service.get_status(device_id, deadline_from_ms(deadline_ms))
     return ORJSONResponse({"status": status})
 
 
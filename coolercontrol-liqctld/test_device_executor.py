@@ -0,0 +1,99 @@
+#  CoolerControl - monitor and control your cooling and other devices
+#  Copyright (c) 2022  Guy Boldon
+#  |
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#  |
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#  |
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+# ----------------------------------------------------------------------------------------------------------------------
+
+import threading
+import unittest
+
+from device_executor import CIRCUIT_BREAKER_FAILURE_THRESHOLD, DeviceExecutor, JobPriority, deadline_from_ms
+from models import DeviceTimeoutException, DeviceUnavailableException
+
+DEVICE_ID: int = 1
+
+
+def failing_usb_write() -> None:
+    raise OSError("USB write failed")
+
+
+def invalid_request() -> None:
+    raise ValueError("Unsupported mode")
+
+
+def set_speed() -> str:
+    return "speed set"
+
+
+class DeviceExecutorCircuitBreakerTest(unittest.TestCase):
+
+    def setUp(self) -> None:
+        self.executor = DeviceExecutor()
+        self.executor.set_number_of_devices(1)
+        self.device_responds = threading.Event()
+
+    def tearDown(self) -> None:
+        self.device_responds.set()
+        self.executor.shutdown()
+
+    def fail_jobs(self, fn, priority: JobPriority) -> None:
+        for _ in range(CIRCUIT_BREAKER_FAILURE_THRESHOLD):
+            with self.assertRaises(Exception):
+                self.executor.run(DEVICE_ID, fn, priority)
+
+    def test_failing_cosmetic_jobs_do_not_block_control_jobs(self) -> None:
+        self.fail_jobs(failing_usb_write, JobPriority.COSMETIC)
+
+        with self.assertRaises(DeviceUnavailableException):
+            self.executor.submit(DEVICE_ID, failing_usb_write, JobPriority.COSMETIC)
+        self.assertEqual(self.executor.run(DEVICE_ID, set_speed, JobPriority.CONTROL), "speed set")
+        self.assertEqual(self.executor.run(DEVICE_ID, set_speed, JobPriority.STATUS), "speed set")
+
+    def test_failing_control_jobs_open_the_circuit(self) -> None:
+        self.fail_jobs(failing_usb_write, JobPriority.CONTROL)
+
+        with self.assertRaises(DeviceUnavailableException):
+            self.executor.submit(DEVICE_ID, set_speed, JobPriority.CONTROL)
+
+    def test_invalid_requests_do_not_open_the_circuit(self) -> None:
+        self.fail_jobs(invalid_request, JobPriority.CONTROL)
+
+        self.assertEqual(self.executor.run(DEVICE_ID, set_speed, JobPriority.CONTROL), "speed set")
+
+    def test_timeouts_for_a_wedged_device_open_the_circuit(self) -> None:
+        self.executor.submit(DEVICE_ID, self.device_responds.wait, JobPriority.STATUS)
+
+        for _ in range(2 * CIRCUIT_BREAKER_FAILURE_THRESHOLD):
+            with self.assertRaises((DeviceTimeoutException, DeviceUnavailableException)):
+                self.executor.run(DEVICE_ID, set_speed, JobPriority.STATUS, deadline_from_ms(10))
+
+        with self.assertRaises(DeviceUnavailableException):
+            self.executor.submit(DEVICE_ID, set_speed, JobPriority.STATUS)
+        stats = self.executor.queue_stats()[DEVICE_ID]
+        self.assertTrue(stats["circuit_open_per_priority"]["status"])
+        self.assertEqual(stats["depth"], 0)
+
+    def test_timeouts_of_a_running_job_open_the_circuit(self) -> None:
+        for _ in range(CIRCUIT_BREAKER_FAILURE_THRESHOLD):
+            with self.assertRaises(DeviceTimeoutException):
+                self.executor.run(DEVICE_ID, self.device_responds.wait, JobPriority.CONTROL, deadline_from_ms(10))
+            self.device_responds.set()  # the late result must not close the circuit again
+            self.device_responds.clear()
+
+        with self.assertRaises(DeviceUnavailableException):
+            self.executor.submit(DEVICE_ID, set_speed, JobPriority.CONTROL)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -29,7 +29,7 @@ use toml_edit::{Document, Formatted, InlineTable, Item, Table, Value};
 
 use crate::device::UID;
 use crate::repositories::repository::DeviceLock;
-use crate::setting::{CoolerControlSettings, LcdSettings, LightingSettings, Setting, TempSource};
+use crate::setting::{CoolerControlSettings, FanGroup, FanGroupMember, FeedForward, LcdSettings, LightingSettings, PidSettings, ProfileSet, Setting, TempSource};
 
 const DEFAULT_CONFIG_DIR: &str = "/etc/coolercontrol";
 const DEFAULT_CONFIG_FILE_PATH: &str = concatcp!(DEFAULT_CONFIG_DIR, "/config.toml");
@@ -73,10 +73,29 @@ impl Config {
             error!("Configuration File contains invalid settings: {}", err);
             return Err(err);
         };
+        if let Err(err) = config.get_fan_groups().await {
+            error!("Configuration File contains invalid fan groups: {}", err);
+            return Err(err);
+        };
+        if let Err(err) = config.get_profile_sets().await {
+            error!("Configuration File contains invalid profile sets: {}", err);
+            return Err(err);
+        };
         info!("Configuration file check successful");
         Ok(config)
     }
 
+    /// Creates a configuration from the given file contents, without reading or checking the file.
+    #[cfg(test)]
+    pub fn from_contents(path: PathBuf, contents: &str) -> Result<Self> {
+        let document = contents.parse::<Document>()
+            .with_context(|| "Parsing configuration contents")?;
+        Ok(Self {
+            path,
+            document: RwLock::new(document),
+        })
+    }
+
     /// saves any changes to the configuration file - preserving formatting and comments
     pub async fn save_config_file(&self) -> Result<()> {
         tokio::fs::write(
@@ -130,22 +149,50 @@ impl Config {
                 *channel_setting = Item::None;  // removes channel from settings
             } else if let Some(speed_fixed) = setting.speed_fixed {
                 Self::set_setting_fixed_speed(channel_setting, speed_fixed);
+            } else if let Some(pid) = &setting.speed_pid {
+                Self::set_setting_speed_pid(channel_setting, setting, pid)
             } else if let Some(profile) = &setting.speed_profile {
                 Self::set_setting_speed_profile(channel_setting, setting, profile)
             } else if let Some(lighting) = &setting.lighting {
                 Self::set_setting_lighting(channel_setting, lighting);
+                // used by the temperature gradient lighting effect
+                Self::set_setting_optional_temp_source(channel_setting, setting);
                 if &setting.channel_name != "sync" {
                     device_settings["sync"] = Item::None;
                 }
             } else if let Some(lcd) = &setting.lcd {
                 Self::set_setting_lcd(channel_setting, lcd);
+                // used by the daemon-rendered sensors mode
+                Self::set_setting_optional_temp_source(channel_setting, setting);
+            }
+        }
+        let is_speed_setting = setting.reset_to_default.unwrap_or(false) || setting.speed_fixed.is_some()
+            || setting.speed_pid.is_some() || setting.speed_profile.is_some();
+        if is_speed_setting {
+            // the channel has left its fan group, so that the group doesn't take it back on the next start
+            if let Err(err) = self.remove_fan_group_member(&device_uid.to_string(), &setting.channel_name).await {
+                error!("Error removing fan group member: {} channel: {} from the config: {}", device_uid, setting.channel_name, err);
             }
         }
     }
 
+    fn set_setting_optional_temp_source(channel_setting: &mut Item, setting: &Setting) {
+        channel_setting["temp_source"] = Item::None;
+        if let Some(temp_source) = &setting.temp_source {
+            channel_setting["temp_source"]["temp_name"] = Item::Value(
+                Value::String(Formatted::new(temp_source.temp_name.clone()))
+            );
+            channel_setting["temp_source"]["device_uid"] = Item::Value(
+                Value::String(Formatted::new(temp_source.device_uid.clone()))
+            );
+        }
+    }
+
     fn set_setting_fixed_speed(channel_setting: &mut Item, speed_fixed: u8) {
         channel_setting["speed_profile"] = Item::None;  // clear profile setting
         channel_setting["temp_source"] = Item::None; // clear fixed setting
+        channel_setting["speed_feed_forward"] = Item::None;
+        channel_setting["speed_pid"] = Item::None;
         channel_setting["speed_fixed"] = Item::Value(
             Value::Integer(Formatted::new(speed_fixed as i64))
         );
@@ -160,9 +207,38 @@ impl Config {
             profile_array.push(pair_array);
         }
         channel_setting["speed_fixed"] = Item::None; // clear fixed setting
+        channel_setting["speed_pid"] = Item::None;
         channel_setting["speed_profile"] = Item::Value(
             Value::Array(profile_array)
         );
+        Self::set_setting_temp_source(channel_setting, setting);
+        Self::set_setting_feed_forward(channel_setting, setting);
+    }
+
+    fn set_setting_speed_pid(channel_setting: &mut Item, setting: &Setting, pid: &PidSettings) {
+        channel_setting["speed_fixed"] = Item::None;
+        channel_setting["speed_profile"] = Item::None;
+        channel_setting["speed_pid"] = Item::None;
+        channel_setting["speed_pid"]["target_temp"] = Item::Value(
+            Value::Float(Formatted::new(pid.target_temp))
+        );
+        channel_setting["speed_pid"]["kp"] = Item::Value(
+            Value::Float(Formatted::new(pid.kp))
+        );
+        channel_setting["speed_pid"]["ki"] = Item::Value(
+            Value::Float(Formatted::new(pid.ki))
+        );
+        channel_setting["speed_pid"]["kd"] = Item::Value(
+            Value::Float(Formatted::new(pid.kd))
+        );
+        channel_setting["speed_pid"]["derivative_filter"] = Item::Value(
+            Value::Float(Formatted::new(pid.derivative_filter))
+        );
+        Self::set_setting_temp_source(channel_setting, setting);
+        Self::set_setting_feed_forward(channel_setting, setting);
+    }
+
+    fn set_setting_temp_source(channel_setting: &mut Item, setting: &Setting) {
         if let Some(temp_source) = &setting.temp_source {
             channel_setting["temp_source"]["temp_name"] = Item::Value(
                 Value::String(Formatted::new(temp_source.temp_name.clone()))
@@ -173,6 +249,30 @@ impl Config {
         }
     }
 
+    fn set_setting_feed_forward(channel_setting: &mut Item, setting: &Setting) {
+        channel_setting["speed_feed_forward"] = Item::None;
+        if let Some(feed_forward) = &setting.speed_feed_forward {
+            channel_setting["speed_feed_forward"]["device_uid"] = Item::Value(
+                Value::String(Formatted::new(feed_forward.device_uid.clone()))
+            );
+            channel_setting["speed_feed_forward"]["channel_name"] = Item::Value(
+                Value::String(Formatted::new(feed_forward.channel_name.clone()))
+            );
+            channel_setting["speed_feed_forward"]["threshold"] = Item::Value(
+                Value::Integer(Formatted::new(feed_forward.threshold as i64))
+            );
+            channel_setting["speed_feed_forward"]["gain"] = Item::Value(
+                Value::Float(Formatted::new(feed_forward.gain))
+            );
+            channel_setting["speed_feed_forward"]["rate_gain"] = Item::Value(
+                Value::Float(Formatted::new(feed_forward.rate_gain))
+            );
+            channel_setting["speed_feed_forward"]["max_boost"] = Item::Value(
+                Value::Integer(Formatted::new(feed_forward.max_boost as i64))
+            );
+        }
+    }
+
     fn set_setting_lighting(channel_setting: &mut Item, lighting: &LightingSettings) {
         channel_setting["lighting"] = Item::None;
         channel_setting["lighting"]["mode"] = Item::Value(
@@ -252,33 +352,94 @@ impl Config {
     /// Retrieves the device settings from the config file to our Setting model.
     /// This has to be done defensively, as the user may change the config file.
     pub async fn get_device_settings(&self, device_uid: &str) -> Result<Vec<Setting>> {
-        let mut settings = Vec::new();
         if let Some(table_item) = self.document.read().await["device-settings"].get(device_uid) {
             let table = table_item.as_table().with_context(|| "device setting should be a table")?;
-            for (channel_name, base_item) in table.iter() {
-                let setting_table = base_item.as_inline_table()
-                    .with_context(|| "Channel Setting should be an inline table")?;
-                let speed_fixed = Self::get_speed_fixed(setting_table)?;
-                let speed_profile = Self::get_speed_profile(setting_table)?;
-                let temp_source = Self::get_temp_source(setting_table)?;
-                let lighting = Self::get_lighting(setting_table)?;
-                let lcd = Self::get_lcd(setting_table)?;
-                let pwm_mode = Self::get_pwm_mode(setting_table)?;
-                settings.push(Setting {
-                    channel_name: channel_name.to_string(),
-                    speed_fixed,
-                    speed_profile,
-                    temp_source,
-                    lighting,
-                    lcd,
-                    pwm_mode,
-                    reset_to_default: None,
-                });
-            }
+            Self::get_channel_settings(table)
+        } else {
+            Ok(Vec::new())
+        }
+    }
+
+    /// Reads the channel settings of a device table.
+    /// The same format is used for device-settings and profile-sets.
+    fn get_channel_settings(table: &Table) -> Result<Vec<Setting>> {
+        let mut settings = Vec::new();
+        for (channel_name, base_item) in table.iter() {
+            let setting_table = base_item.as_inline_table()
+                .with_context(|| "Channel Setting should be an inline table")?;
+            let speed_fixed = Self::get_speed_fixed(setting_table)?;
+            let speed_profile = Self::get_speed_profile(setting_table)?;
+            let temp_source = Self::get_temp_source(setting_table)?;
+            let speed_feed_forward = Self::get_speed_feed_forward(setting_table)?;
+            let speed_pid = Self::get_speed_pid(setting_table)?;
+            let lighting = Self::get_lighting(setting_table)?;
+            let lcd = Self::get_lcd(setting_table)?;
+            let pwm_mode = Self::get_pwm_mode(setting_table)?;
+            settings.push(Setting {
+                channel_name: channel_name.to_string(),
+                speed_fixed,
+                speed_profile,
+                temp_source,
+                speed_feed_forward,
+                speed_pid,
+                lighting,
+                lcd,
+                pwm_mode,
+                reset_to_default: None,
+            });
         }
         Ok(settings)
     }
 
+    /// Retrieves the named profile sets from the config file.
+    /// Each set holds channel settings for any number of devices, in the device-settings format.
+    pub async fn get_profile_sets(&self) -> Result<Vec<ProfileSet>> {
+        let mut profile_sets = Vec::new();
+        if let Some(table_item) = self.document.read().await.get("profile-sets") {
+            let table = table_item.as_table().with_context(|| "profile-sets should be a table")?;
+            for (set_name, set_item) in table.iter() {
+                let set_table = set_item.as_table()
+                    .with_context(|| format!("Profile Set {} should be a table", set_name))?;
+                let mut settings = Vec::new();
+                for (device_uid, device_item) in set_table.iter() {
+                    let device_table = device_item.as_table()
+                        .with_context(|| format!("Profile Set {} device setting should be a table", set_name))?;
+                    for setting in Self::get_channel_settings(device_table)? {
+                        settings.push((device_uid.to_string(), setting));
+                    }
+                }
+                profile_sets.push(ProfileSet { name: set_name.to_string(), settings })
+            }
+        }
+        Ok(profile_sets)
+    }
+
+    pub async fn get_active_profile_set(&self) -> Result<Option<String>> {
+        if let Some(settings_item) = self.document.read().await.get("settings") {
+            let settings = settings_item.as_table().with_context(|| "Settings should be a table")?;
+            if let Some(active_item) = settings.get("active_profile_set") {
+                let active_name = active_item.as_str()
+                    .with_context(|| "active_profile_set should be a String")?;
+                return Ok(Some(active_name.to_string()));
+            }
+        }
+        Ok(None)
+    }
+
+    pub async fn set_active_profile_set(&self, set_name: &str) {
+        let mut doc = self.document.write().await;
+        let base_settings = doc["settings"].or_insert(Item::Table(Table::new()));
+        base_settings["active_profile_set"] = Item::Value(
+            Value::String(Formatted::new(set_name.to_string()))
+        );
+    }
+
+    pub async fn clear_active_profile_set(&self) {
+        if let Some(base_settings) = self.document.write().await["settings"].as_table_mut() {
+            base_settings.remove("active_profile_set");
+        }
+    }
+
     async fn get_all_devices_settings(&self) -> Result<HashMap<UID, Vec<Setting>>> {
         let mut devices_settings = HashMap::new();
         if let Some(device_table) = self.document.read().await["device-settings"].as_table() {
@@ -342,6 +503,66 @@ impl Config {
         Ok(temp_source)
     }
 
+    fn get_speed_feed_forward(setting_table: &InlineTable) -> Result<Option<FeedForward>> {
+        let feed_forward = if let Some(value) = setting_table.get("speed_feed_forward") {
+            let feed_forward_table = value.as_inline_table()
+                .with_context(|| "speed_feed_forward should be an inline table")?;
+            let device_uid = feed_forward_table.get("device_uid")
+                .with_context(|| "speed_feed_forward must have device_uid set")?
+                .as_str().with_context(|| "device_uid should be a String")?
+                .to_string();
+            let channel_name = feed_forward_table.get("channel_name")
+                .with_context(|| "speed_feed_forward must have channel_name set")?
+                .as_str().with_context(|| "channel_name should be a String")?
+                .to_string();
+            let threshold: u8 = feed_forward_table.get("threshold")
+                .with_context(|| "speed_feed_forward must have threshold set")?
+                .as_integer().with_context(|| "threshold should be an integer")?
+                .try_into().ok().filter(|threshold: &u8| *threshold <= 100)
+                .with_context(|| "threshold should be a value between 0-100")?;
+            let gain = feed_forward_table.get("gain")
+                .with_context(|| "speed_feed_forward must have gain set")?
+                .as_float().with_context(|| "gain should be a float")?;
+            let rate_gain = feed_forward_table.get("rate_gain")
+                .with_context(|| "speed_feed_forward must have rate_gain set")?
+                .as_float().with_context(|| "rate_gain should be a float")?;
+            let max_boost: u8 = feed_forward_table.get("max_boost")
+                .with_context(|| "speed_feed_forward must have max_boost set")?
+                .as_integer().with_context(|| "max_boost should be an integer")?
+                .try_into().ok().filter(|max_boost: &u8| *max_boost <= 100)
+                .with_context(|| "max_boost should be a value between 0-100")?;
+            Some(FeedForward {
+                device_uid,
+                channel_name,
+                threshold,
+                gain,
+                rate_gain,
+                max_boost,
+            })
+        } else { None };
+        Ok(feed_forward)
+    }
+
+    fn get_speed_pid(setting_table: &InlineTable) -> Result<Option<PidSettings>> {
+        let pid = if let Some(value) = setting_table.get("speed_pid") {
+            let pid_table = value.as_inline_table()
+                .with_context(|| "speed_pid should be an inline table")?;
+            let get_float = |key: &str| -> Result<f64> {
+                pid_table.get(key)
+                    .with_context(|| format!("speed_pid must have {} set", key))?
+                    .as_float().with_context(|| format!("speed_pid.{} should be a float", key))
+            };
+            Some(PidSettings {
+                target_temp: get_float("target_temp")?,
+                kp: get_float("kp")?,
+                ki: get_float("ki")?,
+                kd: get_float("kd")?,
+                derivative_filter: get_float("derivative_filter")?,
+            })
+        } else { None };
+        Ok(pid)
+    }
+
     fn get_lighting(setting_table: &InlineTable) -> Result<Option<LightingSettings>> {
         let lighting = if let Some(value) = setting_table.get("lighting") {
             let lighting_table = value.as_inline_table()
@@ -466,6 +687,116 @@ impl Config {
         Ok(pwm_mode)
     }
 
+    /// Retrieves the fan groups from the config file.
+    /// This has to be done defensively, as the user may change the config file.
+    pub async fn get_fan_groups(&self) -> Result<Vec<FanGroup>> {
+        let mut fan_groups = Vec::new();
+        if let Some(table_item) = self.document.read().await.get("fan-groups") {
+            let table = table_item.as_table().with_context(|| "fan-groups should be a table")?;
+            for (group_name, base_item) in table.iter() {
+                let group_table = base_item.as_inline_table()
+                    .with_context(|| "Fan Group should be an inline table")?;
+                let mut members = Vec::new();
+                let members_array = group_table.get("members")
+                    .with_context(|| "Fan Group members should be present")?
+                    .as_array().with_context(|| "Fan Group members should be an array")?;
+                for member_value in members_array {
+                    let member_array = member_value.as_array()
+                        .with_context(|| "Fan Group member should be an array of [device_uid, channel_name]")?;
+                    let device_uid = member_array.get(0)
+                        .with_context(|| "Fan Group member must have a device_uid")?
+                        .as_str().with_context(|| "device_uid should be a String")?
+                        .to_string();
+                    let channel_name = member_array.get(1)
+                        .with_context(|| "Fan Group member must have a channel_name")?
+                        .as_str().with_context(|| "channel_name should be a String")?
+                        .to_string();
+                    members.push(FanGroupMember { device_uid, channel_name })
+                }
+                let speed_profile = Self::get_speed_profile(group_table)?
+                    .with_context(|| "Fan Group speed_profile should be present")?;
+                let temp_source = Self::get_temp_source(group_table)?
+                    .with_context(|| "Fan Group temp_source should be present")?;
+                fan_groups.push(FanGroup {
+                    name: group_name.to_string(),
+                    members,
+                    speed_profile,
+                    temp_source,
+                })
+            }
+        }
+        Ok(fan_groups)
+    }
+
+    pub async fn set_fan_group(&self, fan_group: &FanGroup) {
+        let mut doc = self.document.write().await;
+        let fan_groups = doc["fan-groups"].or_insert(Item::Table(Table::new()));
+        let group_setting = &mut fan_groups[fan_group.name.as_str()];
+        *group_setting = Item::None;
+        let mut members_array = toml_edit::Array::new();
+        for member in fan_group.members.iter() {
+            let mut member_array = toml_edit::Array::new();
+            member_array.push(Value::String(Formatted::new(member.device_uid.clone())));
+            member_array.push(Value::String(Formatted::new(member.channel_name.clone())));
+            members_array.push(member_array);
+        }
+        group_setting["members"] = Item::Value(
+            Value::Array(members_array)
+        );
+        let mut profile_array = toml_edit::Array::new();
+        for (temp, duty) in fan_group.speed_profile.clone() {
+            let mut pair_array = toml_edit::Array::new();
+            pair_array.push(Value::Integer(Formatted::new(temp as i64)));
+            pair_array.push(Value::Integer(Formatted::new(duty as i64)));
+            profile_array.push(pair_array);
+        }
+        group_setting["speed_profile"] = Item::Value(
+            Value::Array(profile_array)
+        );
+        group_setting["temp_source"]["temp_name"] = Item::Value(
+            Value::String(Formatted::new(fan_group.temp_source.temp_name.clone()))
+        );
+        group_setting["temp_source"]["device_uid"] = Item::Value(
+            Value::String(Formatted::new(fan_group.temp_source.device_uid.clone()))
+        );
+    }
+
+    pub async fn remove_fan_group(&self, group_name: &str) {
+        if let Some(fan_groups) = self.document.write().await["fan-groups"].as_table_mut() {
+            fan_groups.remove(group_name);
+        }
+    }
+
+    /// Removes a channel from all fan groups, as the channel is now controlled by another setting.
+    /// Fan groups that are left without members are removed.
+    pub async fn remove_fan_group_member(&self, device_uid: &UID, channel_name: &str) -> Result<()> {
+        self.retain_fan_group_members(|_, member|
+            &member.device_uid != device_uid || member.channel_name != channel_name
+        ).await
+    }
+
+    /// A channel can only be in one fan group, so the members of this fan group are removed from
+    /// all other fan groups. Fan groups that are left without members are removed.
+    pub async fn remove_members_from_other_fan_groups(&self, fan_group: &FanGroup) -> Result<()> {
+        self.retain_fan_group_members(|group_name, member|
+            group_name == fan_group.name || !fan_group.members.contains(member)
+        ).await
+    }
+
+    async fn retain_fan_group_members(&self, keep: impl Fn(&str, &FanGroupMember) -> bool) -> Result<()> {
+        for mut fan_group in self.get_fan_groups().await? {
+            let member_count = fan_group.members.len();
+            let group_name = fan_group.name.clone();
+            fan_group.members.retain(|member| keep(&group_name, member));
+            if fan_group.members.is_empty() {
+                self.remove_fan_group(&fan_group.name).await;
+            } else if fan_group.members.len() != member_count {
+                self.set_fan_group(&fan_group).await;
+            }
+        }
+        Ok(())
+    }
+
     /// Returns CoolerControl general settings
     pub async fn get_settings(&self) -> Result<CoolerControlSettings> {
         if let Some(settings_item) = self.document.read().await.get("settings") {
@@ -476,6 +807,9 @@ impl Config {
             let no_init = settings.get("no_init")
                 .unwrap_or(&Item::Value(Value::Boolean(Formatted::new(false))))
                 .as_bool().with_context(|| "no_init should be a boolean value")?;
+            let hidraw_status = settings.get("hidraw_status")
+                .unwrap_or(&Item::Value(Value::Boolean(Formatted::new(false))))
+                .as_bool().with_context(|| "hidraw_status should be a boolean value")?;
             let handle_dynamic_temps = settings.get("handle_dynamic_temps")
                 .unwrap_or(&Item::Value(Value::Boolean(Formatted::new(true))))
                 .as_bool().with_context(|| "handle_dynamic_temps should be a boolean value")?;
@@ -494,6 +828,7 @@ impl Config {
             Ok(CoolerControlSettings {
                 apply_on_boot,
                 no_init,
+                hidraw_status,
                 handle_dynamic_temps,
                 startup_delay,
                 smoothing_level,
@@ -513,6 +848,9 @@ impl Config {
         base_settings["no_init"] = Item::Value(
             Value::Boolean(Formatted::new(cc_settings.no_init))
         );
+        base_settings["hidraw_status"] = Item::Value(
+            Value::Boolean(Formatted::new(cc_settings.hidraw_status))
+        );
         base_settings["handle_dynamic_temps"] = Item::Value(
             Value::Boolean(Formatted::new(cc_settings.handle_dynamic_temps))
         );
@@ -567,9 +905,34 @@ const DEFAULT_CONFIG_FILE: &str = r###"
 # pump = { speed_fixed = 30 }
 # logo = { lighting = { mode = "fixed", colors = [[0, 255, 255]] } }
 # ring = { lighting = { mode = "spectrum-wave", backward = true, colors = [] } }
+# fan1 = { speed_profile = [[30, 25], [60, 70]], temp_source = { temp_name = "CPU Temp", device_uid = "<cpu uid>" }, speed_feed_forward = { device_uid = "<cpu uid>", channel_name = "CPU Load", threshold = 30, gain = 0.5, rate_gain = 1.0, max_boost = 30 } }
+# pump = { speed_pid = { target_temp = 35.0, kp = 5.0, ki = 0.2, kd = 10.0, derivative_filter = 2.0 }, temp_source = { temp_name = "liquid", device_uid = "<this device uid>" } }
 [device-settings]
 
 
+# Fan Groups
+# -------------------------------
+# A fan group is a set of channels, also from different devices, that follow one speed profile
+# and temp source together. The profile is evaluated once and member channels are set together.
+# A channel that is a member of a group should not have its own speed setting.
+# Example:
+# [fan-groups]
+# front = { members = [["<device uid>", "fan1"], ["<device uid>", "fan2"]], speed_profile = [[30, 25], [60, 70]], temp_source = { temp_name = "liquid", device_uid = "<device uid>" } }
+[fan-groups]
+
+
+# Profile Sets
+# -------------------------------
+# Named sets of channel settings, in the same format as the device settings, that can be switched
+# between as a whole, for example from a script. Every set is prepared at startup, so switching only
+# writes the settings that differ from the current set. The active set is saved in the settings.
+# Example:
+# [profile-sets.quiet.4b9cd1bc5fb2921253e6b7dd5b1b011086ea529d915a86b3560c236084452807]
+# fan1 = { speed_profile = [[30, 20], [60, 50]], temp_source = { temp_name = "liquid", device_uid = "<device uid>" } }
+# pump = { speed_fixed = 60 }
+[profile-sets]
+
+
 # Cooler Control Settings
 # -------------------------------
 # This is where CoolerControl specifc settings are set.
@@ -579,6 +942,9 @@ const DEFAULT_CONFIG_FILE: &str = r###"
 apply_on_boot = true
 # Will skip initialization calls for liquidctl devices. ONLY USE if you are doing initialiation manually.
 no_init = false
+# Reads the status reports that NZXT Kraken X3 and Smart Device V2 devices push on their own directly,
+# instead of polling them through liqctld. Requires a restart.
+hidraw_status = false
 # Handle dynamic temp sources like cpu and gpu with a moving average rather than immediately up and down.
 handle_dynamic_temps = true
 # Startup Delay (seconds) is an integer value between 0 and 10
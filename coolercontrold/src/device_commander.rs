@@ -20,12 +20,16 @@ use std::collections::HashMap;
 use std::sync::Arc;
 
 use anyhow::{anyhow, Context, Result};
+use log::error;
+use zbus::export::futures_util::future::join_all;
 
 use crate::{AllDevices, Repos};
 use crate::config::Config;
-use crate::device::DeviceType;
+use crate::device::{DeviceType, UID};
+use crate::lcd_scheduler::{LcdScheduler, SENSORS_MODE};
+use crate::lighting_scheduler::{is_effect_mode, LightingScheduler};
 use crate::repositories::repository::Repository;
-use crate::setting::Setting;
+use crate::setting::{FanGroup, ProfileSet, Setting};
 use crate::speed_scheduler::SpeedScheduler;
 
 pub type ReposByType = HashMap<DeviceType, Arc<dyn Repository>>;
@@ -34,6 +38,8 @@ pub struct DeviceCommander {
     all_devices: AllDevices,
     repos: ReposByType,
     pub speed_scheduler: Arc<SpeedScheduler>,
+    pub lcd_scheduler: Arc<LcdScheduler>,
+    pub lighting_scheduler: Arc<LightingScheduler>,
 }
 
 impl DeviceCommander {
@@ -48,20 +54,33 @@ impl DeviceCommander {
                 DeviceType::Composite => repos_by_type.insert(DeviceType::Composite, Arc::clone(repo)),
             };
         }
+        let lcd_scheduler = Arc::new(LcdScheduler::new(
+            all_devices.clone(),
+            repos_by_type.clone(),
+        ));
+        let lighting_scheduler = Arc::new(LightingScheduler::new(
+            all_devices.clone(),
+            repos_by_type.clone(),
+        ));
         let speed_scheduler = Arc::new(SpeedScheduler::new(
             all_devices.clone(),
             repos_by_type.clone(),
+            Arc::clone(&lcd_scheduler),
+            Arc::clone(&lighting_scheduler),
             config,
         ));
-        DeviceCommander { all_devices, repos: repos_by_type, speed_scheduler }
+        DeviceCommander { all_devices, repos: repos_by_type, speed_scheduler, lcd_scheduler, lighting_scheduler }
     }
 
     pub async fn set_setting(&self, device_uid: &String, setting: &Setting) -> Result<()> {
+        self.speed_scheduler.clear_active_profile_set().await;
         if let Some(device_lock) = self.all_devices.get(device_uid) {
             let device_type = device_lock.read().await.d_type.clone();
             return if let Some(repo) = self.repos.get(&device_type) {
                 if let Some(true) = setting.reset_to_default {
                     self.speed_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
+                    self.lcd_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
+                    self.lighting_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
                     if device_type == DeviceType::Hwmon || device_type == DeviceType::GPU {
                         repo.apply_setting(device_uid, setting).await
                     } else {
@@ -71,13 +90,34 @@ impl DeviceCommander {
                     self.speed_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
                     repo.apply_setting(device_uid, setting).await
                 } else if setting.lighting.is_some() {
-                    repo.apply_setting(device_uid, setting).await
+                    if is_effect_mode(&setting.lighting.as_ref().unwrap().mode) {
+                        self.lighting_scheduler.schedule_setting(device_uid, setting).await
+                    } else {
+                        self.lighting_scheduler.clear_for_device_mode(device_uid, &setting.channel_name).await;
+                        repo.apply_setting(device_uid, setting).await
+                    }
+                } else if setting.speed_pid.is_some() {
+                    let speed_options = device_lock.read().await
+                        .info.as_ref().with_context(|| "Looking for Device Info")?
+                        .channels.get(&setting.channel_name).with_context(|| "Looking for Channel Info")?
+                        .speed_options.clone().with_context(|| "Looking for Channel Speed Options")?;
+                    if let None = setting.temp_source {
+                        Err(anyhow!("A Temp Source must be set when scheduling a Target Temperature for this device: {}", device_uid))
+                    } else if (
+                        &setting.temp_source.as_ref().unwrap().device_uid == device_uid
+                            && speed_options.manual_profiles_enabled)
+                        || &setting.temp_source.as_ref().unwrap().device_uid != device_uid {
+                        self.speed_scheduler.schedule_setting(device_uid, setting).await
+                    } else {
+                        Err(anyhow!("Target Temperatures not enabled for this device: {}", device_uid))
+                    }
                 } else if setting.speed_profile.is_some() {
                     let speed_options = device_lock.read().await
                         .info.as_ref().with_context(|| "Looking for Device Info")?
                         .channels.get(&setting.channel_name).with_context(|| "Looking for Channel Info")?
                         .speed_options.clone().with_context(|| "Looking for Channel Speed Options")?;
                     if speed_options.profiles_enabled {
+                        self.speed_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
                         repo.apply_setting(device_uid, setting).await
                     } else if let None = setting.temp_source {
                         Err(anyhow!("A Temp Source must be set when scheduling a Speed Profile for this device: {}", device_uid))
@@ -85,7 +125,13 @@ impl DeviceCommander {
                         &setting.temp_source.as_ref().unwrap().device_uid == device_uid
                             && speed_options.manual_profiles_enabled)
                         || &setting.temp_source.as_ref().unwrap().device_uid != device_uid {
-                        self.speed_scheduler.schedule_setting(device_uid, setting).await
+                        // cleared first, so that the scheduler doesn't write over an offloaded profile
+                        self.speed_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
+                        if repo.offload_speed_profile(device_uid, setting).await? {
+                            Ok(())
+                        } else {
+                            self.speed_scheduler.schedule_setting(device_uid, setting).await
+                        }
                     } else {
                         Err(anyhow!("Speed Profiles not enabled for this device: {}", device_uid))
                     }
@@ -94,7 +140,10 @@ impl DeviceCommander {
                         .info.as_ref().with_context(|| "Looking for Device Info")?
                         .channels.get(&setting.channel_name).with_context(|| "Looking for Channel Info")?
                         .lcd_modes.is_empty();
-                    if has_lcd_modes {
+                    if has_lcd_modes && setting.lcd.as_ref().unwrap().mode == SENSORS_MODE {
+                        self.lcd_scheduler.schedule_setting(device_uid, setting).await
+                    } else if has_lcd_modes {
+                        self.lcd_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
                         repo.apply_setting(device_uid, setting).await
                     } else {
                         Err(anyhow!("LCD Screen modes not enabled for this device: {}", device_uid))
@@ -111,10 +160,115 @@ impl DeviceCommander {
         }
     }
 
-    /// This is used to reinitialize liquidctl devices after waking from sleep
+    /// Checks whether a setting could be applied, without applying it.
+    /// This lets a batch of settings be rejected as a whole before any device is touched.
+    pub async fn validate_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()> {
+        let device_lock = self.all_devices.get(device_uid)
+            .with_context(|| format!("Device Not Found: {}", device_uid))?;
+        let device = device_lock.read().await;
+        if !self.repos.contains_key(&device.d_type) {
+            return Err(anyhow!("Repository: {:?} for device is currently not running!", device.d_type));
+        }
+        if setting.reset_to_default.unwrap_or(false) || setting.lighting.is_some() {
+            return Ok(());
+        }
+        if setting.speed_fixed.is_none() && setting.speed_pid.is_none()
+            && setting.speed_profile.is_none() && setting.lcd.is_none() {
+            return Err(anyhow!("Invalid Setting combination: {:?}", setting));
+        }
+        let channel_info = device.info.as_ref().with_context(|| "Looking for Device Info")?
+            .channels.get(&setting.channel_name).with_context(|| "Looking for Channel Info")?;
+        if setting.lcd.is_some() && setting.speed_fixed.is_none()
+            && setting.speed_pid.is_none() && setting.speed_profile.is_none() {
+            return if channel_info.lcd_modes.is_empty() {
+                Err(anyhow!("LCD Screen modes not enabled for this device: {}", device_uid))
+            } else {
+                Ok(())
+            };
+        }
+        let speed_options = channel_info.speed_options.as_ref()
+            .with_context(|| "Looking for Channel Speed Options")?;
+        if setting.speed_fixed.is_some() {
+            return Ok(());
+        }
+        if setting.speed_pid.is_none() && speed_options.profiles_enabled {
+            return Ok(());
+        }
+        let temp_source = setting.temp_source.as_ref()
+            .with_context(|| format!("A Temp Source must be set when scheduling this setting for this device: {}", device_uid))?;
+        if !self.all_devices.contains_key(&temp_source.device_uid) {
+            return Err(anyhow!("temp_source Device is currently not present: {}", temp_source.device_uid));
+        }
+        if &temp_source.device_uid == device_uid && !speed_options.manual_profiles_enabled {
+            return Err(anyhow!("Speed Profiles not enabled for this device: {}", device_uid));
+        }
+        Ok(())
+    }
+
+    /// Applies many settings, returning a result per setting in the same order.
+    /// Settings for different devices are applied concurrently,
+    /// while settings for the same device are applied one after another in the given order.
+    pub async fn set_settings_batch(&self, settings: &[(UID, Setting)]) -> Vec<Result<()>> {
+        let mut positions_per_device: HashMap<&UID, Vec<usize>> = HashMap::new();
+        for (position, (device_uid, _)) in settings.iter().enumerate() {
+            positions_per_device.entry(device_uid).or_default().push(position);
+        }
+        let device_futures = positions_per_device.into_iter()
+            .map(|(device_uid, positions)| async move {
+                let mut device_results = Vec::with_capacity(positions.len());
+                for position in positions {
+                    let result = self.set_setting(device_uid, &settings[position].1).await;
+                    device_results.push((position, result));
+                }
+                device_results
+            });
+        let mut results: Vec<Option<Result<()>>> = settings.iter().map(|_| None).collect();
+        for (position, result) in join_all(device_futures).await.into_iter().flatten() {
+            results[position] = Some(result);
+        }
+        results.into_iter()
+            .map(|result| result.unwrap_or_else(|| Err(anyhow!("Setting was not applied"))))
+            .collect()
+    }
+
+    /// Fan groups are always handled by the speed scheduler, as the members can be spread
+    /// across devices and repositories.
+    pub async fn set_fan_group(&self, fan_group: &FanGroup) -> Result<()> {
+        self.speed_scheduler.clear_active_profile_set().await;
+        self.speed_scheduler.schedule_fan_group(fan_group).await
+    }
+
+    /// Validates and prepares the profile sets for switching.
+    /// Invalid sets are logged and skipped, so that the other sets can still be used.
+    pub async fn load_profile_sets(&self, profile_sets: &[ProfileSet]) {
+        'profile_sets: for profile_set in profile_sets {
+            for (device_uid, setting) in profile_set.settings.iter() {
+                if let Err(err) = self.validate_setting(device_uid, setting).await {
+                    error!("Profile Set: {} contains an invalid setting: {}", profile_set.name, err);
+                    continue 'profile_sets;
+                }
+            }
+            if let Err(err) = self.speed_scheduler.compile_profile_set(profile_set).await {
+                error!("Error preparing Profile Set: {}: {}", profile_set.name, err);
+            }
+        }
+    }
+
+    pub async fn activate_profile_set(&self, set_name: &str) -> Result<()> {
+        self.speed_scheduler.activate_profile_set(set_name).await
+    }
+
+    pub async fn clear_fan_group(&self, group_name: &str) {
+        self.speed_scheduler.clear_fan_group(group_name).await
+    }
+
+    /// This is used to reinitialize liquidctl devices and GPU fan control after waking from sleep
     pub async fn reinitialize_devices(&self) {
         if let Some(liquidctl_repo) = self.repos.get(&DeviceType::Liquidctl) {
             liquidctl_repo.reinitialize_devices().await;
         }
+        if let Some(gpu_repo) = self.repos.get(&DeviceType::GPU) {
+            gpu_repo.reinitialize_devices().await;
+        }
     }
 }
\ No newline at end of file
@@ -20,7 +20,7 @@ use std::ops::Deref;
 use std::sync::Arc;
 use std::time::Duration;
 
-use actix_web::{App, get, HttpResponse, HttpServer, middleware, patch, post, Responder};
+use actix_web::{App, delete, get, HttpResponse, HttpServer, middleware, patch, post, put, Responder};
 use actix_web::dev::Server;
 use actix_web::web::{Data, Json, Path};
 use anyhow::Result;
@@ -39,7 +39,7 @@ use crate::config::Config;
 use crate::device::{DeviceInfo, DeviceType, LcInfo, Status, UID};
 use crate::device_commander::DeviceCommander;
 use crate::repositories::repository::DeviceLock;
-use crate::setting::{CoolerControlSettings, Setting};
+use crate::setting::{CoolerControlSettings, FanGroup, Setting};
 
 const GUI_SERVER_PORT: u16 = 11987;
 const GUI_SERVER_ADDR: &str = "127.0.0.1";
@@ -216,7 +216,8 @@ fn get_most_recent_status(device: RwLockReadGuard<Device>, smoothing_level: u8)
 }
 
 fn smooth_all_temps_and_loads(device_dto: &mut DeviceStatusDto, smoothing_level: u8) {
-    // cpu and gpu currently only ever have single temps & load, simplifying this impl
+    // cpu and gpu currently only ever have a single main temp & load, simplifying this impl.
+    // Only the first temp is smoothed, which for AMD gpu_metrics is the edge temp.
     // they also should never have a missing temp/load issue due to hwmon
     if (device_dto.d_type != DeviceType::CPU && device_dto.d_type != DeviceType::GPU)
         || smoothing_level == 0 {
@@ -297,6 +298,193 @@ async fn apply_device_settings(
     }
 }
 
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct DeviceSettingRequest {
+    device_uid: UID,
+    setting: Setting,
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct BatchSettingsRequest {
+    settings: Vec<DeviceSettingRequest>,
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct DeviceSettingResult {
+    device_uid: UID,
+    channel_name: String,
+    success: bool,
+    error: Option<String>,
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct BatchSettingsResponse {
+    results: Vec<DeviceSettingResult>,
+}
+
+impl BatchSettingsResponse {
+    fn from_results(settings: &[(UID, Setting)], results: &[Result<()>]) -> Self {
+        let results = settings.iter().zip(results.iter())
+            .map(|((device_uid, setting), result)| DeviceSettingResult {
+                device_uid: device_uid.clone(),
+                channel_name: setting.channel_name.clone(),
+                success: result.is_ok(),
+                error: result.as_ref().err().map(|err| err.to_string()),
+            })
+            .collect();
+        Self { results }
+    }
+}
+
+/// Apply many device settings at once.
+/// All settings are validated first and none are applied if any is invalid.
+/// Settings are then applied concurrently per device and the config file is saved once.
+#[patch("/devices/settings")]
+async fn apply_device_settings_batch(
+    batch_request: Json<BatchSettingsRequest>,
+    device_commander: Data<Arc<DeviceCommander>>,
+    config: Data<Arc<Config>>,
+) -> impl Responder {
+    let settings: Vec<(UID, Setting)> = batch_request.into_inner().settings.into_iter()
+        .map(|request| (request.device_uid, request.setting))
+        .collect();
+    let mut validation_results = Vec::with_capacity(settings.len());
+    for (device_uid, setting) in settings.iter() {
+        validation_results.push(device_commander.validate_setting(device_uid, setting).await);
+    }
+    if validation_results.iter().any(|result| result.is_err()) {
+        return HttpResponse::BadRequest()
+            .json(Json(BatchSettingsResponse::from_results(&settings, &validation_results)));
+    }
+    let results = device_commander.set_settings_batch(&settings).await;
+    let mut any_applied = false;
+    for ((device_uid, setting), result) in settings.iter().zip(results.iter()) {
+        match result {
+            Ok(_) => {
+                config.set_device_setting(device_uid, setting).await;
+                any_applied = true;
+            }
+            Err(err) => error!("{:?}", err),
+        }
+    }
+    if any_applied {
+        if let Err(err) = config.save_config_file().await {
+            error!("{:?}", err);
+            return HttpResponse::InternalServerError()
+                .json(Json(ErrorResponse { error: err.to_string() }));
+        }
+    }
+    HttpResponse::Ok().json(Json(BatchSettingsResponse::from_results(&settings, &results)))
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct FanGroupsResponse {
+    fan_groups: Vec<FanGroup>,
+}
+
+/// Returns the saved fan groups
+#[get("/fan-groups")]
+async fn get_fan_groups(
+    config: Data<Arc<Config>>,
+) -> impl Responder {
+    match config.get_fan_groups().await {
+        Ok(fan_groups) => HttpResponse::Ok()
+            .json(Json(FanGroupsResponse { fan_groups })),
+        Err(err) => {
+            error!("{:?}", err);
+            HttpResponse::InternalServerError()
+                .json(Json(ErrorResponse { error: err.to_string() }))
+        }
+    }
+}
+
+/// Creates or replaces the fan group sent in the request body
+#[put("/fan-groups")]
+async fn apply_fan_group(
+    fan_group_request: Json<FanGroup>,
+    device_commander: Data<Arc<DeviceCommander>>,
+    config: Data<Arc<Config>>,
+) -> impl Responder {
+    let result = match device_commander.set_fan_group(fan_group_request.deref()).await {
+        Ok(_) => {
+            config.set_fan_group(fan_group_request.deref()).await;
+            if let Err(err) = config.remove_members_from_other_fan_groups(fan_group_request.deref()).await {
+                error!("Error removing fan group members from other fan groups in the config: {}", err);
+            }
+            config.save_config_file().await
+        }
+        Err(err) => Err(err)
+    };
+    match result {
+        Ok(_) => HttpResponse::Ok().json(json!({"success": true})),
+        Err(err) => {
+            error!("{:?}", err);
+            HttpResponse::InternalServerError()
+                .json(Json(ErrorResponse { error: err.to_string() }))
+        }
+    }
+}
+
+/// Removes the fan group. Member channels keep their last applied duty until a new setting is applied.
+#[delete("/fan-groups/{group_name}")]
+async fn remove_fan_group(
+    group_name: Path<String>,
+    device_commander: Data<Arc<DeviceCommander>>,
+    config: Data<Arc<Config>>,
+) -> impl Responder {
+    device_commander.clear_fan_group(group_name.as_str()).await;
+    config.remove_fan_group(group_name.as_str()).await;
+    match config.save_config_file().await {
+        Ok(_) => HttpResponse::Ok().json(json!({"success": true})),
+        Err(err) => {
+            error!("{:?}", err);
+            HttpResponse::InternalServerError()
+                .json(Json(ErrorResponse { error: err.to_string() }))
+        }
+    }
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct ProfileSetsResponse {
+    profile_sets: Vec<String>,
+    active: Option<String>,
+}
+
+/// Returns the names of the available profile sets and the active one
+#[get("/profile-sets")]
+async fn get_profile_sets(
+    device_commander: Data<Arc<DeviceCommander>>,
+) -> impl Responder {
+    HttpResponse::Ok().json(Json(ProfileSetsResponse {
+        profile_sets: device_commander.speed_scheduler.profile_set_names().await,
+        active: device_commander.speed_scheduler.active_profile_set_name().await,
+    }))
+}
+
+/// Switches to the given profile set and saves it as the active one
+#[post("/profile-sets/{set_name}/activate")]
+async fn activate_profile_set(
+    set_name: Path<String>,
+    device_commander: Data<Arc<DeviceCommander>>,
+    config: Data<Arc<Config>>,
+) -> impl Responder {
+    let result = match device_commander.activate_profile_set(set_name.as_str()).await {
+        Ok(_) => {
+            config.set_active_profile_set(set_name.as_str()).await;
+            config.save_config_file().await
+        }
+        Err(err) => Err(err)
+    };
+    match result {
+        Ok(_) => HttpResponse::Ok().json(json!({"success": true})),
+        Err(err) => {
+            error!("{:?}", err);
+            HttpResponse::InternalServerError()
+                .json(Json(ErrorResponse { error: err.to_string() }))
+        }
+    }
+}
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 struct AseTek690Request {
     is_legacy690: bool,
@@ -364,6 +552,7 @@ impl CoolerControlSettingsDto {
         CoolerControlSettings {
             apply_on_boot,
             no_init: current_settings.no_init,
+            hidraw_status: current_settings.hidraw_status,
             handle_dynamic_temps,
             startup_delay,
             smoothing_level,
@@ -438,6 +627,12 @@ pub async fn init_server(all_devices: AllDevices, device_commander: Arc<DeviceCo
             .service(status)
             .service(get_device_settings)
             .service(apply_device_settings)
+            .service(apply_device_settings_batch)
+            .service(get_fan_groups)
+            .service(apply_fan_group)
+            .service(remove_fan_group)
+            .service(get_profile_sets)
+            .service(activate_profile_set)
             .service(get_cc_settings)
             .service(apply_cc_settings)
             .service(asetek)
@@ -0,0 +1,341 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::collections::HashMap;
+use std::f64::consts::PI;
+
+type Rgb = (u8, u8, u8);
+
+const BMP_HEADER_SIZE: usize = 54;
+const GLYPH_WIDTH: usize = 5;
+const GLYPH_HEIGHT: usize = 7;
+const VALUE_SCALE: usize = 10;
+const UNIT_SCALE: usize = 4;
+const RING_WIDTH: f64 = 18.;
+const RING_MARGIN: f64 = 4.;
+/// The blend factor of the text color into the background color for the unfilled part of the gauge ring
+const RING_TRACK_BLEND: f64 = 0.25;
+
+/// A 5x7 bitmap font for the characters that are needed for sensor values.
+/// Each row is a bit mask where bit 4 is the leftmost column.
+fn glyph_rows(character: char) -> Option<[u8; GLYPH_HEIGHT]> {
+    let rows = match character {
+        '0' => [0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E],
+        '1' => [0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E],
+        '2' => [0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F],
+        '3' => [0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E],
+        '4' => [0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02],
+        '5' => [0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E],
+        '6' => [0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E],
+        '7' => [0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08],
+        '8' => [0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E],
+        '9' => [0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C],
+        '-' => [0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00],
+        'C' => [0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E],
+        '°' => [0x0C, 0x12, 0x12, 0x0C, 0x00, 0x00, 0x00],
+        _ => return None,
+    };
+    Some(rows)
+}
+
+/// The values that are shown on a frame. Frames are only rendered when these change.
+#[derive(Debug, Clone, PartialEq)]
+pub struct FrameContent {
+    /// The temperature rounded to whole degrees, or None when the sensor is unavailable
+    pub temp: Option<i32>,
+    /// The temperature at which the gauge ring is full
+    pub temp_max: u8,
+    pub text_color: Rgb,
+    pub background_color: Rgb,
+}
+
+/// A pre-scaled glyph mask
+struct Glyph {
+    width: usize,
+    height: usize,
+    mask: Vec<bool>,
+}
+
+/// The background with the empty gauge ring, which only changes with the colors
+struct BackgroundLayer {
+    colors: (Rgb, Rgb),
+    pixels: Vec<u8>,
+}
+
+/// Renders sensor values onto square LCD frames, as uncompressed 24-bit BMP images.
+/// - The background layer, the gauge ring geometry and the scaled glyphs are cached, so that a
+///   frame only costs copying the background and drawing the gauge and text on top.
+/// - A frame is only rendered when its content has changed since the last rendered frame.
+pub struct LcdRenderer {
+    size: usize,
+    /// pixel index and clockwise angle from the top (0..1) for every pixel of the gauge ring
+    ring_pixels: Vec<(usize, f64)>,
+    background: Option<BackgroundLayer>,
+    glyphs: HashMap<(char, usize), Glyph>,
+    last_content: Option<FrameContent>,
+}
+
+impl LcdRenderer {
+    pub fn new(size: usize) -> Self {
+        let center = (size as f64 - 1.) / 2.;
+        let outer_radius = size as f64 / 2. - RING_MARGIN;
+        let inner_radius = outer_radius - RING_WIDTH;
+        let mut ring_pixels = Vec::new();
+        for y in 0..size {
+            for x in 0..size {
+                let dx = x as f64 - center;
+                let dy = y as f64 - center;
+                let distance = (dx * dx + dy * dy).sqrt();
+                if distance >= inner_radius && distance <= outer_radius {
+                    let angle = dx.atan2(-dy).rem_euclid(2. * PI) / (2. * PI);
+                    ring_pixels.push((y * size + x, angle));
+                }
+            }
+        }
+        Self {
+            size,
+            ring_pixels,
+            background: None,
+            glyphs: HashMap::new(),
+            last_content: None,
+        }
+    }
+
+    /// Returns the BMP image of the frame, or None if the content is the same as the last rendered frame.
+    pub fn render(&mut self, content: &FrameContent) -> Option<Vec<u8>> {
+        if self.last_content.as_ref() == Some(content) {
+            return None;
+        }
+        let mut pixels = self.background_pixels(content.text_color, content.background_color).to_vec();
+        if let Some(temp) = content.temp {
+            let fill = (temp as f64 / content.temp_max.max(1) as f64).clamp(0., 1.);
+            for (pixel_index, angle) in self.ring_pixels.iter() {
+                if *angle < fill {
+                    Self::set_pixel(&mut pixels, *pixel_index, content.text_color);
+                }
+            }
+        }
+        let value_text = content.temp.map_or("--".to_string(), |temp| temp.to_string());
+        let value_height = GLYPH_HEIGHT * VALUE_SCALE;
+        let unit_height = GLYPH_HEIGHT * UNIT_SCALE;
+        let value_top = (self.size - value_height) / 2;
+        self.draw_text(&mut pixels, &value_text, VALUE_SCALE, value_top, content.text_color);
+        self.draw_text(&mut pixels, "°C", UNIT_SCALE, value_top + value_height + unit_height / 2, content.text_color);
+        self.last_content = Some(content.clone());
+        Some(self.encode_bmp(&pixels))
+    }
+
+    /// Forces the next frame to be rendered, for example after the screen has been set to another mode.
+    pub fn invalidate(&mut self) {
+        self.last_content = None;
+    }
+
+    fn background_pixels(&mut self, text_color: Rgb, background_color: Rgb) -> &[u8] {
+        let colors = (text_color, background_color);
+        if self.background.as_ref().map_or(true, |layer| layer.colors != colors) {
+            let mut pixels = Vec::with_capacity(self.size * self.size * 3);
+            for _ in 0..self.size * self.size {
+                pixels.extend_from_slice(&[background_color.0, background_color.1, background_color.2]);
+            }
+            let track_color = Self::blend(text_color, background_color, RING_TRACK_BLEND);
+            for (pixel_index, _) in self.ring_pixels.iter() {
+                Self::set_pixel(&mut pixels, *pixel_index, track_color);
+            }
+            self.background = Some(BackgroundLayer { colors, pixels });
+        }
+        &self.background.as_ref().unwrap().pixels
+    }
+
+    /// Draws the text horizontally centered, skipping unsupported characters.
+    fn draw_text(&mut self, pixels: &mut [u8], text: &str, scale: usize, top: usize, color: Rgb) {
+        let characters: Vec<char> = text.chars()
+            .filter(|character| glyph_rows(*character).is_some())
+            .collect();
+        if characters.is_empty() {
+            return;
+        }
+        let spacing = scale;
+        let text_width = characters.len() * (GLYPH_WIDTH * scale + spacing) - spacing;
+        let mut left = self.size.saturating_sub(text_width) / 2;
+        for character in characters {
+            let glyph = self.glyphs.entry((character, scale))
+                .or_insert_with(|| Self::scale_glyph(character, scale));
+            for y in 0..glyph.height {
+                for x in 0..glyph.width {
+                    let (pixel_x, pixel_y) = (left + x, top + y);
+                    if glyph.mask[y * glyph.width + x] && pixel_x < self.size && pixel_y < self.size {
+                        Self::set_pixel(pixels, pixel_y * self.size + pixel_x, color);
+                    }
+                }
+            }
+            left += glyph.width + spacing;
+        }
+    }
+
+    fn scale_glyph(character: char, scale: usize) -> Glyph {
+        let rows = glyph_rows(character).unwrap_or_default();
+        let width = GLYPH_WIDTH * scale;
+        let height = GLYPH_HEIGHT * scale;
+        let mut mask = vec![false; width * height];
+        for y in 0..height {
+            for x in 0..width {
+                mask[y * width + x] = rows[y / scale] & (0x10 >> (x / scale)) != 0;
+            }
+        }
+        Glyph { width, height, mask }
+    }
+
+    fn set_pixel(pixels: &mut [u8], pixel_index: usize, color: Rgb) {
+        let offset = pixel_index * 3;
+        pixels[offset] = color.0;
+        pixels[offset + 1] = color.1;
+        pixels[offset + 2] = color.2;
+    }
+
+    fn blend(foreground: Rgb, background: Rgb, factor: f64) -> Rgb {
+        let mix = |fg: u8, bg: u8| (fg as f64 * factor + bg as f64 * (1. - factor)).round() as u8;
+        (mix(foreground.0, background.0), mix(foreground.1, background.1), mix(foreground.2, background.2))
+    }
+
+    /// Encodes the RGB pixels as a bottom-up 24-bit BMP, which needs no compression and is read
+    /// by liquidctl like any other static image.
+    fn encode_bmp(&self, pixels: &[u8]) -> Vec<u8> {
+        let row_size = (self.size * 3 + 3) & !3;
+        let image_size = row_size * self.size;
+        let file_size = BMP_HEADER_SIZE + image_size;
+        let mut bmp = Vec::with_capacity(file_size);
+        bmp.extend_from_slice(b"BM");
+        bmp.extend_from_slice(&(file_size as u32).to_le_bytes());
+        bmp.extend_from_slice(&0u32.to_le_bytes()); // reserved
+        bmp.extend_from_slice(&(BMP_HEADER_SIZE as u32).to_le_bytes()); // pixel data offset
+        bmp.extend_from_slice(&40u32.to_le_bytes()); // info header size
+        bmp.extend_from_slice(&(self.size as i32).to_le_bytes()); // width
+        bmp.extend_from_slice(&(self.size as i32).to_le_bytes()); // height, positive = bottom-up
+        bmp.extend_from_slice(&1u16.to_le_bytes()); // planes
+        bmp.extend_from_slice(&24u16.to_le_bytes()); // bits per pixel
+        bmp.extend_from_slice(&0u32.to_le_bytes()); // no compression
+        bmp.extend_from_slice(&(image_size as u32).to_le_bytes());
+        bmp.extend_from_slice(&2835i32.to_le_bytes()); // 72 DPI
+        bmp.extend_from_slice(&2835i32.to_le_bytes());
+        bmp.extend_from_slice(&0u32.to_le_bytes()); // colors in palette
+        bmp.extend_from_slice(&0u32.to_le_bytes()); // important colors
+        let padding = row_size - self.size * 3;
+        for y in (0..self.size).rev() {
+            for x in 0..self.size {
+                let offset = (y * self.size + x) * 3;
+                bmp.extend_from_slice(&[pixels[offset + 2], pixels[offset + 1], pixels[offset]]);
+            }
+            bmp.extend(std::iter::repeat(0u8).take(padding));
+        }
+        bmp
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const SIZE: usize = 320;
+    const WHITE: Rgb = (255, 255, 255);
+    const BLACK: Rgb = (0, 0, 0);
+
+    fn content(temp: Option<i32>) -> FrameContent {
+        FrameContent {
+            temp,
+            temp_max: 100,
+            text_color: WHITE,
+            background_color: BLACK,
+        }
+    }
+
+    /// returns the RGB color of the pixel at x, y from a bottom-up BMP
+    fn bmp_pixel(bmp: &[u8], x: usize, y: usize) -> Rgb {
+        let row_size = (SIZE * 3 + 3) & !3;
+        let offset = BMP_HEADER_SIZE + (SIZE - 1 - y) * row_size + x * 3;
+        (bmp[offset + 2], bmp[offset + 1], bmp[offset])
+    }
+
+    #[test]
+    fn render_bmp_header() {
+        // given:
+        let mut renderer = LcdRenderer::new(SIZE);
+
+        // when:
+        let bmp = renderer.render(&content(Some(42))).unwrap();
+
+        // then:
+        assert_eq!(&bmp[0..2], b"BM");
+        assert_eq!(bmp.len(), BMP_HEADER_SIZE + SIZE * SIZE * 3);
+        assert_eq!(u32::from_le_bytes(bmp[2..6].try_into().unwrap()) as usize, bmp.len());
+        assert_eq!(i32::from_le_bytes(bmp[18..22].try_into().unwrap()), SIZE as i32);
+        assert_eq!(u16::from_le_bytes(bmp[28..30].try_into().unwrap()), 24);
+    }
+
+    #[test]
+    fn skip_unchanged_frames() {
+        // given:
+        let mut renderer = LcdRenderer::new(SIZE);
+
+        // when:
+        let first = renderer.render(&content(Some(42)));
+        let same = renderer.render(&content(Some(42)));
+        let changed = renderer.render(&content(Some(43)));
+        renderer.invalidate();
+        let invalidated = renderer.render(&content(Some(43)));
+
+        // then:
+        assert!(first.is_some());
+        assert!(same.is_none());
+        assert!(changed.is_some());
+        assert!(invalidated.is_some());
+    }
+
+    #[test]
+    fn gauge_ring_fill() {
+        // given:
+        let mut renderer = LcdRenderer::new(SIZE);
+        let ring_y = (RING_MARGIN + RING_WIDTH / 2.) as usize;
+        let track_color = LcdRenderer::blend(WHITE, BLACK, RING_TRACK_BLEND);
+
+        // when:
+        let half_full = renderer.render(&content(Some(50))).unwrap();
+        let unknown = renderer.render(&content(None)).unwrap();
+
+        // then:
+        // just right of the top is filled, and just left of the top (the end of the ring) is not
+        assert_eq!(bmp_pixel(&half_full, SIZE / 2 + 2, ring_y), WHITE);
+        assert_eq!(bmp_pixel(&half_full, SIZE / 2 - 3, ring_y), track_color);
+        assert_eq!(bmp_pixel(&unknown, SIZE / 2 + 2, ring_y), track_color);
+        // the corners are outside the ring
+        assert_eq!(bmp_pixel(&half_full, 0, 0), BLACK);
+    }
+
+    #[test]
+    fn glyphs_are_cached() {
+        // given:
+        let mut renderer = LcdRenderer::new(SIZE);
+
+        // when:
+        renderer.render(&content(Some(11)));
+        renderer.render(&content(Some(1)));
+
+        // then:
+        // '1' at value scale, and '°' and 'C' at unit scale
+        assert_eq!(renderer.glyphs.len(), 3);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,455 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::collections::HashMap;
+use std::fs::{DirBuilder, OpenOptions};
+use std::io::Write;
+use std::os::unix::fs::{DirBuilderExt, MetadataExt, OpenOptionsExt, PermissionsExt};
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant};
+
+use anyhow::{anyhow, Context, Result};
+use log::{debug, error, info};
+use nix::fcntl::OFlag;
+use nix::unistd::geteuid;
+use tokio::sync::RwLock;
+
+use crate::AllDevices;
+use crate::device::{DeviceType, UID};
+use crate::device_commander::ReposByType;
+use crate::lcd_renderer::{FrameContent, LcdRenderer};
+use crate::setting::{LcdSettings, Setting};
+
+/// The LCD mode name for frames rendered by the daemon
+pub const SENSORS_MODE: &str = "sensors";
+/// Every frame upload sends a whole image over USB, so frames are pushed at most this often.
+const FRAME_INTERVAL: Duration = Duration::from_secs(2);
+const LCD_SIZE: usize = 320;
+const DEFAULT_TEXT_COLOR: (u8, u8, u8) = (255, 255, 255);
+const DEFAULT_BACKGROUND_COLOR: (u8, u8, u8) = (0, 0, 0);
+/// Frames are handed to liqctld as files. The directory is private,
+/// so that no other user is able to replace a frame file, for ex. with a symlink.
+const FRAME_DIR: &str = "/run/coolercontrold/lcd";
+
+/// This enables LCD screens to show live sensor values that are rendered by the daemon.
+/// Frames are rendered on the regular update interval, but only pushed to the device when the
+/// shown values have changed and the frame interval has passed.
+pub struct LcdScheduler {
+    all_devices: AllDevices,
+    repos: ReposByType,
+    scheduled_settings: RwLock<HashMap<UID, HashMap<String, ScheduledLcd>>>,
+    frame_dir: PathBuf,
+}
+
+impl LcdScheduler {
+    pub fn new(all_devices: AllDevices, repos: ReposByType) -> Self {
+        Self::with_frame_dir(all_devices, repos, PathBuf::from(FRAME_DIR))
+    }
+
+    /// Allows using a different frame directory, i.e. for testing.
+    pub fn with_frame_dir(all_devices: AllDevices, repos: ReposByType, frame_dir: PathBuf) -> Self {
+        Self {
+            all_devices,
+            repos,
+            scheduled_settings: RwLock::new(HashMap::new()),
+            frame_dir,
+        }
+    }
+
+    pub async fn schedule_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()> {
+        let lcd_settings = setting.lcd.as_ref()
+            .with_context(|| "LcdSettings should be present")?;
+        if lcd_settings.mode != SENSORS_MODE {
+            return Err(anyhow!("Only the {} LCD mode can be scheduled", SENSORS_MODE));
+        }
+        let device_lock = self.all_devices.get(device_uid)
+            .with_context(|| format!("Target Device for LCD must be present: {}", device_uid))?;
+        // the device's own first temp is used when no temp_source is given, for ex. the liquid temp
+        let temp_source_uid = setting.temp_source.as_ref()
+            .map_or(device_uid.clone(), |temp_source| temp_source.device_uid.clone());
+        let temp_name = match &setting.temp_source {
+            Some(temp_source) => temp_source.temp_name.clone(),
+            None => device_lock.read().await.status_current()
+                .and_then(|status| status.temps.first().map(|temp_status| temp_status.name.clone()))
+                .with_context(|| format!("A Temp Source must be set for the LCD of this device: {}", device_uid))?,
+        };
+        let temp_source_device = self.all_devices.get(&temp_source_uid)
+            .with_context(|| format!("temp_source Device must currently be present to schedule LCD: {}", temp_source_uid))?;
+        let temp_max = temp_source_device.read().await.info.as_ref()
+            .map_or(100, |info| info.temp_max);
+        prepare_frame_dir(&self.frame_dir)?;
+        let frame_file = self.frame_dir.join(
+            format!("{}-{}.bmp", device_uid, setting.channel_name)
+        );
+        self.scheduled_settings.write().await
+            .entry(device_uid.clone())
+            .or_insert_with(HashMap::new)
+            .insert(setting.channel_name.clone(), ScheduledLcd {
+                lcd_settings: lcd_settings.clone(),
+                temp_source_uid,
+                temp_name,
+                temp_max,
+                frame_file,
+                renderer: LcdRenderer::new(LCD_SIZE),
+                last_frame_pushed: None,
+            });
+        Ok(())
+    }
+
+    pub async fn clear_channel_setting(&self, device_uid: &UID, channel_name: &str) {
+        if let Some(device_channel_settings) = self.scheduled_settings.write().await.get_mut(device_uid) {
+            device_channel_settings.remove(channel_name);
+        }
+    }
+
+    pub async fn update_lcd(&self) {
+        let mut frames_to_push: Vec<(UID, DeviceType, Setting)> = Vec::new();
+        for (device_uid, channel_settings) in self.scheduled_settings.write().await.iter_mut() {
+            for (channel_name, scheduled_lcd) in channel_settings.iter_mut() {
+                if scheduled_lcd.last_frame_pushed
+                    .map_or(false, |last_pushed| last_pushed.elapsed() < FRAME_INTERVAL) {
+                    continue;
+                }
+                let temp = self.current_temp(&scheduled_lcd.temp_source_uid, &scheduled_lcd.temp_name).await;
+                let content = FrameContent {
+                    temp: temp.map(|temp| temp.round() as i32),
+                    temp_max: scheduled_lcd.temp_max,
+                    text_color: scheduled_lcd.lcd_settings.colors.get(0).copied()
+                        .unwrap_or(DEFAULT_TEXT_COLOR),
+                    background_color: scheduled_lcd.lcd_settings.colors.get(1).copied()
+                        .unwrap_or(DEFAULT_BACKGROUND_COLOR),
+                };
+                let frame = match scheduled_lcd.renderer.render(&content) {
+                    Some(frame) => frame,
+                    None => continue,  // nothing changed
+                };
+                if let Err(err) = write_frame(&scheduled_lcd.frame_file, &frame) {
+                    error!("Error writing LCD frame file {:?}: {}", scheduled_lcd.frame_file, err);
+                    scheduled_lcd.renderer.invalidate();
+                    continue;
+                }
+                // brightness and orientation only need to be sent with the first frame:
+                let is_first_frame = scheduled_lcd.last_frame_pushed.is_none();
+                scheduled_lcd.last_frame_pushed = Some(Instant::now());
+                let device_type = self.all_devices[device_uid].read().await.d_type.clone();
+                frames_to_push.push((device_uid.clone(), device_type, Setting {
+                    channel_name: channel_name.clone(),
+                    lcd: Some(LcdSettings {
+                        mode: "image".to_string(),
+                        brightness: if is_first_frame { scheduled_lcd.lcd_settings.brightness } else { None },
+                        orientation: if is_first_frame { scheduled_lcd.lcd_settings.orientation } else { None },
+                        image_file_src: None,
+                        image_file_processed: Some(scheduled_lcd.frame_file.to_string_lossy().to_string()),
+                        colors: Vec::new(),
+                    }),
+                    ..Default::default()
+                }));
+            }
+        }
+        for (device_uid, device_type, frame_setting) in frames_to_push {
+            if let Some(repo) = self.repos.get(&device_type) {
+                info!("Applying rendered LCD frame for device: {}", device_uid);
+                if let Err(err) = repo.apply_setting(&device_uid, &frame_setting).await {
+                    error!("Error applying rendered LCD frame: {}", err);
+                    self.invalidate_frame(&device_uid, &frame_setting.channel_name).await;
+                }
+            }
+        }
+    }
+
+    /// The next update renders and pushes the frame again, for ex. after a failed upload.
+    pub async fn invalidate_frame(&self, device_uid: &UID, channel_name: &str) {
+        if let Some(scheduled_lcd) = self.scheduled_settings.write().await
+            .get_mut(device_uid)
+            .and_then(|channel_settings| channel_settings.get_mut(channel_name)) {
+            scheduled_lcd.renderer.invalidate();
+            scheduled_lcd.last_frame_pushed = None;
+        }
+    }
+
+    /// All frames are rendered and pushed again in full on the next update, for ex. after waking from sleep,
+    /// as the device has lost its brightness, orientation and image.
+    pub async fn invalidate_frames(&self) {
+        for channel_settings in self.scheduled_settings.write().await.values_mut() {
+            for scheduled_lcd in channel_settings.values_mut() {
+                scheduled_lcd.renderer.invalidate();
+                scheduled_lcd.last_frame_pushed = None;
+            }
+        }
+    }
+
+    async fn current_temp(&self, temp_source_uid: &UID, temp_name: &str) -> Option<f64> {
+        let device = self.all_devices.get(temp_source_uid)?.read().await;
+        let temp = device.status_history.last()?.temps.iter()
+            .find(|temp_status| temp_status.name == temp_name)
+            .map(|temp_status| temp_status.temp);
+        if temp.is_none() {
+            debug!("Temp: {} not found for LCD on device: {}", temp_name, temp_source_uid);
+        }
+        temp
+    }
+}
+
+struct ScheduledLcd {
+    lcd_settings: LcdSettings,
+    temp_source_uid: UID,
+    temp_name: String,
+    temp_max: u8,
+    frame_file: PathBuf,
+    renderer: LcdRenderer,
+    last_frame_pushed: Option<Instant>,
+}
+
+/// Creates the frame directory only accessible to us, and refuses to use it when it is a symlink
+/// or belongs to someone else.
+fn prepare_frame_dir(frame_dir: &Path) -> Result<()> {
+    if frame_dir.symlink_metadata().is_err() {
+        DirBuilder::new().recursive(true).mode(0o700).create(frame_dir)
+            .with_context(|| format!("Creating LCD frame directory: {:?}", frame_dir))?;
+    }
+    let metadata = frame_dir.symlink_metadata()
+        .with_context(|| format!("Reading LCD frame directory: {:?}", frame_dir))?;
+    if metadata.file_type().is_symlink() || !metadata.is_dir() {
+        return Err(anyhow!("LCD frame directory is not a directory: {:?}", frame_dir));
+    }
+    if metadata.uid() != geteuid().as_raw() {
+        return Err(anyhow!("LCD frame directory belongs to another user: {:?}", frame_dir));
+    }
+    if metadata.mode() & 0o777 != 0o700 {
+        std::fs::set_permissions(frame_dir, std::fs::Permissions::from_mode(0o700))
+            .with_context(|| format!("Setting LCD frame directory permissions: {:?}", frame_dir))?;
+    }
+    Ok(())
+}
+
+/// Frame files are never followed when they are symlinks.
+fn write_frame(frame_file: &Path, frame: &[u8]) -> std::io::Result<()> {
+    let mut file = OpenOptions::new()
+        .write(true)
+        .create(true)
+        .truncate(true)
+        .mode(0o600)
+        .custom_flags(OFlag::O_NOFOLLOW.bits())
+        .open(frame_file)?;
+    file.write_all(frame)
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::path::Path;
+    use std::sync::{Arc, Mutex};
+
+    use async_trait::async_trait;
+    use test_context::{AsyncTestContext, test_context};
+    use uuid::Uuid;
+
+    use crate::device::{Device, Status, TempStatus};
+    use crate::repositories::liquidctl::liquidctl_repo::DeviceProperties;
+    use crate::repositories::liquidctl::supported_devices::device_support::DeviceSupport;
+    use crate::repositories::liquidctl::supported_devices::kraken_z3_mock::KrakenZ3MockSupport;
+    use crate::repositories::repository::{DeviceList, Repository};
+
+    use super::*;
+
+    const TEST_BASE_PATH_STR: &str = "/tmp/coolercontrol-tests-";
+
+    struct LcdFileContext {
+        test_base_path: PathBuf,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncTestContext for LcdFileContext {
+        async fn setup() -> LcdFileContext {
+            let test_base_path = Path::new(
+                &(TEST_BASE_PATH_STR.to_string() + &Uuid::new_v4().to_string())
+            ).to_path_buf();
+            tokio::fs::create_dir_all(&test_base_path).await.unwrap();
+            LcdFileContext { test_base_path }
+        }
+
+        async fn teardown(self) {
+            tokio::fs::remove_dir_all(&self.test_base_path).await.unwrap();
+        }
+    }
+
+    /// Records the settings instead of sending them to liqctld
+    struct RecordingRepo {
+        applied: Mutex<Vec<(UID, Setting)>>,
+    }
+
+    #[async_trait]
+    impl Repository for RecordingRepo {
+        fn device_type(&self) -> DeviceType {
+            DeviceType::Liquidctl
+        }
+
+        async fn initialize_devices(&mut self) -> Result<()> {
+            Ok(())
+        }
+
+        async fn devices(&self) -> DeviceList {
+            vec![]
+        }
+
+        async fn update_statuses(&self) -> Result<()> {
+            Ok(())
+        }
+
+        async fn shutdown(&self) -> Result<()> {
+            Ok(())
+        }
+
+        async fn apply_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()> {
+            self.applied.lock().unwrap().push((device_uid.clone(), setting.clone()));
+            Ok(())
+        }
+    }
+
+    fn kraken_z3_mock() -> Device {
+        let device_props = DeviceProperties {
+            speed_channels: vec!["pump".to_string(), "fan".to_string()],
+            color_channels: vec!["external".to_string()],
+            supports_cooling: Some(true),
+            supports_cooling_profiles: Some(true),
+            supports_lighting: Some(true),
+            led_count: None,
+        };
+        let status = Status {
+            temps: vec![TempStatus {
+                name: "liquid".to_string(),
+                temp: 31.4,
+                frontend_name: "Liquid".to_string(),
+                external_name: "LC#1 Liquid".to_string(),
+            }],
+            ..Default::default()
+        };
+        Device::new(
+            "NZXT Kraken Z3 (mock)".to_string(),
+            DeviceType::Liquidctl,
+            1,
+            None,
+            Some(KrakenZ3MockSupport::new().extract_info(&1, &device_props)),
+            Some(status),
+            None,
+        )
+    }
+
+    fn lcd_scheduler(frame_dir: PathBuf) -> (LcdScheduler, UID, Arc<RecordingRepo>) {
+        let device = kraken_z3_mock();
+        let device_uid = device.uid.clone();
+        let all_devices: AllDevices = Arc::new(HashMap::from([
+            (device_uid.clone(), Arc::new(RwLock::new(device)))
+        ]));
+        let repo = Arc::new(RecordingRepo { applied: Mutex::new(Vec::new()) });
+        let mut repos: ReposByType = HashMap::new();
+        repos.insert(DeviceType::Liquidctl, repo.clone() as Arc<dyn Repository>);
+        (LcdScheduler::with_frame_dir(all_devices, repos, frame_dir), device_uid, repo)
+    }
+
+    fn sensors_setting() -> Setting {
+        Setting {
+            channel_name: "lcd".to_string(),
+            lcd: Some(LcdSettings {
+                mode: SENSORS_MODE.to_string(),
+                brightness: Some(60),
+                orientation: Some(90),
+                image_file_src: None,
+                image_file_processed: None,
+                colors: Vec::new(),
+            }),
+            ..Default::default()
+        }
+    }
+
+    #[test_context(LcdFileContext)]
+    #[tokio::test]
+    async fn first_frame_sets_brightness_and_orientation(ctx: &mut LcdFileContext) {
+        // given:
+        let frame_dir = ctx.test_base_path.join("lcd");
+        let (scheduler, device_uid, repo) = lcd_scheduler(frame_dir.clone());
+        scheduler.schedule_setting(&device_uid, &sensors_setting()).await.unwrap();
+
+        // when:
+        scheduler.update_lcd().await;
+
+        // then:
+        let applied = repo.applied.lock().unwrap().clone();
+        assert_eq!(applied.len(), 1);
+        let lcd_settings = applied[0].1.lcd.clone().unwrap();
+        assert_eq!(lcd_settings.mode, "image");
+        assert_eq!(lcd_settings.brightness, Some(60));
+        assert_eq!(lcd_settings.orientation, Some(90));
+        let frame = std::fs::read(lcd_settings.image_file_processed.unwrap()).unwrap();
+        assert_eq!(&frame[0..2], b"BM");
+        assert_eq!(frame_dir.metadata().unwrap().mode() & 0o777, 0o700);
+    }
+
+    #[test_context(LcdFileContext)]
+    #[tokio::test]
+    async fn frames_are_sent_again_after_invalidation(ctx: &mut LcdFileContext) {
+        // given:
+        let (scheduler, device_uid, repo) = lcd_scheduler(ctx.test_base_path.join("lcd"));
+        scheduler.schedule_setting(&device_uid, &sensors_setting()).await.unwrap();
+        scheduler.update_lcd().await;
+
+        // when:
+        scheduler.update_lcd().await;  // within the frame interval
+        scheduler.invalidate_frames().await;
+        scheduler.update_lcd().await;
+
+        // then:
+        let applied = repo.applied.lock().unwrap().clone();
+        assert_eq!(applied.len(), 2);
+        assert_eq!(applied[1].1.lcd.as_ref().unwrap().brightness, Some(60));
+    }
+
+    #[test_context(LcdFileContext)]
+    #[tokio::test]
+    async fn symlinked_frame_dir_is_refused(ctx: &mut LcdFileContext) {
+        // given:
+        let other_dir = ctx.test_base_path.join("other");
+        std::fs::create_dir(&other_dir).unwrap();
+        let frame_dir = ctx.test_base_path.join("lcd");
+        std::os::unix::fs::symlink(&other_dir, &frame_dir).unwrap();
+        let (scheduler, device_uid, _) = lcd_scheduler(frame_dir);
+
+        // when:
+        let result = scheduler.schedule_setting(&device_uid, &sensors_setting()).await;
+
+        // then:
+        assert!(result.is_err());
+    }
+
+    #[test_context(LcdFileContext)]
+    #[tokio::test]
+    async fn symlinked_frame_file_is_not_followed(ctx: &mut LcdFileContext) {
+        // given:
+        let target_file = ctx.test_base_path.join("target");
+        std::fs::write(&target_file, b"untouched").unwrap();
+        let frame_file = ctx.test_base_path.join("frame.bmp");
+        std::os::unix::fs::symlink(&target_file, &frame_file).unwrap();
+
+        // when:
+        let result = write_frame(&frame_file, b"BM");
+
+        // then:
+        assert!(result.is_err());
+        assert_eq!(std::fs::read(&target_file).unwrap(), b"untouched");
+    }
+}
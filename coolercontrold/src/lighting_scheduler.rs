@@ -0,0 +1,523 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::collections::HashMap;
+use std::f64::consts::PI;
+use std::time::{Duration, Instant};
+
+use anyhow::{anyhow, Context, Result};
+use log::{debug, error};
+use tokio::sync::RwLock;
+use zbus::export::futures_util::future::join_all;
+
+use crate::AllDevices;
+use crate::device::UID;
+use crate::device_commander::ReposByType;
+use crate::setting::{LightingSettings, Setting};
+
+pub const COLOR_CYCLE_MODE: &str = "custom-color-cycle";
+pub const BREATHING_MODE: &str = "custom-breathing";
+pub const TEMP_GRADIENT_MODE: &str = "custom-temp-gradient";
+/// The liquidctl channel that sets all lighting channels of a device at once
+const SYNC_CHANNEL: &str = "sync";
+/// The liquidctl mode that is used to set each frame of an effect
+pub const FRAME_MODE: &str = "fixed";
+/// How often the effect loop checks for due frames
+pub const EFFECT_TICK: Duration = Duration::from_millis(50);
+const MIN_FRAME_INTERVAL: Duration = Duration::from_millis(100);
+const MAX_FRAME_INTERVAL: Duration = Duration::from_secs(1);
+
+pub fn is_effect_mode(mode: &str) -> bool {
+    mode == COLOR_CYCLE_MODE || mode == BREATHING_MODE || mode == TEMP_GRADIENT_MODE
+}
+
+/// This is a software lighting effect engine for devices that only support static colors, or to
+/// have effects that the device firmware doesn't have, like colors that follow a temperature.
+/// Each frame is sent as a fixed color. Frames are paced per device by how long the device takes
+/// to apply them, so that at least half of the device's time stays free for cooling commands,
+/// and frames that don't change the colors are not sent at all.
+pub struct LightingScheduler {
+    all_devices: AllDevices,
+    repos: ReposByType,
+    scheduled_devices: RwLock<HashMap<UID, ScheduledDevice>>,
+}
+
+impl LightingScheduler {
+    pub fn new(all_devices: AllDevices, repos: ReposByType) -> Self {
+        Self {
+            all_devices,
+            repos,
+            scheduled_devices: RwLock::new(HashMap::new()),
+        }
+    }
+
+    pub async fn schedule_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()> {
+        let lighting = setting.lighting.as_ref()
+            .with_context(|| "LightingSettings should be present")?;
+        let device_lock = self.all_devices.get(device_uid)
+            .with_context(|| format!("Target Device for lighting effect must be present: {}", device_uid))?;
+        let effect = match lighting.mode.as_str() {
+            COLOR_CYCLE_MODE => Effect::ColorCycle,
+            BREATHING_MODE => Effect::Breathing,
+            TEMP_GRADIENT_MODE => {
+                // the device's own first temp is used when no temp_source is given, for ex. the liquid temp
+                let temp_source_uid = setting.temp_source.as_ref()
+                    .map_or(device_uid.clone(), |temp_source| temp_source.device_uid.clone());
+                let temp_name = match &setting.temp_source {
+                    Some(temp_source) => temp_source.temp_name.clone(),
+                    None => device_lock.read().await.status_current()
+                        .and_then(|status| status.temps.first().map(|temp_status| temp_status.name.clone()))
+                        .with_context(|| format!("A Temp Source must be set for the lighting effect of this device: {}", device_uid))?,
+                };
+                let temp_source_device = self.all_devices.get(&temp_source_uid)
+                    .with_context(|| format!("temp_source Device must currently be present to schedule lighting: {}", temp_source_uid))?;
+                let (temp_min, temp_max) = temp_source_device.read().await.info.as_ref()
+                    .map_or((20, 100), |info| (info.temp_min, info.temp_max));
+                Effect::TempGradient { temp_source_uid, temp_name, temp_min, temp_max }
+            }
+            _ => return Err(anyhow!("Lighting mode {} is not a lighting effect", lighting.mode)),
+        };
+        let mut scheduled_devices = self.scheduled_devices.write().await;
+        let scheduled_device = scheduled_devices.entry(device_uid.clone())
+            .or_insert_with(ScheduledDevice::new);
+        scheduled_device.remove_overlapping_effects(&setting.channel_name);
+        scheduled_device.channels.insert(setting.channel_name.clone(), ScheduledEffect {
+            effect,
+            lighting: lighting.clone(),
+            started: Instant::now(),
+            last_color: None,
+        });
+        Ok(())
+    }
+
+    pub async fn clear_channel_setting(&self, device_uid: &UID, channel_name: &str) {
+        let mut scheduled_devices = self.scheduled_devices.write().await;
+        if let Some(scheduled_device) = scheduled_devices.get_mut(device_uid) {
+            scheduled_device.channels.remove(channel_name);
+            if scheduled_device.channels.is_empty() {
+                scheduled_devices.remove(device_uid);
+            }
+        }
+    }
+
+    /// Clears the effects that a lighting mode set by the device's firmware replaces.
+    pub async fn clear_for_device_mode(&self, device_uid: &UID, channel_name: &str) {
+        let mut scheduled_devices = self.scheduled_devices.write().await;
+        if let Some(scheduled_device) = scheduled_devices.get_mut(device_uid) {
+            scheduled_device.remove_overlapping_effects(channel_name);
+            if scheduled_device.channels.is_empty() {
+                scheduled_devices.remove(device_uid);
+            }
+        }
+    }
+
+    /// Sends the next frame to every device that is due. Devices are handled concurrently,
+    /// and each device only ever has one frame in flight.
+    pub async fn update_lighting(&self) {
+        let mut due_frames: HashMap<UID, Vec<Setting>> = HashMap::new();
+        {
+            let now = Instant::now();
+            let mut scheduled_devices = self.scheduled_devices.write().await;
+            for (device_uid, scheduled_device) in scheduled_devices.iter_mut() {
+                if scheduled_device.frame_in_flight || now < scheduled_device.next_frame {
+                    continue;
+                }
+                let mut frames = Vec::new();
+                for (channel_name, scheduled_effect) in scheduled_device.channels.iter_mut() {
+                    let temp = match &scheduled_effect.effect {
+                        Effect::TempGradient { temp_source_uid, temp_name, .. } =>
+                            self.current_temp(temp_source_uid, temp_name).await,
+                        _ => None,
+                    };
+                    let color = match scheduled_effect.frame_color(now, temp) {
+                        Some(color) => color,
+                        None => continue,
+                    };
+                    if scheduled_effect.last_color == Some(color) {
+                        continue;  // the same frame again
+                    }
+                    frames.push(Setting {
+                        channel_name: channel_name.clone(),
+                        lighting: Some(LightingSettings {
+                            mode: FRAME_MODE.to_string(),
+                            speed: None,
+                            backward: None,
+                            colors: vec![color],
+                        }),
+                        ..Default::default()
+                    });
+                }
+                if !frames.is_empty() {
+                    scheduled_device.frame_in_flight = true;
+                    due_frames.insert(device_uid.clone(), frames);
+                }
+            }
+        }
+        let device_futures = due_frames.into_iter()
+            .map(|(device_uid, frames)| async move {
+                let frame_start = Instant::now();
+                let mut applied_frames = Vec::new();
+                if let Some(device_lock) = self.all_devices.get(&device_uid) {
+                    let device_type = device_lock.read().await.d_type.clone();
+                    if let Some(repo) = self.repos.get(&device_type) {
+                        for frame in frames {
+                            match repo.apply_lighting_frame(&device_uid, &frame).await {
+                                Ok(true) => applied_frames.push(frame),
+                                Ok(false) => debug!("Lighting frame for device: {} dropped", device_uid),
+                                Err(err) => error!("Error applying lighting frame: {}", err),
+                            }
+                        }
+                    }
+                }
+                self.frame_done(&device_uid, applied_frames, frame_start.elapsed()).await;
+            });
+        join_all(device_futures).await;
+    }
+
+    async fn frame_done(&self, device_uid: &UID, applied_frames: Vec<Setting>, frame_duration: Duration) {
+        if let Some(scheduled_device) = self.scheduled_devices.write().await.get_mut(device_uid) {
+            scheduled_device.frame_in_flight = false;
+            scheduled_device.next_frame = Instant::now() + frame_interval(frame_duration);
+            for frame in applied_frames {
+                if let Some(scheduled_effect) = scheduled_device.channels.get_mut(&frame.channel_name) {
+                    scheduled_effect.last_color = frame.lighting
+                        .and_then(|lighting| lighting.colors.first().copied());
+                }
+            }
+        }
+    }
+
+    /// All effects are sent again in full on the next frame, for ex. after waking from sleep.
+    pub async fn invalidate_frames(&self) {
+        for scheduled_device in self.scheduled_devices.write().await.values_mut() {
+            for scheduled_effect in scheduled_device.channels.values_mut() {
+                scheduled_effect.last_color = None;
+            }
+        }
+    }
+
+    async fn current_temp(&self, temp_source_uid: &UID, temp_name: &str) -> Option<f64> {
+        let device = self.all_devices.get(temp_source_uid)?.read().await;
+        let temp = device.status_history.last()?.temps.iter()
+            .find(|temp_status| temp_status.name == temp_name)
+            .map(|temp_status| temp_status.temp);
+        if temp.is_none() {
+            debug!("Temp: {} not found for lighting effect on device: {}", temp_name, temp_source_uid);
+        }
+        temp
+    }
+}
+
+/// The time between frames is twice what the last frame took to apply, within limits.
+fn frame_interval(frame_duration: Duration) -> Duration {
+    (frame_duration * 2).clamp(MIN_FRAME_INTERVAL, MAX_FRAME_INTERVAL)
+}
+
+/// The period of one effect cycle for the liquidctl speed names
+fn effect_period(speed: &Option<String>) -> Duration {
+    match speed.as_deref() {
+        Some("slowest") => Duration::from_secs(20),
+        Some("slower") => Duration::from_secs(12),
+        Some("faster") => Duration::from_secs(5),
+        Some("fastest") => Duration::from_secs(3),
+        _ => Duration::from_secs(8),
+    }
+}
+
+struct ScheduledDevice {
+    channels: HashMap<String, ScheduledEffect>,
+    next_frame: Instant,
+    frame_in_flight: bool,
+}
+
+impl ScheduledDevice {
+    fn new() -> Self {
+        Self {
+            channels: HashMap::new(),
+            next_frame: Instant::now(),
+            frame_in_flight: false,
+        }
+    }
+
+    /// A setting for the sync channel replaces the effects of all the single channels,
+    /// and a setting for a single channel replaces the sync effect.
+    fn remove_overlapping_effects(&mut self, channel_name: &str) {
+        if channel_name == SYNC_CHANNEL {
+            self.channels.clear();
+        } else {
+            self.channels.remove(channel_name);
+            self.channels.remove(SYNC_CHANNEL);
+        }
+    }
+}
+
+enum Effect {
+    ColorCycle,
+    Breathing,
+    TempGradient { temp_source_uid: UID, temp_name: String, temp_min: u8, temp_max: u8 },
+}
+
+struct ScheduledEffect {
+    effect: Effect,
+    lighting: LightingSettings,
+    started: Instant,
+    last_color: Option<(u8, u8, u8)>,
+}
+
+impl ScheduledEffect {
+    /// Returns the color of the frame at the given time, or None if it can't be determined.
+    fn frame_color(&self, now: Instant, temp: Option<f64>) -> Option<(u8, u8, u8)> {
+        let period = effect_period(&self.lighting.speed).as_secs_f64();
+        let mut phase = (now.duration_since(self.started).as_secs_f64() / period).fract();
+        if self.lighting.backward.unwrap_or(false) {
+            phase = 1.0 - phase;
+        }
+        match &self.effect {
+            Effect::ColorCycle => Some(
+                if self.lighting.colors.is_empty() {
+                    hue_to_rgb(phase)
+                } else {
+                    // blends from each color to the next and back to the first
+                    let colors = &self.lighting.colors;
+                    let position = phase * colors.len() as f64;
+                    let index = position.floor() as usize % colors.len();
+                    blend(colors[index], colors[(index + 1) % colors.len()], position.fract())
+                }
+            ),
+            Effect::Breathing => {
+                let color = *self.lighting.colors.first()?;
+                let brightness = (1.0 - (2.0 * PI * phase).cos()) / 2.0;
+                Some(blend((0, 0, 0), color, brightness))
+            }
+            Effect::TempGradient { temp_min, temp_max, .. } => {
+                let cool_color = *self.lighting.colors.first()?;
+                let hot_color = *self.lighting.colors.get(1)?;
+                let temp_range = (*temp_max as f64 - *temp_min as f64).max(1.0);
+                let ratio = ((temp? - *temp_min as f64) / temp_range).clamp(0.0, 1.0);
+                Some(blend(cool_color, hot_color, ratio))
+            }
+        }
+    }
+}
+
+fn blend(from: (u8, u8, u8), to: (u8, u8, u8), ratio: f64) -> (u8, u8, u8) {
+    let channel = |from: u8, to: u8| (from as f64 + (to as f64 - from as f64) * ratio).round() as u8;
+    (channel(from.0, to.0), channel(from.1, to.1), channel(from.2, to.2))
+}
+
+/// Full saturation and value colors around the color wheel, with hue from 0.0 to 1.0
+fn hue_to_rgb(hue: f64) -> (u8, u8, u8) {
+    let sector = hue * 6.0;
+    let rising = (sector.fract() * 255.0).round() as u8;
+    let falling = 255 - rising;
+    match sector.floor() as u8 % 6 {
+        0 => (255, rising, 0),
+        1 => (falling, 255, 0),
+        2 => (0, 255, rising),
+        3 => (0, falling, 255),
+        4 => (rising, 0, 255),
+        _ => (255, 0, falling),
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::sync::Arc;
+
+    use crate::device::{Device, DeviceType};
+
+    use super::*;
+
+    fn lighting_scheduler() -> (LightingScheduler, UID) {
+        let device = Device::new(
+            "NZXT Smart Device V2".to_string(),
+            DeviceType::Liquidctl,
+            1,
+            None,
+            None,
+            None,
+            None,
+        );
+        let device_uid = device.uid.clone();
+        let all_devices: AllDevices = Arc::new(HashMap::from([
+            (device_uid.clone(), Arc::new(RwLock::new(device)))
+        ]));
+        (LightingScheduler::new(all_devices, HashMap::new()), device_uid)
+    }
+
+    fn color_cycle_setting(channel_name: &str) -> Setting {
+        Setting {
+            channel_name: channel_name.to_string(),
+            lighting: Some(LightingSettings {
+                mode: COLOR_CYCLE_MODE.to_string(),
+                speed: Some("normal".to_string()),
+                backward: None,
+                colors: Vec::new(),
+            }),
+            ..Default::default()
+        }
+    }
+
+    async fn scheduled_channels(scheduler: &LightingScheduler, device_uid: &UID) -> Vec<String> {
+        let mut channel_names: Vec<String> = scheduler.scheduled_devices.read().await[device_uid]
+            .channels.keys().cloned().collect();
+        channel_names.sort();
+        channel_names
+    }
+
+    fn scheduled_effect(effect: Effect, colors: Vec<(u8, u8, u8)>, started: Instant) -> ScheduledEffect {
+        ScheduledEffect {
+            effect,
+            lighting: LightingSettings {
+                mode: "whatever".to_string(),
+                speed: Some("normal".to_string()),
+                backward: None,
+                colors,
+            },
+            started,
+            last_color: None,
+        }
+    }
+
+    #[test]
+    fn color_cycle_blends_between_colors() {
+        // given:
+        let started = Instant::now();
+        let effect = scheduled_effect(Effect::ColorCycle, vec![(255, 0, 0), (0, 0, 255)], started);
+
+        // when:
+        let start_color = effect.frame_color(started, None);
+        let quarter_color = effect.frame_color(started + Duration::from_secs(2), None);
+        let half_color = effect.frame_color(started + Duration::from_secs(4), None);
+
+        // then:
+        assert_eq!(start_color, Some((255, 0, 0)));
+        assert_eq!(quarter_color, Some((128, 0, 128)));
+        assert_eq!(half_color, Some((0, 0, 255)));
+    }
+
+    #[test]
+    fn breathing_fades_in_and_out() {
+        // given:
+        let started = Instant::now();
+        let effect = scheduled_effect(Effect::Breathing, vec![(0, 200, 100)], started);
+
+        // when:
+        let dark = effect.frame_color(started, None);
+        let bright = effect.frame_color(started + Duration::from_secs(4), None);
+
+        // then:
+        assert_eq!(dark, Some((0, 0, 0)));
+        assert_eq!(bright, Some((0, 200, 100)));
+    }
+
+    #[test]
+    fn temp_gradient_follows_temp() {
+        // given:
+        let effect = scheduled_effect(
+            Effect::TempGradient {
+                temp_source_uid: "uid".to_string(),
+                temp_name: "liquid".to_string(),
+                temp_min: 20,
+                temp_max: 60,
+            },
+            vec![(0, 0, 255), (255, 0, 0)],
+            Instant::now(),
+        );
+
+        // when:
+        let no_temp = effect.frame_color(Instant::now(), None);
+        let middle = effect.frame_color(Instant::now(), Some(40.0));
+        let too_hot = effect.frame_color(Instant::now(), Some(90.0));
+
+        // then:
+        assert_eq!(no_temp, None);
+        assert_eq!(middle, Some((128, 0, 128)));
+        assert_eq!(too_hot, Some((255, 0, 0)));
+    }
+
+    #[test]
+    fn frame_interval_is_paced_by_device_time() {
+        assert_eq!(frame_interval(Duration::from_millis(10)), MIN_FRAME_INTERVAL);
+        assert_eq!(frame_interval(Duration::from_millis(150)), Duration::from_millis(300));
+        assert_eq!(frame_interval(Duration::from_secs(2)), MAX_FRAME_INTERVAL);
+    }
+
+    #[test]
+    fn hue_wheel() {
+        assert_eq!(hue_to_rgb(0.0), (255, 0, 0));
+        assert_eq!(hue_to_rgb(1.0 / 3.0), (0, 255, 0));
+        assert_eq!(hue_to_rgb(2.0 / 3.0), (0, 0, 255));
+    }
+
+    #[tokio::test]
+    async fn sync_effect_replaces_channel_effects() {
+        // given:
+        let (scheduler, device_uid) = lighting_scheduler();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led1")).await.unwrap();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led2")).await.unwrap();
+
+        // when:
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("sync")).await.unwrap();
+
+        // then:
+        assert_eq!(scheduled_channels(&scheduler, &device_uid).await, vec!["sync"]);
+    }
+
+    #[tokio::test]
+    async fn channel_effect_replaces_sync_effect() {
+        // given:
+        let (scheduler, device_uid) = lighting_scheduler();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("sync")).await.unwrap();
+
+        // when:
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led1")).await.unwrap();
+
+        // then:
+        assert_eq!(scheduled_channels(&scheduler, &device_uid).await, vec!["led1"]);
+    }
+
+    #[tokio::test]
+    async fn device_mode_on_sync_clears_all_effects() {
+        // given:
+        let (scheduler, device_uid) = lighting_scheduler();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led1")).await.unwrap();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led2")).await.unwrap();
+
+        // when:
+        scheduler.clear_for_device_mode(&device_uid, "sync").await;
+
+        // then:
+        assert!(!scheduler.scheduled_devices.read().await.contains_key(&device_uid));
+    }
+
+    #[tokio::test]
+    async fn device_mode_on_a_channel_clears_its_and_the_sync_effect() {
+        // given:
+        let (scheduler, device_uid) = lighting_scheduler();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led1")).await.unwrap();
+        scheduler.schedule_setting(&device_uid, &color_cycle_setting("led2")).await.unwrap();
+
+        // when:
+        scheduler.clear_for_device_mode(&device_uid, "led1").await;
+
+        // then:
+        assert_eq!(scheduled_channels(&scheduler, &device_uid).await, vec!["led2"]);
+    }
+}
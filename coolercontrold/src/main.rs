@@ -18,6 +18,7 @@
 
 use std::collections::HashMap;
 use std::ops::Not;
+use std::path::PathBuf;
 use std::sync::Arc;
 use std::sync::atomic::{AtomicBool, Ordering};
 use std::time::Duration;
@@ -52,6 +53,10 @@ mod gui_server;
 mod device_commander;
 mod config;
 mod speed_scheduler;
+mod pid_controller;
+mod lcd_renderer;
+mod lcd_scheduler;
+mod lighting_scheduler;
 mod utils;
 mod sleep_listener;
 
@@ -94,9 +99,11 @@ async fn main() -> Result<()> {
     ).await;
     let mut init_repos: Vec<Arc<dyn Repository>> = vec![];
     let mut liquidctl_update_client: Option<Arc<LiqctldUpdateClient>> = None;
+    let mut kernel_driver_paths = Vec::new();
     match init_liquidctl_repo(config.clone()).await { // should be first as it's the slowest
         Ok(repo) => {
             liquidctl_update_client = Some(repo.liqctld_update_client.clone());
+            kernel_driver_paths = repo.kernel_driver_paths();
             init_repos.push(Arc::new(repo))
         }
         Err(err) => error!("Error initializing Liquidctl Repo: {}", err)
@@ -109,7 +116,7 @@ async fn main() -> Result<()> {
         Ok(repo) => init_repos.push(Arc::new(repo)),
         Err(err) => error!("Error initializing GPU Repo: {}", err)
     }
-    match init_hwmon_repo().await {
+    match init_hwmon_repo(kernel_driver_paths).await {
         Ok(repo) => init_repos.push(Arc::new(repo)),
         Err(err) => error!("Error initializing Hwmon Repo: {}", err)
     }
@@ -139,11 +146,13 @@ async fn main() -> Result<()> {
         config.clone(),
     ));
 
+    device_commander.load_profile_sets(&config.get_profile_sets().await?).await;
+
     if config.get_settings().await?.apply_on_boot {
         apply_saved_device_settings(&config, &all_devices, &device_commander).await;
     }
 
-    let sleep_listener = SleepListener::new().await?;
+    let sleep_listener = Arc::new(SleepListener::new().await?);
 
     let server = gui_server::init_server(
         all_devices.clone(), device_commander.clone(), config.clone(),
@@ -151,6 +160,7 @@ async fn main() -> Result<()> {
     tokio::task::spawn(server);
 
     add_update_job_to_scheduler(&mut scheduler, &liquidctl_update_client, &repos, &device_commander);
+    spawn_lighting_effects(&device_commander, &sleep_listener, &term_signal);
 
     // main loop:
     while !term_signal.load(Ordering::Relaxed) {
@@ -165,6 +175,8 @@ async fn main() -> Result<()> {
                 device_commander.reinitialize_devices().await;
                 apply_saved_device_settings(&config, &all_devices, &device_commander).await;
             }
+            // LCD screens lose their image while sleeping, independent of apply_on_boot:
+            device_commander.lcd_scheduler.invalidate_frames().await;
             sleep_listener.waking_up(false);
             sleep_listener.sleeping(false);
         } else if sleep_listener.is_sleeping().not() {
@@ -247,8 +259,8 @@ async fn init_gpu_repo() -> Result<GpuRepo> {
     Ok(gpu_repo)
 }
 
-async fn init_hwmon_repo() -> Result<HwmonRepo> {
-    let mut hwmon_repo = HwmonRepo::new().await?;
+async fn init_hwmon_repo(kernel_driver_paths: Vec<PathBuf>) -> Result<HwmonRepo> {
+    let mut hwmon_repo = HwmonRepo::new(kernel_driver_paths).await?;
     hwmon_repo.initialize_devices().await?;
     Ok(hwmon_repo)
 }
@@ -276,6 +288,8 @@ async fn apply_saved_device_settings(
     device_commander: &Arc<DeviceCommander>,
 ) {
     info!("Applying saved device settings");
+    // read first, as applying device settings clears the active profile set
+    let active_profile_set = config.get_active_profile_set().await;
     for uid in all_devices.keys() {
         match config.get_device_settings(uid).await {
             Ok(settings) => {
@@ -289,6 +303,22 @@ async fn apply_saved_device_settings(
             Err(err) => error!("Error trying to read device settings from config file: {}", err)
         }
     }
+    match config.get_fan_groups().await {
+        Ok(fan_groups) => for fan_group in fan_groups.iter() {
+            if let Err(err) = device_commander.set_fan_group(fan_group).await {
+                error!("Error setting fan group {}: {}", fan_group.name, err);
+            }
+        }
+        Err(err) => error!("Error trying to read fan groups from config file: {}", err)
+    }
+    match active_profile_set {
+        Ok(Some(set_name)) => match device_commander.activate_profile_set(&set_name).await {
+            Ok(_) => config.set_active_profile_set(&set_name).await,
+            Err(err) => error!("Error activating Profile Set {}: {}", set_name, err),
+        }
+        Ok(None) => {}
+        Err(err) => error!("Error trying to read the active Profile Set from config file: {}", err)
+    }
 }
 
 fn add_update_job_to_scheduler(
@@ -303,6 +333,7 @@ fn add_update_job_to_scheduler(
             Some(Arc::clone(&client))
         } else { None };
     let pass_speed_scheduler = Arc::clone(&device_commander.speed_scheduler);
+    let pass_lcd_scheduler = Arc::clone(&device_commander.lcd_scheduler);
 
     scheduler.every(Interval::Seconds(1))
         .run(
@@ -314,6 +345,7 @@ fn add_update_job_to_scheduler(
                         Some(Arc::clone(&client))
                     } else { None };
                 let moved_speed_scheduler = Arc::clone(&pass_speed_scheduler);
+                let moved_lcd_scheduler = Arc::clone(&pass_lcd_scheduler);
                 Box::pin({
                     async move {
                         debug!("Status updates triggered");
@@ -329,12 +361,40 @@ fn add_update_job_to_scheduler(
                         debug!("Time taken to update all devices: {:?}", start_initialization.elapsed());
                         debug!("Speed Scheduler triggered");
                         moved_speed_scheduler.update_speed().await;
+                        moved_lcd_scheduler.update_lcd().await;
                     }
                 })
             }
         );
 }
 
+/// Lighting effects run on their own short tick, so that frames are not held up by status updates.
+fn spawn_lighting_effects(
+    device_commander: &Arc<DeviceCommander>,
+    sleep_listener: &Arc<SleepListener>,
+    term_signal: &Arc<AtomicBool>,
+) {
+    let lighting_scheduler = Arc::clone(&device_commander.lighting_scheduler);
+    let sleep_listener = Arc::clone(sleep_listener);
+    let term_signal = Arc::clone(term_signal);
+    tokio::task::spawn(async move {
+        let mut was_sleeping = false;
+        while !term_signal.load(Ordering::Relaxed) {
+            let is_sleeping = sleep_listener.is_sleeping() || sleep_listener.is_waking_up();
+            if is_sleeping {
+                was_sleeping = true;
+            } else {
+                if was_sleeping {
+                    lighting_scheduler.invalidate_frames().await;
+                    was_sleeping = false;
+                }
+                lighting_scheduler.update_lighting().await;
+            }
+            tokio::time::sleep(crate::lighting_scheduler::EFFECT_TICK).await;
+        }
+    });
+}
+
 async fn shutdown(repos: Repos) -> Result<()> {
     info!("Main process shutting down");
     for repo in repos.iter() {
@@ -0,0 +1,178 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::time::Instant;
+
+use crate::setting::PidSettings;
+
+/// The time between updates is capped, so that a missed or delayed tick
+/// doesn't cause a large jump in the integral and derivative terms.
+const MAX_TIME_DELTA_SECS: f64 = 5.0;
+
+/// A PID controller that calculates the duty needed to hold a target temperature.
+/// - The error is positive when the temperature is above the target, which increases the duty.
+/// - The derivative is taken from the measured temperature instead of the error, so that changing
+///   the target doesn't cause a spike, and is smoothed with a first-order low-pass filter.
+/// - Anti-windup: the integral is only accumulated when the output isn't saturated in the same
+///   direction, and is itself limited to the max output.
+#[derive(Debug, Clone)]
+pub struct PidController {
+    settings: PidSettings,
+    min_output: f64,
+    max_output: f64,
+    integral: f64,
+    filtered_derivative: f64,
+    previous_measurement: Option<f64>,
+    last_update: Option<Instant>,
+}
+
+impl PidController {
+    pub fn new(settings: PidSettings, min_duty: u8, max_duty: u8) -> Self {
+        Self {
+            settings,
+            min_output: min_duty as f64,
+            max_output: max_duty as f64,
+            integral: 0.,
+            filtered_derivative: 0.,
+            previous_measurement: None,
+            last_update: None,
+        }
+    }
+
+    pub fn max_duty(&self) -> u8 {
+        self.max_output as u8
+    }
+
+    /// Calculates the duty from the current temperature, using the time since the last update.
+    /// Returned duty is rounded to the nearest integer and is within min_duty and max_duty.
+    pub fn update(&mut self, measurement: f64) -> u8 {
+        let now = Instant::now();
+        let time_delta = self.last_update
+            .map_or(0., |last_update| now.duration_since(last_update).as_secs_f64());
+        self.last_update = Some(now);
+        self.update_with_time_delta(measurement, time_delta).round() as u8
+    }
+
+    fn update_with_time_delta(&mut self, measurement: f64, time_delta: f64) -> f64 {
+        let time_delta = time_delta.min(MAX_TIME_DELTA_SECS);
+        let error = measurement - self.settings.target_temp;
+        let proportional = self.settings.kp * error;
+        if time_delta > 0. {
+            if let Some(previous_measurement) = self.previous_measurement {
+                let raw_derivative = (measurement - previous_measurement) / time_delta;
+                let filter_time = self.settings.derivative_filter.max(0.);
+                let alpha = filter_time / (filter_time + time_delta);
+                self.filtered_derivative =
+                    alpha * self.filtered_derivative + (1. - alpha) * raw_derivative;
+            }
+        }
+        self.previous_measurement = Some(measurement);
+        let derivative = self.settings.kd * self.filtered_derivative;
+        let integral_step = self.settings.ki * error * time_delta;
+        let unclamped_output = proportional + self.integral + integral_step + derivative;
+        let winding_up = (unclamped_output > self.max_output && integral_step > 0.)
+            || (unclamped_output < self.min_output && integral_step < 0.);
+        if !winding_up {
+            self.integral = (self.integral + integral_step)
+                .clamp(-self.max_output, self.max_output);
+        }
+        (proportional + self.integral + derivative).clamp(self.min_output, self.max_output)
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn pid_settings(kp: f64, ki: f64, kd: f64) -> PidSettings {
+        PidSettings {
+            target_temp: 35.,
+            kp,
+            ki,
+            kd,
+            derivative_filter: 0.,
+        }
+    }
+
+    #[test]
+    fn proportional_output_is_clamped() {
+        // given:
+        let mut controller = PidController::new(pid_settings(10., 0., 0.), 20, 100);
+
+        // when:
+        let under_target = controller.update_with_time_delta(30., 1.);
+        let over_target = controller.update_with_time_delta(40., 1.);
+        let far_over_target = controller.update_with_time_delta(50., 1.);
+
+        // then:
+        assert_eq!(under_target, 20.);
+        assert_eq!(over_target, 50.);
+        assert_eq!(far_over_target, 100.);
+    }
+
+    #[test]
+    fn integral_holds_duty_at_target() {
+        // given:
+        let mut controller = PidController::new(pid_settings(0., 1., 0.), 0, 100);
+
+        // when:
+        for _ in 0..10 {
+            controller.update_with_time_delta(40., 1.);
+        }
+        let at_target = controller.update_with_time_delta(35., 1.);
+
+        // then:
+        assert_eq!(at_target, 50.);
+    }
+
+    #[test]
+    fn anti_windup_while_saturated() {
+        // given:
+        let mut controller = PidController::new(pid_settings(5., 1., 0.), 0, 100);
+
+        // when:
+        for _ in 0..100 {
+            controller.update_with_time_delta(60., 1.);  // saturated at max_duty
+        }
+        let back_at_target = controller.update_with_time_delta(35., 1.);
+
+        // then:
+        // without anti-windup the integral would be at max_duty and take a long time to unwind
+        assert_eq!(back_at_target, 0.);
+    }
+
+    #[test]
+    fn derivative_is_filtered() {
+        // given:
+        let mut unfiltered = PidController::new(pid_settings(0., 0., 10.), 0, 100);
+        let mut filtered = PidController::new(
+            PidSettings { derivative_filter: 3., ..pid_settings(0., 0., 10.) }, 0, 100,
+        );
+        unfiltered.update_with_time_delta(35., 1.);
+        filtered.update_with_time_delta(35., 1.);
+
+        // when:
+        let unfiltered_output = unfiltered.update_with_time_delta(38., 1.);
+        let filtered_output = filtered.update_with_time_delta(38., 1.);
+
+        // then:
+        assert_eq!(unfiltered_output, 30.);
+        assert_eq!(filtered_output, 7.5);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,305 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::path::{Path, PathBuf};
+
+use anyhow::{anyhow, Context, Result};
+
+const GPU_METRICS_FILE_NAME: &str = "gpu_metrics";
+const METRICS_HEADER_SIZE: usize = 4;
+/// The driver uses this value for metrics that are not supported by the specific ASIC
+const UNSUPPORTED_VALUE_U16: u16 = 0xFFFF;
+
+// dGPU gpu_metrics_v1_x field offsets (naturally aligned C struct)
+const V1_0_TEMP_EDGE: usize = 16;
+const V1_0_TEMP_HOTSPOT: usize = 18;
+const V1_0_TEMP_MEM: usize = 20;
+const V1_0_GFX_ACTIVITY: usize = 28;
+const V1_0_SOCKET_POWER: usize = 34;
+const V1_1_TEMP_EDGE: usize = 4;
+const V1_1_TEMP_HOTSPOT: usize = 6;
+const V1_1_TEMP_MEM: usize = 8;
+const V1_1_GFX_ACTIVITY: usize = 16;
+const V1_1_SOCKET_POWER: usize = 22;
+const V1_FAN_SPEED: usize = 72;
+// v1.4 and v1.5 (MI300) have no edge temp and no fan
+const V1_4_TEMP_HOTSPOT: usize = 4;
+const V1_4_TEMP_MEM: usize = 6;
+const V1_4_SOCKET_POWER: usize = 10;
+const V1_4_GFX_ACTIVITY: usize = 12;
+
+// APU gpu_metrics_v2_x field offsets
+const V2_0_TEMP_GFX: usize = 16;
+const V2_0_GFX_ACTIVITY: usize = 40;
+const V2_0_SOCKET_POWER: usize = 44;
+const V2_1_TEMP_GFX: usize = 4;
+const V2_1_GFX_ACTIVITY: usize = 28;
+const V2_1_SOCKET_POWER: usize = 40;
+
+/// The values we use from the amdgpu gpu_metrics table.
+/// Temperatures are in degrees Celsius and power is in Watts.
+#[derive(Debug, Clone, PartialEq)]
+pub struct GpuMetrics {
+    pub format_revision: u8,
+    pub content_revision: u8,
+    pub temp_edge: Option<f64>,
+    pub temp_hotspot: Option<f64>,
+    pub temp_mem: Option<f64>,
+    pub gfx_activity: Option<f64>,
+    pub socket_power: Option<f64>,
+    pub fan_rpm: Option<u32>,
+}
+
+/// Returns the gpu_metrics path for the given amdgpu hwmon base path
+pub fn gpu_metrics_path(base_path: &Path) -> PathBuf {
+    base_path.join("device").join(GPU_METRICS_FILE_NAME)
+}
+
+/// Reads and parses the gpu_metrics file.
+/// A single read of this file replaces separate reads for temps, load and fan speed.
+pub async fn read_gpu_metrics(metrics_path: &Path) -> Result<GpuMetrics> {
+    let blob = tokio::fs::read(metrics_path).await
+        .with_context(|| format!("Reading AMD gpu_metrics from {:?}", metrics_path))?;
+    parse_gpu_metrics(&blob)
+}
+
+/// Parses the versioned binary gpu_metrics struct from the amdgpu driver.
+/// Supported are the dGPU v1.0-v1.5 and APU v2.0-v2.4 formats.
+/// Other versions are an error, so that hwmon is used instead of reading fields at the wrong offsets.
+pub fn parse_gpu_metrics(blob: &[u8]) -> Result<GpuMetrics> {
+    if blob.len() < METRICS_HEADER_SIZE {
+        return Err(anyhow!("gpu_metrics blob is too small: {} bytes", blob.len()));
+    }
+    let structure_size = u16::from_le_bytes([blob[0], blob[1]]) as usize;
+    let format_revision = blob[2];
+    let content_revision = blob[3];
+    // only trust data that the driver says is part of the structure
+    let blob = &blob[..structure_size.min(blob.len())];
+    match format_revision {
+        1 => parse_v1(blob, content_revision),
+        2 => parse_v2(blob, content_revision),
+        _ => Err(unsupported_version(format_revision, content_revision))
+    }
+}
+
+fn unsupported_version(format_revision: u8, content_revision: u8) -> anyhow::Error {
+    anyhow!("Unsupported gpu_metrics version: v{}.{}", format_revision, content_revision)
+}
+
+fn parse_v1(blob: &[u8], content_revision: u8) -> Result<GpuMetrics> {
+    let (temp_edge, temp_hotspot, temp_mem, gfx_activity, socket_power, fan_speed) =
+        match content_revision {
+            0 => (
+                Some(V1_0_TEMP_EDGE), V1_0_TEMP_HOTSPOT, V1_0_TEMP_MEM,
+                V1_0_GFX_ACTIVITY, V1_0_SOCKET_POWER, Some(V1_FAN_SPEED)
+            ),
+            1..=3 => (
+                Some(V1_1_TEMP_EDGE), V1_1_TEMP_HOTSPOT, V1_1_TEMP_MEM,
+                V1_1_GFX_ACTIVITY, V1_1_SOCKET_POWER, Some(V1_FAN_SPEED)
+            ),
+            4 | 5 => (
+                None, V1_4_TEMP_HOTSPOT, V1_4_TEMP_MEM,
+                V1_4_GFX_ACTIVITY, V1_4_SOCKET_POWER, None
+            ),
+            _ => return Err(unsupported_version(1, content_revision)),
+        };
+    Ok(GpuMetrics {
+        format_revision: 1,
+        content_revision,
+        temp_edge: temp_edge.and_then(|offset| read_u16(blob, offset)).map(|temp| temp as f64),
+        temp_hotspot: read_u16(blob, temp_hotspot).map(|temp| temp as f64),
+        temp_mem: read_u16(blob, temp_mem).map(|temp| temp as f64),
+        gfx_activity: read_u16(blob, gfx_activity).map(|activity| activity.min(100) as f64),
+        socket_power: read_u16(blob, socket_power).map(|watts| watts as f64),
+        fan_rpm: fan_speed.and_then(|offset| read_u16(blob, offset)).map(|rpm| rpm as u32),
+    })
+}
+
+fn parse_v2(blob: &[u8], content_revision: u8) -> Result<GpuMetrics> {
+    let (temp_gfx, gfx_activity, socket_power) = match content_revision {
+        0 => (V2_0_TEMP_GFX, V2_0_GFX_ACTIVITY, V2_0_SOCKET_POWER),
+        1..=4 => (V2_1_TEMP_GFX, V2_1_GFX_ACTIVITY, V2_1_SOCKET_POWER),
+        _ => return Err(unsupported_version(2, content_revision)),
+    };
+    Ok(GpuMetrics {
+        format_revision: 2,
+        content_revision,
+        // APU temps are in centi-degrees and power in milliwatts
+        temp_edge: read_u16(blob, temp_gfx).map(|temp| temp as f64 / 100.),
+        temp_hotspot: None,
+        temp_mem: None,
+        gfx_activity: read_u16(blob, gfx_activity).map(|activity| activity.min(100) as f64),
+        socket_power: read_u16(blob, socket_power).map(|milli_watts| milli_watts as f64 / 1000.),
+        fan_rpm: None,
+    })
+}
+
+fn read_u16(blob: &[u8], offset: usize) -> Option<u16> {
+    blob.get(offset..offset + 2)
+        .map(|bytes| u16::from_le_bytes([bytes[0], bytes[1]]))
+        .filter(|value| *value != UNSUPPORTED_VALUE_U16)
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Start of a sample gpu_metrics v1.3 blob with idle values typical of a Navi21 dGPU
+    const NAVI21_V1_3_BLOB: [u8; 80] = [
+        0x78, 0x00, 0x01, 0x03, // header: size 120, v1.3
+        0x2A, 0x00, 0x2E, 0x00, 0x2C, 0x00, 0x29, 0x00, 0x27, 0x00, 0x2B, 0x00, // temps
+        0x03, 0x00, 0x00, 0x00, 0x00, 0x00, // gfx, umc, mm activity
+        0x0B, 0x00, // socket power
+        0x10, 0x32, 0x54, 0x76, 0x00, 0x00, 0x00, 0x00, // energy accumulator
+        0x00, 0xE1, 0xF5, 0x05, 0x00, 0x00, 0x00, 0x00, // system clock counter
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // avg clocks
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // current clocks
+        0x00, 0x00, 0x00, 0x00, // throttle status
+        0x00, 0x00, // fan speed (fan stopped at idle)
+        0x10, 0x00, 0x80, 0x00, // pcie link width & speed
+        0x00, 0x00, // padding
+    ];
+
+    /// Start of a sample gpu_metrics v2.1 blob with values typical of a Cezanne APU
+    const CEZANNE_V2_1_BLOB: [u8; 48] = [
+        0x30, 0x00, 0x02, 0x01, // header: size 48, v2.1
+        0x1C, 0x11, 0x88, 0x13, // temp gfx (43.8C), temp soc (50C)
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // core temps 0-3
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // core temps 4-7
+        0xFF, 0xFF, 0xFF, 0xFF, // l3 temps (unsupported)
+        0x0C, 0x00, 0x00, 0x00, // gfx & mm activity
+        0x00, 0xE1, 0xF5, 0x05, 0x00, 0x00, 0x00, 0x00, // system clock counter
+        0xC4, 0x3B, // socket power (15300mW)
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // cpu, soc & gfx power
+    ];
+
+    #[test]
+    fn parse_v1_3() {
+        // when:
+        let metrics = parse_gpu_metrics(&NAVI21_V1_3_BLOB).unwrap();
+
+        // then:
+        assert_eq!(metrics.format_revision, 1);
+        assert_eq!(metrics.content_revision, 3);
+        assert_eq!(metrics.temp_edge, Some(42.));
+        assert_eq!(metrics.temp_hotspot, Some(46.));
+        assert_eq!(metrics.temp_mem, Some(44.));
+        assert_eq!(metrics.gfx_activity, Some(3.));
+        assert_eq!(metrics.socket_power, Some(11.));
+        assert_eq!(metrics.fan_rpm, Some(0));
+    }
+
+    #[test]
+    fn parse_v2_1() {
+        // when:
+        let metrics = parse_gpu_metrics(&CEZANNE_V2_1_BLOB).unwrap();
+
+        // then:
+        assert_eq!(metrics.format_revision, 2);
+        assert_eq!(metrics.temp_edge, Some(43.8));
+        assert_eq!(metrics.temp_hotspot, None);
+        assert_eq!(metrics.temp_mem, None);
+        assert_eq!(metrics.gfx_activity, Some(12.));
+        assert_eq!(metrics.socket_power, Some(15.3));
+        assert_eq!(metrics.fan_rpm, None);
+    }
+
+    #[test]
+    fn unsupported_values_are_none() {
+        // given:
+        let mut blob = NAVI21_V1_3_BLOB;
+        blob[8] = 0xFF;
+        blob[9] = 0xFF;
+
+        // when:
+        let metrics = parse_gpu_metrics(&blob).unwrap();
+
+        // then:
+        assert_eq!(metrics.temp_mem, None);
+        assert_eq!(metrics.temp_edge, Some(42.));
+    }
+
+    #[test]
+    fn truncated_structure_size() {
+        // given:
+        let mut blob = NAVI21_V1_3_BLOB;
+        blob[0] = 0x10; // driver says the structure is only 16 bytes
+
+        // when:
+        let metrics = parse_gpu_metrics(&blob).unwrap();
+
+        // then:
+        assert_eq!(metrics.temp_edge, Some(42.));
+        assert_eq!(metrics.gfx_activity, None);
+        assert_eq!(metrics.fan_rpm, None);
+    }
+
+    #[test]
+    fn parse_v1_4_without_edge_temp() {
+        // given:
+        let blob = [
+            0x18, 0x00, 0x01, 0x04, // header: size 24, v1.4
+            0x35, 0x00, 0x30, 0x00, 0x2D, 0x00, // hotspot, mem & vrsoc temps
+            0x8C, 0x00, // current socket power
+            0x05, 0x00, 0x01, 0x00, // gfx & umc activity
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // vcn activity
+        ];
+
+        // when:
+        let metrics = parse_gpu_metrics(&blob).unwrap();
+
+        // then:
+        assert_eq!(metrics.temp_edge, None);
+        assert_eq!(metrics.temp_hotspot, Some(53.));
+        assert_eq!(metrics.temp_mem, Some(48.));
+        assert_eq!(metrics.gfx_activity, Some(5.));
+        assert_eq!(metrics.socket_power, Some(140.));
+        assert_eq!(metrics.fan_rpm, None);
+    }
+
+    #[test]
+    fn unknown_content_revision_is_an_error() {
+        // given:
+        let mut blob = NAVI21_V1_3_BLOB;
+        blob[3] = 0x09;
+
+        // when:
+        let result = parse_gpu_metrics(&blob);
+
+        // then:
+        assert!(result.is_err());
+    }
+
+    #[test]
+    fn unknown_version_is_an_error() {
+        // given:
+        let blob = [0x04, 0x00, 0x03, 0x00];
+
+        // when:
+        let result = parse_gpu_metrics(&blob);
+
+        // then:
+        assert!(result.is_err());
+    }
+
+    #[test]
+    fn too_small_is_an_error() {
+        assert!(parse_gpu_metrics(&[0x04, 0x00]).is_err());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::path::{Path, PathBuf};
+use std::time::Duration;
+
+use anyhow::{anyhow, Context, Result};
+use log::{debug, info};
+use tokio::sync::RwLock;
+use tokio::time::Instant;
+
+const POWERCAP_PATH: &str = "/sys/class/powercap";
+const RAPL_ZONE_PREFIX: &str = "intel-rapl:";
+const RAPL_PACKAGE_NAME_PREFIX: &str = "package-";
+const ENERGY_FILE_NAME: &str = "energy_uj";
+const MAX_ENERGY_RANGE_FILE_NAME: &str = "max_energy_range_uj";
+/// The long term (PL1) power limit of the package
+const POWER_LIMIT_FILE_NAME: &str = "constraint_0_power_limit_uw";
+
+struct EnergySample {
+    energies_uj: Vec<u64>,
+    timestamp: Instant,
+}
+
+struct RaplPackageZone {
+    path: PathBuf,
+    max_energy_range_uj: u64,
+    power_limit_uw: u64,
+}
+
+/// Reads CPU package power from the RAPL energy counters exposed through powercap.
+/// The counters are cumulative, so power is calculated from the difference between two reads.
+/// Both Intel and AMD (Zen) packages are exposed through the intel-rapl powercap driver.
+pub struct RaplPowerReader {
+    zones: Vec<RaplPackageZone>,
+    last_sample: RwLock<EnergySample>,
+}
+
+impl RaplPowerReader {
+    /// Returns a reader if RAPL package zones are present and readable, otherwise None.
+    pub async fn detect() -> Option<Self> {
+        match Self::new(Path::new(POWERCAP_PATH)).await {
+            Ok(reader) => {
+                info!("RAPL CPU package power zones found: {}", reader.zones.len());
+                Some(reader)
+            }
+            Err(err) => {
+                debug!("RAPL CPU package power not available: {}", err);
+                None
+            }
+        }
+    }
+
+    async fn new(powercap_path: &Path) -> Result<Self> {
+        let zones = find_package_zones(powercap_path).await?;
+        let last_sample = read_energy_sample(&zones).await?;
+        Ok(Self {
+            zones,
+            last_sample: RwLock::new(last_sample),
+        })
+    }
+
+    /// Returns the current package power as a percentage of the package power limit.
+    /// This keeps the value on the same 0-100 scale as load channels.
+    pub async fn power_percent(&self) -> Result<f64> {
+        let sample = read_energy_sample(&self.zones).await?;
+        let mut last_sample = self.last_sample.write().await;
+        let elapsed = sample.timestamp.duration_since(last_sample.timestamp);
+        let energy_used_uj = self.zones.iter().enumerate()
+            .map(|(index, zone)| energy_delta_uj(
+                last_sample.energies_uj[index],
+                sample.energies_uj[index],
+                zone.max_energy_range_uj,
+            ))
+            .sum::<u64>();
+        let power_limit_uw = self.zones.iter().map(|zone| zone.power_limit_uw).sum::<u64>();
+        *last_sample = sample;
+        Ok(power_percent(energy_used_uj, elapsed, power_limit_uw))
+    }
+}
+
+async fn find_package_zones(powercap_path: &Path) -> Result<Vec<RaplPackageZone>> {
+    let mut zones = vec![];
+    let mut dir_entries = tokio::fs::read_dir(powercap_path).await
+        .with_context(|| format!("Reading powercap directory: {:?}", powercap_path))?;
+    while let Some(entry) = dir_entries.next_entry().await? {
+        let zone_dir_name = entry.file_name().to_string_lossy().to_string();
+        // sub-zones, like the cores, have an additional index: intel-rapl:0:0
+        if !zone_dir_name.starts_with(RAPL_ZONE_PREFIX)
+            || zone_dir_name.matches(':').count() != 1 {
+            continue;
+        }
+        let path = entry.path();
+        let zone_name = tokio::fs::read_to_string(path.join("name")).await
+            .unwrap_or_default();
+        if !zone_name.trim().starts_with(RAPL_PACKAGE_NAME_PREFIX) {
+            continue;
+        }
+        let max_energy_range_uj = read_u64(&path.join(MAX_ENERGY_RANGE_FILE_NAME)).await?;
+        let power_limit_uw = read_u64(&path.join(POWER_LIMIT_FILE_NAME)).await?;
+        zones.push(RaplPackageZone { path, max_energy_range_uj, power_limit_uw })
+    }
+    if zones.is_empty() {
+        return Err(anyhow!("No RAPL package zones found in {:?}", powercap_path));
+    }
+    zones.sort_by(|zone_a, zone_b| zone_a.path.cmp(&zone_b.path));
+    Ok(zones)
+}
+
+async fn read_energy_sample(zones: &[RaplPackageZone]) -> Result<EnergySample> {
+    let mut energies_uj = Vec::with_capacity(zones.len());
+    for zone in zones {
+        energies_uj.push(read_u64(&zone.path.join(ENERGY_FILE_NAME)).await?);
+    }
+    Ok(EnergySample { energies_uj, timestamp: Instant::now() })
+}
+
+async fn read_u64(path: &Path) -> Result<u64> {
+    tokio::fs::read_to_string(path).await
+        .with_context(|| format!("Reading RAPL file: {:?}", path))?
+        .trim().parse::<u64>()
+        .with_context(|| format!("Parsing RAPL file: {:?}", path))
+}
+
+/// The energy counter wraps around to 0 after reaching max_energy_range_uj
+fn energy_delta_uj(previous_uj: u64, current_uj: u64, max_energy_range_uj: u64) -> u64 {
+    if current_uj >= previous_uj {
+        current_uj - previous_uj
+    } else {
+        max_energy_range_uj.saturating_sub(previous_uj) + current_uj
+    }
+}
+
+fn power_percent(energy_used_uj: u64, elapsed: Duration, power_limit_uw: u64) -> f64 {
+    if elapsed.is_zero() || power_limit_uw == 0 {
+        return 0.;
+    }
+    let power_uw = energy_used_uj as f64 / elapsed.as_secs_f64();
+    (power_uw / power_limit_uw as f64 * 100.).clamp(0., 100.)
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use test_context::{AsyncTestContext, test_context};
+    use uuid::Uuid;
+
+    use super::*;
+
+    const TEST_BASE_PATH_STR: &str = "/tmp/coolercontrol-tests-";
+
+    struct PowercapFileContext {
+        test_base_path: PathBuf,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncTestContext for PowercapFileContext {
+        async fn setup() -> PowercapFileContext {
+            let test_base_path = Path::new(
+                &(TEST_BASE_PATH_STR.to_string() + &Uuid::new_v4().to_string())
+            ).to_path_buf();
+            tokio::fs::create_dir_all(&test_base_path).await.unwrap();
+            PowercapFileContext { test_base_path }
+        }
+
+        async fn teardown(self) {
+            tokio::fs::remove_dir_all(&self.test_base_path).await.unwrap();
+        }
+    }
+
+    async fn write_zone(base_path: &Path, zone_dir: &str, name: &str, energy_uj: u64) {
+        let zone_path = base_path.join(zone_dir);
+        tokio::fs::create_dir_all(&zone_path).await.unwrap();
+        tokio::fs::write(zone_path.join("name"), name).await.unwrap();
+        tokio::fs::write(zone_path.join(ENERGY_FILE_NAME), energy_uj.to_string()).await.unwrap();
+        tokio::fs::write(zone_path.join(MAX_ENERGY_RANGE_FILE_NAME), b"262143328850")
+            .await.unwrap();
+        tokio::fs::write(zone_path.join(POWER_LIMIT_FILE_NAME), b"65000000").await.unwrap();
+    }
+
+    #[test_context(PowercapFileContext)]
+    #[tokio::test]
+    async fn find_only_package_zones(ctx: &mut PowercapFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_zone(test_base_path, "intel-rapl:0", "package-0\n", 1000).await;
+        write_zone(test_base_path, "intel-rapl:0:0", "core\n", 500).await;
+        write_zone(test_base_path, "intel-rapl:1", "psys\n", 2000).await;
+
+        // when:
+        let zones = find_package_zones(test_base_path).await.unwrap();
+
+        // then:
+        assert_eq!(zones.len(), 1);
+        assert_eq!(zones[0].path, test_base_path.join("intel-rapl:0"));
+        assert_eq!(zones[0].power_limit_uw, 65_000_000);
+    }
+
+    #[test_context(PowercapFileContext)]
+    #[tokio::test]
+    async fn no_package_zones(ctx: &mut PowercapFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_zone(test_base_path, "intel-rapl:0:0", "core\n", 500).await;
+
+        // when:
+        let result = RaplPowerReader::new(test_base_path).await;
+
+        // then:
+        assert!(result.is_err());
+    }
+
+    #[test]
+    fn energy_delta_with_counter_wraparound() {
+        assert_eq!(energy_delta_uj(1_000, 3_500, 10_000), 2_500);
+        assert_eq!(energy_delta_uj(9_000, 500, 10_000), 1_500);
+    }
+
+    #[test]
+    fn power_as_percent_of_limit() {
+        // 32.5 Joules in 1 second at a 65 Watt limit
+        assert_eq!(power_percent(32_500_000, Duration::from_secs(1), 65_000_000), 50.);
+        // above the limit, for ex. during short boosts
+        assert_eq!(power_percent(130_000_000, Duration::from_secs(1), 65_000_000), 100.);
+        assert_eq!(power_percent(1_000, Duration::ZERO, 65_000_000), 0.);
+    }
+}
\ No newline at end of file
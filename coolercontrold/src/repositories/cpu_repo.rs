@@ -28,11 +28,13 @@ use tokio::sync::RwLock;
 use tokio::time::Instant;
 
 use crate::device::{ChannelStatus, Device, DeviceInfo, DeviceType, Status, TempStatus, UID};
+use crate::repositories::cpu_power::RaplPowerReader;
 use crate::repositories::repository::{DeviceList, Repository};
 use crate::setting::Setting;
 
 const CPU_TEMP_NAME: &str = "CPU Temp";
 const CPU_LOAD_NAME: &str = "CPU Load";
+const CPU_POWER_NAME: &str = "CPU Power";
 pub const PSUTIL_CPU_SENSOR_NAMES: [&'static str; 4] =
     ["thinkpad", "k10temp", "coretemp", "zenpower"];
 const PSUTIL_CPU_SENSOR_LABELS: [&'static str; 6] =
@@ -44,6 +46,7 @@ pub struct CpuRepo {
     cpu_collector: RwLock<CpuPercentCollector>,
     current_sensor_name: RwLock<Option<String>>,
     current_label_name: RwLock<Option<String>>,
+    rapl_power: Option<RaplPowerReader>,
 }
 
 impl CpuRepo {
@@ -53,6 +56,7 @@ impl CpuRepo {
             cpu_collector: RwLock::new(CpuPercentCollector::new()?),
             current_sensor_name: RwLock::new(None),
             current_label_name: RwLock::new(None),
+            rapl_power: RaplPowerReader::detect().await,
         })
     }
 
@@ -69,7 +73,28 @@ impl CpuRepo {
             debug!("Detected temperature sensors: {:?}", temp_sensors);
         }
         // todo: request_status_known(temp_sensors) if current_* is set -> for small speedup
-        self.request_status_new(temp_sensors).await
+        let mut status = self.request_status_new(temp_sensors).await?;
+        if let Some(power_status) = self.request_power_status().await {
+            status.channels.push(power_status);
+        }
+        Ok(status)
+    }
+
+    /// The package power is given as a percentage of the package power limit, like load.
+    async fn request_power_status(&self) -> Option<ChannelStatus> {
+        let rapl_power = self.rapl_power.as_ref()?;
+        match rapl_power.power_percent().await {
+            Ok(power_percent) => Some(ChannelStatus {
+                name: CPU_POWER_NAME.to_string(),
+                rpm: None,
+                duty: Some((power_percent * 100.).round() / 100.),
+                pwm_mode: None,
+            }),
+            Err(err) => {
+                error!("Error reading RAPL CPU package power: {}", err);
+                None
+            }
+        }
     }
 
     /// This is used to find the correct sensors and labels for cpu data.
@@ -16,7 +16,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  ******************************************************************************/
 
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::path::PathBuf;
 use std::sync::Arc;
 
@@ -30,12 +30,17 @@ use tokio::sync::RwLock;
 use tokio::time::Instant;
 
 use crate::device::{ChannelInfo, ChannelStatus, Device, DeviceInfo, DeviceType, SpeedOptions, Status, TempStatus, UID};
+use crate::repositories::amd_gpu_metrics;
+use crate::repositories::amd_gpu_metrics::GpuMetrics;
 use crate::repositories::hwmon::{devices, fans, temps};
 use crate::repositories::hwmon::hwmon_repo::{HwmonChannelInfo, HwmonChannelType, HwmonDriverInfo};
+use crate::repositories::nvidia_settings::{NvidiaSettingsBatcher, NvidiaWrite};
 use crate::repositories::repository::{DeviceList, DeviceLock, Repository};
 use crate::setting::Setting;
 
 const GPU_TEMP_NAME: &str = "GPU Temp";
+const GPU_HOTSPOT_TEMP_NAME: &str = "GPU Hotspot Temp";
+const GPU_MEM_TEMP_NAME: &str = "GPU Memory Temp";
 const GPU_LOAD_NAME: &str = "GPU Load";
 const NVIDIA_FAN_NAME: &str = "fan1";  // synonymous with amd hwmon fan names
 // todo: use as default for AMD GPU name just in case.
@@ -53,8 +58,11 @@ pub struct GpuRepo {
     devices: HashMap<UID, DeviceLock>,
     nvidia_devices: HashMap<u8, DeviceLock>,
     amd_device_infos: HashMap<UID, HwmonDriverInfo>,
+    /// AMD hwmon base paths whose driver exposes a readable gpu_metrics table
+    amd_metrics_supported: HashSet<PathBuf>,
     gpu_type_count: RwLock<HashMap<GpuType, u8>>,
     has_multiple_gpus: RwLock<bool>,
+    nvidia_settings: NvidiaSettingsBatcher,
 }
 
 impl GpuRepo {
@@ -63,8 +71,10 @@ impl GpuRepo {
             devices: HashMap::new(),
             nvidia_devices: HashMap::new(),
             amd_device_infos: HashMap::new(),
+            amd_metrics_supported: HashSet::new(),
             gpu_type_count: RwLock::new(HashMap::new()),
             has_multiple_gpus: RwLock::new(false),
+            nvidia_settings: NvidiaSettingsBatcher::new(),
         })
     }
 
@@ -196,44 +206,22 @@ impl GpuRepo {
         vec![]
     }
 
-    /// Sets the nvidia fan duty
-    async fn set_nvidia_duty(gpu_index: u8, fixed_speed: u8) -> Result<()> {
-        let command = format!(
-            "nvidia-settings -a \"[gpu:{0}]/GPUFanControlState=1\" -a \"[fan:{0}]/GPUTargetFanSpeed={1}\"",
-            gpu_index, fixed_speed
-        );
-        Self::send_command_to_nvidia_settings(&command).await
-    }
-
-    /// resets the nvidia fan control back to automatic
-    async fn reset_nvidia_to_default(gpu_index: u8) -> Result<()> {
-        let command = format!(
-            "nvidia-settings -a \"[gpu:{}]/GPUFanControlState=0\" ", gpu_index
-        );
-        Self::send_command_to_nvidia_settings(&command).await
-    }
-
-    async fn send_command_to_nvidia_settings(command: &str) -> Result<()> {
-        let output = Command::new("sh")
-            .arg("-c")
-            .arg(command)
-            .output().await;
-        return match output {
-            Ok(out) => if out.status.success() {
-                let out_std = String::from_utf8(out.stdout).unwrap().trim().to_owned();
-                let out_err = String::from_utf8(out.stderr).unwrap().trim().to_owned();
-                debug!("Nvidia-settings output: {}\n{}", out_std, out_err);
-                if out_err.is_empty() {
-                    Ok(())
-                } else {
-                    Err(anyhow!("Error trying to set nvidia fan speed settings: {}", out_err))
-                }
-            } else {
-                let out_err = String::from_utf8(out.stderr).unwrap().trim().to_owned();
-                Err(anyhow!("Error communicating with nvidia-settings: {}", out_err))
-            },
-            Err(err) => Err(anyhow!("Nvidia-settings not found: {}", err))
-        };
+    /// Maps a setting for an Nvidia device to its nvidia-settings change
+    async fn nvidia_write_for(&self, device_uid: &UID, setting: &Setting) -> Result<NvidiaWrite> {
+        let device_lock = self.devices.get(device_uid)
+            .with_context(|| format!("Device UID not found! {}", device_uid))?;
+        let gpu_index = device_lock.read().await.type_index - 1;
+        if let Some(true) = setting.reset_to_default {
+            return Ok(NvidiaWrite::Reset { gpu_index });
+        }
+        if let Some(fixed_speed) = setting.speed_fixed {
+            if fixed_speed > 100 {
+                return Err(anyhow!("Invalid fixed_speed: {}", fixed_speed));
+            }
+            Ok(NvidiaWrite::Duty { gpu_index, fan_index: gpu_index, duty: fixed_speed })
+        } else {
+            Err(anyhow!("Only fixed speeds are supported for GPU devices"))
+        }
     }
 
     async fn init_amd_devices() -> Vec<HwmonDriverInfo> {
@@ -299,23 +287,97 @@ impl GpuRepo {
         }
     }
 
+    /// Checks if the driver's gpu_metrics table is present and in a format we can parse.
+    async fn amd_metrics_are_supported(base_path: &PathBuf) -> bool {
+        let metrics_path = amd_gpu_metrics::gpu_metrics_path(base_path);
+        match amd_gpu_metrics::read_gpu_metrics(&metrics_path).await {
+            Ok(metrics) => {
+                info!(
+                    "Using AMD gpu_metrics v{}.{} for status: {:?}",
+                    metrics.format_revision, metrics.content_revision, metrics_path
+                );
+                true
+            }
+            Err(err) => {
+                debug!("AMD gpu_metrics not usable, falling back to hwmon sysfs reads: {}", err);
+                false
+            }
+        }
+    }
+
     async fn get_amd_status(&self, amd_driver: &HwmonDriverInfo, id: &u8) -> Status {
-        let mut status_channels = fans::extract_fan_statuses(amd_driver).await;
-        status_channels.extend(Self::extract_load_status(amd_driver).await);
-        let gpu_external_temp_name = if *self.has_multiple_gpus.read().await {
+        let has_multiple_gpus: bool = self.has_multiple_gpus.read().await.clone();
+        let gpu_external_temp_name = if has_multiple_gpus {
             format!("GPU#{} TEMP", id)
         } else {
             GPU_TEMP_NAME.to_string()
         };
-        let temps = temps::extract_temp_statuses(&id, amd_driver).await
-            .iter().map(|temp| {
-            TempStatus {
+        if self.amd_metrics_supported.contains(&amd_driver.path) {
+            match amd_gpu_metrics::read_gpu_metrics(
+                &amd_gpu_metrics::gpu_metrics_path(&amd_driver.path)
+            ).await {
+                Ok(metrics) => return Self::get_amd_status_from_metrics(
+                    amd_driver, id, metrics, gpu_external_temp_name, has_multiple_gpus,
+                ).await,
+                Err(err) => warn!("Error reading AMD gpu_metrics, using hwmon values: {}", err)
+            }
+        }
+        let mut status_channels = fans::extract_fan_statuses(amd_driver).await;
+        status_channels.extend(Self::extract_load_status(amd_driver).await);
+        let temps = Self::extract_temp_status(amd_driver, id, &gpu_external_temp_name).await;
+        Status {
+            channels: status_channels,
+            temps,
+            ..Default::default()
+        }
+    }
+
+    /// Fills the temps and load from a single gpu_metrics read.
+    /// Fan duty is only available from hwmon and is read as usual.
+    async fn get_amd_status_from_metrics(
+        amd_driver: &HwmonDriverInfo, id: &u8, metrics: GpuMetrics, gpu_external_temp_name: String,
+        has_multiple_gpus: bool,
+    ) -> Status {
+        let mut status_channels = fans::extract_fan_statuses(amd_driver).await;
+        if let Some(load) = metrics.gfx_activity {
+            status_channels.push(ChannelStatus {
+                name: GPU_LOAD_NAME.to_string(),
+                rpm: None,
+                duty: Some(load),
+                pwm_mode: None,
+            })
+        } else {
+            status_channels.extend(Self::extract_load_status(amd_driver).await);
+        }
+        let mut temps = vec![];
+        if let Some(temp) = metrics.temp_edge {
+            temps.push(TempStatus {
                 name: GPU_TEMP_NAME.to_string(),
-                temp: temp.temp,
+                temp,
                 frontend_name: GPU_TEMP_NAME.to_string(),
-                external_name: gpu_external_temp_name.clone(),
+                external_name: gpu_external_temp_name,
+            })
+        } else {  // some table versions have no edge temp
+            temps.extend(Self::extract_temp_status(amd_driver, id, &gpu_external_temp_name).await);
+        }
+        for (name, temp) in [
+            (GPU_HOTSPOT_TEMP_NAME, metrics.temp_hotspot),
+            (GPU_MEM_TEMP_NAME, metrics.temp_mem),
+        ] {
+            if let Some(temp) = temp {
+                let external_name = if has_multiple_gpus {
+                    format!("GPU#{} {}", id, name)
+                } else {
+                    name.to_string()
+                };
+                temps.push(TempStatus {
+                    name: name.to_string(),
+                    temp,
+                    frontend_name: name.to_string(),
+                    external_name,
+                })
             }
-        }).collect();
+        }
         Status {
             channels: status_channels,
             temps,
@@ -323,6 +385,20 @@ impl GpuRepo {
         }
     }
 
+    async fn extract_temp_status(
+        amd_driver: &HwmonDriverInfo, id: &u8, gpu_external_temp_name: &String,
+    ) -> Vec<TempStatus> {
+        temps::extract_temp_statuses(&id, amd_driver).await
+            .iter().map(|temp| {
+            TempStatus {
+                name: GPU_TEMP_NAME.to_string(),
+                temp: temp.temp,
+                frontend_name: GPU_TEMP_NAME.to_string(),
+                external_name: gpu_external_temp_name.clone(),
+            }
+        }).collect()
+    }
+
     async fn extract_load_status(driver: &HwmonDriverInfo) -> Vec<ChannelStatus> {
         let mut channels = vec![];
         for channel in driver.channels.iter() {
@@ -393,6 +469,9 @@ impl Repository for GpuRepo {
                 };
                 channels.insert(channel.name.clone(), channel_info);
             }
+            if Self::amd_metrics_are_supported(&amd_driver.path).await {
+                self.amd_metrics_supported.insert(amd_driver.path.clone());
+            }
             let status = self.get_amd_status(&amd_driver, &id).await;
             let device = Device::new(
                 amd_driver.name.clone(),
@@ -508,6 +587,7 @@ impl Repository for GpuRepo {
     }
 
     async fn shutdown(&self) -> Result<()> {
+        let mut nvidia_resets = vec![];
         for (uid, device_lock) in self.devices.iter() {
             let gpu_index = device_lock.read().await.type_index - 1;
             let is_amd = self.amd_device_infos.contains_key(uid);
@@ -518,39 +598,71 @@ impl Repository for GpuRepo {
                     }
                 }
             } else {
-                Self::reset_nvidia_to_default(gpu_index).await.ok();
+                nvidia_resets.push(NvidiaWrite::Reset { gpu_index });
             };
         }
+        self.nvidia_settings.apply(&nvidia_resets).await.ok();
         info!("GPU Repository shutdown");
         Ok(())
     }
 
     async fn apply_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()> {
-        let device_lock = self.devices.get(device_uid)
-            .with_context(|| format!("Device UID not found! {}", device_uid))?;
-        let gpu_index = device_lock.read().await.type_index - 1;
-        let is_amd = self.amd_device_infos.contains_key(device_uid);
         info!("Applying device: {} settings: {:?}", device_uid, setting);
+        if !self.amd_device_infos.contains_key(device_uid) {
+            let nvidia_write = self.nvidia_write_for(device_uid, setting).await?;
+            return self.nvidia_settings.apply(&[nvidia_write]).await;
+        }
         if let Some(true) = setting.reset_to_default {
-            return if is_amd {
-                self.reset_amd_to_default(device_uid, &setting.channel_name).await
-            } else {
-                Self::reset_nvidia_to_default(gpu_index).await
-            };
+            return self.reset_amd_to_default(device_uid, &setting.channel_name).await;
         }
         if let Some(fixed_speed) = setting.speed_fixed {
             if fixed_speed > 100 {
                 return Err(anyhow!("Invalid fixed_speed: {}", fixed_speed));
             }
-            if is_amd {
-                self.set_amd_duty(device_uid, setting, fixed_speed).await
-            } else {
-                Self::set_nvidia_duty(gpu_index, fixed_speed).await
-            }
+            self.set_amd_duty(device_uid, setting, fixed_speed).await
         } else {
             Err(anyhow!("Only fixed speeds are supported for GPU devices"))
         }
     }
+
+    /// AMD settings are applied individually through hwmon, while all Nvidia changes are
+    /// collected and applied with a single nvidia-settings call.
+    async fn apply_settings_batch(&self, settings: &[(UID, Setting)]) -> Vec<Result<()>> {
+        let mut results: Vec<Option<Result<()>>> = settings.iter().map(|_| None).collect();
+        let mut nvidia_writes = vec![];
+        let mut nvidia_positions = vec![];
+        for (position, (device_uid, setting)) in settings.iter().enumerate() {
+            if self.amd_device_infos.contains_key(device_uid) {
+                results[position] = Some(self.apply_setting(device_uid, setting).await);
+                continue;
+            }
+            info!("Applying device: {} settings: {:?}", device_uid, setting);
+            match self.nvidia_write_for(device_uid, setting).await {
+                Ok(nvidia_write) => {
+                    nvidia_writes.push(nvidia_write);
+                    nvidia_positions.push(position);
+                }
+                Err(err) => results[position] = Some(Err(err)),
+            }
+        }
+        if !nvidia_writes.is_empty() {
+            let batch_result = self.nvidia_settings.apply(&nvidia_writes).await;
+            for position in nvidia_positions {
+                results[position] = Some(match &batch_result {
+                    Ok(_) => Ok(()),
+                    Err(err) => Err(anyhow!("{}", err)),
+                });
+            }
+        }
+        results.into_iter()
+            .map(|result| result.unwrap_or_else(|| Err(anyhow!("Setting was not applied"))))
+            .collect()
+    }
+
+    /// Nvidia drivers reset the fan control state when waking from sleep
+    async fn reinitialize_devices(&self) {
+        self.nvidia_settings.forget_control_state().await;
+    }
 }
 
 #[derive(Debug, Clone, Serialize, Deserialize)]
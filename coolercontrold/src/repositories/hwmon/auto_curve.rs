@@ -0,0 +1,396 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::path::PathBuf;
+
+use anyhow::{anyhow, Context, Result};
+use log::{debug, warn};
+
+use crate::repositories::hwmon::fans;
+use crate::utils;
+
+macro_rules! format_auto_point_temp { ($pwm:expr, $point:expr) => {{ format!("pwm{}_auto_point{}_temp", $pwm, $point) }}; }
+macro_rules! format_auto_point_pwm { ($pwm:expr, $point:expr) => {{ format!("pwm{}_auto_point{}_pwm", $pwm, $point) }}; }
+macro_rules! format_pwm_enable { ($($arg:tt)*) => {{ format!("pwm{}_enable", $($arg)*) }}; }
+
+/// Fewer points than this can't represent a curve
+const MIN_AUTO_POINTS: u8 = 2;
+const MAX_AUTO_POINTS: u8 = 16;
+
+/// How the chip is told which temperature drives the curve
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum TempSelect {
+    /// pwmN_temp_sel holds the number of the tempN_input (nct6775)
+    Number,
+    /// pwmN_auto_channels_temp holds a bitmask of the tempN_inputs (it87)
+    Mask,
+}
+
+/// The pwm_enable value that hands the pwm channel over to the chip's own curve.
+/// This differs per driver, so only the drivers we know are used.
+fn auto_pwm_enable_value(device_name: &str) -> Option<u8> {
+    if device_name.starts_with("nct67") || device_name.starts_with("nct61") {
+        Some(5)  // SmartFan IV
+    } else if device_name.starts_with("it8") {
+        Some(2)
+    } else {
+        None
+    }
+}
+
+/// The automatic fan curve of a hwmon pwm channel, which the chip runs itself.
+/// A curve running on the chip needs no periodic writes from us.
+#[derive(Debug, Clone, PartialEq)]
+pub struct AutoCurve {
+    pwm_number: u8,
+    point_count: u8,
+    temp_select: TempSelect,
+    auto_pwm_enable: u8,
+}
+
+/// The values a curve replaced, so that the chip's original curve can be restored.
+pub type OriginalCurveValues = Vec<(String, String)>;
+/// The values of a programmed curve, by file name, to check that the chip still holds them.
+pub type ProgrammedCurveValues = Vec<(String, String)>;
+
+impl AutoCurve {
+    /// Detects whether the pwm channel has auto points that we are able to program.
+    pub async fn detect(base_path: &PathBuf, device_name: &str, pwm_number: u8) -> Option<AutoCurve> {
+        let auto_pwm_enable = auto_pwm_enable_value(device_name)?;
+        let temp_select = if base_path.join(format!("pwm{}_temp_sel", pwm_number)).exists() {
+            TempSelect::Number
+        } else if base_path.join(format!("pwm{}_auto_channels_temp", pwm_number)).exists() {
+            TempSelect::Mask
+        } else {
+            return None;
+        };
+        let mut point_count = 0;
+        while point_count < MAX_AUTO_POINTS
+            && base_path.join(format_auto_point_temp!(pwm_number, point_count + 1)).exists()
+            && base_path.join(format_auto_point_pwm!(pwm_number, point_count + 1)).exists() {
+            point_count += 1;
+        }
+        if point_count < MIN_AUTO_POINTS {
+            return None;
+        }
+        debug!("Hwmon pwm{} at {:?} has an auto curve with {} points", pwm_number, base_path, point_count);
+        Some(AutoCurve { pwm_number, point_count, temp_select, auto_pwm_enable })
+    }
+
+    /// Programs the normalized profile into the chip's auto points, driven by the given tempN_input,
+    /// and hands the pwm channel over to the chip.
+    /// Every value is read back, as drivers silently clamp or ignore some points.
+    /// Returns the programmed values and the values that were replaced.
+    /// On error the replaced values have already been restored.
+    pub async fn program(
+        &self, base_path: &PathBuf, temp_number: u8, normalized_profile: &[(u8, u8)],
+    ) -> Result<(ProgrammedCurveValues, OriginalCurveValues)> {
+        let mut values = vec![self.temp_select_value(temp_number)?];
+        for (index, (temp, duty)) in resample(normalized_profile, self.point_count as usize).into_iter().enumerate() {
+            let point = index + 1;
+            // hwmon temps are in millidegrees:
+            values.push((format_auto_point_temp!(self.pwm_number, point), (temp as i32 * 1000).to_string()));
+            values.push((format_auto_point_pwm!(self.pwm_number, point), fans::duty_to_pwm_value(duty).to_string()));
+        }
+        let mut original_values = Vec::with_capacity(values.len());
+        for (file_name, _) in values.iter() {
+            let original_value = tokio::fs::read_to_string(base_path.join(file_name)).await
+                .with_context(|| format!("Reading original auto curve value from {:?}/{}", base_path, file_name))?;
+            original_values.push((file_name.clone(), original_value.trim().to_string()));
+        }
+        values.push((format_pwm_enable!(self.pwm_number), self.auto_pwm_enable.to_string()));
+        for (file_name, value) in values.iter() {
+            if let Err(err) = write_verified(base_path, file_name, value).await {
+                restore(base_path, &original_values).await;
+                return Err(err);
+            }
+        }
+        Ok((values, original_values))
+    }
+
+    /// Whether the chip is still running the programmed curve.
+    /// Resuming from sleep, for example, can hand the channel back to the BIOS settings,
+    /// or restore the BIOS curve's temp selection and points while leaving the channel in auto mode.
+    /// The programmed values include the pwm_enable value that hands the channel over to the chip.
+    pub async fn is_running(&self, base_path: &PathBuf, programmed_values: &ProgrammedCurveValues) -> bool {
+        for (file_name, value) in programmed_values {
+            let holds_value = tokio::fs::read_to_string(base_path.join(file_name)).await
+                .map(|current_value| current_value.trim() == value)
+                .unwrap_or(false);
+            if !holds_value {
+                return false;
+            }
+        }
+        true
+    }
+
+    fn temp_select_value(&self, temp_number: u8) -> Result<(String, String)> {
+        match self.temp_select {
+            TempSelect::Number =>
+                Ok((format!("pwm{}_temp_sel", self.pwm_number), temp_number.to_string())),
+            TempSelect::Mask if (1..=8).contains(&temp_number) =>
+                Ok((format!("pwm{}_auto_channels_temp", self.pwm_number), (1u8 << (temp_number - 1)).to_string())),
+            TempSelect::Mask =>
+                Err(anyhow!("temp{}_input can not drive the auto curve of pwm{}", temp_number, self.pwm_number)),
+        }
+    }
+}
+
+/// Writes back the values that a curve replaced. Failures are only logged,
+/// as the pwm channel is set to manual or its default afterwards anyway.
+pub async fn restore(base_path: &PathBuf, original_values: &OriginalCurveValues) {
+    for (file_name, value) in original_values {
+        if let Err(err) = tokio::fs::write(base_path.join(file_name), value.as_bytes()).await {
+            warn!("Could not restore original auto curve value {} to {:?}/{}: {}", value, base_path, file_name, err);
+        }
+    }
+}
+
+/// Some points are fixed by the chip, like the full speed critical point,
+/// so a failed write is fine as long as the chip already holds the value.
+async fn write_verified(base_path: &PathBuf, file_name: &str, value: &str) -> Result<()> {
+    let path = base_path.join(file_name);
+    let write_result = tokio::fs::write(&path, value.as_bytes()).await;
+    let current_value = tokio::fs::read_to_string(&path).await
+        .with_context(|| format!("Reading back auto curve value from {:?}", path))?;
+    if current_value.trim() == value {
+        return Ok(());
+    }
+    match write_result {
+        Err(err) => Err(anyhow!("Could not write {} to {:?}: {}", value, path, err)),
+        Ok(_) => Err(anyhow!("The driver did not accept {} for {:?}, it holds: {}", value, path, current_value.trim())),
+    }
+}
+
+/// Fits a normalized profile to the chip's number of points.
+/// Shorter profiles are padded with their last point. Longer profiles drop the inner points
+/// that change the curve the least, so that the bends of the curve are kept.
+pub fn resample(normalized_profile: &[(u8, u8)], point_count: usize) -> Vec<(u8, u8)> {
+    let mut points = normalized_profile.to_vec();
+    while points.len() > point_count.max(2) {
+        let least_significant_index = (1..points.len() - 1)
+            .min_by_key(|index| {
+                let neighbours = [points[index - 1], points[index + 1]];
+                let (temp, duty) = points[*index];
+                (utils::interpolate_profile(&neighbours, temp as f64) as i16 - duty as i16).abs()
+            })
+            .unwrap();
+        points.remove(least_significant_index);
+    }
+    if let Some(last_point) = points.last().copied() {
+        points.resize(point_count, last_point);
+    }
+    points
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::path::Path;
+
+    use test_context::{AsyncTestContext, test_context};
+    use uuid::Uuid;
+
+    use super::*;
+
+    const TEST_BASE_PATH_STR: &str = "/tmp/coolercontrol-tests-";
+
+    struct HwmonFileContext {
+        test_base_path: PathBuf,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncTestContext for HwmonFileContext {
+        async fn setup() -> HwmonFileContext {
+            let test_base_path = Path::new(
+                &(TEST_BASE_PATH_STR.to_string() + &Uuid::new_v4().to_string())
+            ).to_path_buf();
+            tokio::fs::create_dir_all(&test_base_path).await.unwrap();
+            HwmonFileContext { test_base_path }
+        }
+
+        async fn teardown(self) {
+            tokio::fs::remove_dir_all(&self.test_base_path).await.unwrap();
+        }
+    }
+
+    /// A pwm channel like nct6775 has it, with 5 auto points and the BIOS curve on temp 1
+    async fn write_nct6775_pwm(base_path: &PathBuf) {
+        tokio::fs::write(base_path.join("pwm2"), b"102").await.unwrap();
+        tokio::fs::write(base_path.join("pwm2_enable"), b"5").await.unwrap();
+        tokio::fs::write(base_path.join("pwm2_temp_sel"), b"1").await.unwrap();
+        for point in 1..=5 {
+            tokio::fs::write(base_path.join(format_auto_point_temp!(2, point)), format!("{}", point * 15000)).await.unwrap();
+            tokio::fs::write(base_path.join(format_auto_point_pwm!(2, point)), format!("{}", point * 51)).await.unwrap();
+        }
+    }
+
+    async fn read(base_path: &PathBuf, file_name: &str) -> String {
+        tokio::fs::read_to_string(base_path.join(file_name)).await.unwrap().trim().to_string()
+    }
+
+    #[test]
+    fn resample_pads_short_profiles() {
+        // when:
+        let points = resample(&[(20, 30), (60, 80), (100, 100)], 5);
+
+        // then:
+        assert_eq!(points, vec![(20, 30), (60, 80), (100, 100), (100, 100), (100, 100)]);
+    }
+
+    #[test]
+    fn resample_keeps_the_bends_of_long_profiles() {
+        // given:
+        let profile = [(20, 20), (30, 25), (40, 30), (50, 35), (60, 80), (70, 90), (100, 100)];
+
+        // when:
+        let points = resample(&profile, 4);
+
+        // then:
+        assert_eq!(points, vec![(20, 20), (50, 35), (60, 80), (100, 100)]);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn detect_nct6775_points(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_nct6775_pwm(test_base_path).await;
+
+        // when:
+        let curve = AutoCurve::detect(test_base_path, "nct6798", 2).await;
+        let unknown_driver_curve = AutoCurve::detect(test_base_path, "unknown", 2).await;
+        let missing_channel_curve = AutoCurve::detect(test_base_path, "nct6798", 1).await;
+
+        // then:
+        assert_eq!(curve, Some(AutoCurve {
+            pwm_number: 2,
+            point_count: 5,
+            temp_select: TempSelect::Number,
+            auto_pwm_enable: 5,
+        }));
+        assert_eq!(unknown_driver_curve, None);
+        assert_eq!(missing_channel_curve, None);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn program_writes_points_and_hands_over(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_nct6775_pwm(test_base_path).await;
+        tokio::fs::write(test_base_path.join("pwm2_enable"), b"1").await.unwrap();
+        let curve = AutoCurve::detect(test_base_path, "nct6798", 2).await.unwrap();
+
+        // when:
+        let (programmed_values, original_values) = curve.program(
+            test_base_path, 3, &[(30, 20), (50, 40), (70, 100)],
+        ).await.unwrap();
+
+        // then:
+        assert_eq!(read(test_base_path, "pwm2_temp_sel").await, "3");
+        assert_eq!(read(test_base_path, "pwm2_auto_point1_temp").await, "30000");
+        assert_eq!(read(test_base_path, "pwm2_auto_point1_pwm").await, "51");
+        assert_eq!(read(test_base_path, "pwm2_auto_point2_pwm").await, "102");
+        assert_eq!(read(test_base_path, "pwm2_auto_point5_temp").await, "70000");
+        assert_eq!(read(test_base_path, "pwm2_auto_point5_pwm").await, "255");
+        assert_eq!(read(test_base_path, "pwm2_enable").await, "5");
+        assert!(curve.is_running(test_base_path, &programmed_values).await);
+        assert_eq!(original_values[0], ("pwm2_temp_sel".to_string(), "1".to_string()));
+        assert_eq!(original_values.len(), 11);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn is_running_detects_a_reset_channel(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_nct6775_pwm(test_base_path).await;
+        let curve = AutoCurve::detect(test_base_path, "nct6798", 2).await.unwrap();
+        let (programmed_values, _) = curve.program(test_base_path, 1, &[(40, 50), (100, 100)]).await.unwrap();
+
+        // when:
+        tokio::fs::write(test_base_path.join("pwm2_enable"), b"1").await.unwrap();
+
+        // then:
+        assert!(!curve.is_running(test_base_path, &programmed_values).await);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn is_running_detects_a_restored_bios_curve(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_nct6775_pwm(test_base_path).await;
+        let curve = AutoCurve::detect(test_base_path, "nct6798", 2).await.unwrap();
+        let (programmed_values, _) = curve.program(test_base_path, 3, &[(40, 50), (100, 100)]).await.unwrap();
+
+        // when:
+        tokio::fs::write(test_base_path.join("pwm2_temp_sel"), b"1").await.unwrap();
+        let temp_sel_running = curve.is_running(test_base_path, &programmed_values).await;
+        tokio::fs::write(test_base_path.join("pwm2_temp_sel"), b"3").await.unwrap();
+        tokio::fs::write(test_base_path.join("pwm2_auto_point2_pwm"), b"102").await.unwrap();
+        let point_running = curve.is_running(test_base_path, &programmed_values).await;
+
+        // then:
+        assert_eq!(read(test_base_path, "pwm2_enable").await, "5");
+        assert!(!temp_sel_running);
+        assert!(!point_running);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn restore_original_values(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        write_nct6775_pwm(test_base_path).await;
+        let curve = AutoCurve::detect(test_base_path, "nct6798", 2).await.unwrap();
+        let (_, original_values) = curve.program(
+            test_base_path, 3, &[(30, 20), (100, 100)],
+        ).await.unwrap();
+
+        // when:
+        restore(test_base_path, &original_values).await;
+
+        // then:
+        assert_eq!(read(test_base_path, "pwm2_temp_sel").await, "1");
+        assert_eq!(read(test_base_path, "pwm2_auto_point1_temp").await, "15000");
+        assert_eq!(read(test_base_path, "pwm2_auto_point3_pwm").await, "153");
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn it87_selects_temps_by_mask(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        tokio::fs::write(test_base_path.join("pwm1_enable"), b"2").await.unwrap();
+        tokio::fs::write(test_base_path.join("pwm1_auto_channels_temp"), b"1").await.unwrap();
+        for point in 1..=4 {
+            tokio::fs::write(test_base_path.join(format_auto_point_temp!(1, point)), b"0").await.unwrap();
+            tokio::fs::write(test_base_path.join(format_auto_point_pwm!(1, point)), b"0").await.unwrap();
+        }
+        let curve = AutoCurve::detect(test_base_path, "it8688", 1).await.unwrap();
+
+        // when:
+        curve.program(test_base_path, 3, &[(30, 20), (100, 100)]).await.unwrap();
+
+        // then:
+        assert_eq!(read(test_base_path, "pwm1_auto_channels_temp").await, "4");
+        assert_eq!(read(test_base_path, "pwm1_enable").await, "2");
+    }
+}
@@ -159,11 +159,10 @@ pub async fn get_device_serial_number(base_path: &PathBuf) -> Option<String> {
         Err(_) => {
             // usb hid serial numbers are here:
             let device_details = get_device_uevent_details(base_path).await;
-            if let Some(dev_value) = device_details.get("HID_UNIQ") {
-                Some(dev_value.to_string())
-            } else {
-                None
-            }
+            // devices without a serial number have an empty HID_UNIQ
+            device_details.get("HID_UNIQ")
+                .filter(|dev_value| !dev_value.is_empty())
+                .cloned()
         }
     }
 }
@@ -289,12 +289,12 @@ pub async fn set_pwm_duty(base_path: &PathBuf, channel_info: &HwmonChannelInfo,
 }
 
 /// Converts a pwm value (0-255) to a duty value (0-100%)
-fn pwm_value_to_duty(pwm_value: u8) -> f64 {
+pub fn pwm_value_to_duty(pwm_value: u8) -> f64 {
     ((pwm_value as f64 / 0.255).round() / 10.0).round()
 }
 
 /// Converts a duty value (0-100%) to a pwm value (0-255)
-fn duty_to_pwm_value(speed_duty: u8) -> u8 {
+pub fn duty_to_pwm_value(speed_duty: u8) -> u8 {
     let clamped_duty = clamp(speed_duty, 0, 100) as f64;
     // round only takes the first decimal digit into consideration, so we adjust to have it take the first two digits into consideration.
     ((clamped_duty * 25.5).round() / 10.0).round() as u8
@@ -23,7 +23,7 @@ use std::sync::Arc;
 
 use anyhow::{anyhow, Context, Result};
 use async_trait::async_trait;
-use log::{debug, error, info};
+use log::{debug, error, info, warn};
 use serde::{Deserialize, Serialize};
 use strum::{Display, EnumString};
 use tokio::sync::RwLock;
@@ -31,8 +31,10 @@ use tokio::time::Instant;
 
 use crate::device::{ChannelInfo, Device, DeviceInfo, DeviceType, SpeedOptions, Status, UID};
 use crate::repositories::hwmon::{devices, fans, temps};
+use crate::repositories::hwmon::auto_curve::{self, AutoCurve, OriginalCurveValues, ProgrammedCurveValues};
 use crate::repositories::repository::{DeviceList, DeviceLock, Repository};
 use crate::setting::Setting;
+use crate::utils;
 
 #[derive(Debug, Clone, PartialEq, Eq, Hash, Display, EnumString, Serialize, Deserialize)]
 pub enum HwmonChannelType {
@@ -71,15 +73,32 @@ pub struct HwmonDriverInfo {
     pub channels: Vec<HwmonChannelInfo>,
 }
 
+/// A speed profile that the chip runs itself
+struct OffloadedCurve {
+    temp_number: u8,
+    normalized_profile: Vec<(u8, u8)>,
+    programmed_values: ProgrammedCurveValues,
+    original_values: OriginalCurveValues,
+}
+
 /// A Repository for Hwmon Devices
 pub struct HwmonRepo {
     devices: HashMap<UID, (DeviceLock, HwmonDriverInfo)>,
+    /// The auto curves per device, by pwm number
+    auto_curves: HashMap<UID, HashMap<u8, AutoCurve>>,
+    /// The offloaded curves by device and pwm number
+    offloaded_curves: RwLock<HashMap<(UID, u8), OffloadedCurve>>,
+    /// Hwmon paths of kernel drivers that the Liquidctl Repo already uses for its devices
+    claimed_paths: Vec<PathBuf>,
 }
 
 impl HwmonRepo {
-    pub async fn new() -> Result<Self> {
+    pub async fn new(claimed_paths: Vec<PathBuf>) -> Result<Self> {
         Ok(Self {
             devices: HashMap::new(),
+            auto_curves: HashMap::new(),
+            offloaded_curves: RwLock::new(HashMap::new()),
+            claimed_paths,
         })
     }
 
@@ -132,6 +151,55 @@ impl HwmonRepo {
             );
         }
     }
+
+    /// Hands the channel back to us and restores the chip's original curve, if the curve was offloaded.
+    async fn release_offloaded_curve(&self, device_uid: &UID, base_path: &PathBuf, pwm_number: u8) {
+        if let Some(offloaded_curve) = self.offloaded_curves.write().await.remove(&(device_uid.clone(), pwm_number)) {
+            auto_curve::restore(base_path, &offloaded_curve.original_values).await;
+            debug!("Released the offloaded curve of pwm{} at {:?}", pwm_number, base_path);
+        }
+    }
+
+    /// The chip runs offloaded curves without us, but we make sure that it keeps doing so,
+    /// as the channel can be reset, for example when resuming from sleep.
+    async fn monitor_offloaded_curves(&self) {
+        let mut offloaded_curves = self.offloaded_curves.write().await;
+        let mut failed_curves = Vec::new();
+        for ((device_uid, pwm_number), offloaded_curve) in offloaded_curves.iter_mut() {
+            let (driver, curve) = match (
+                self.devices.get(device_uid),
+                self.auto_curves.get(device_uid).and_then(|curves| curves.get(pwm_number)),
+            ) {
+                (Some((_, driver)), Some(curve)) => (driver, curve),
+                _ => continue,
+            };
+            if curve.is_running(&driver.path, &offloaded_curve.programmed_values).await {
+                continue;
+            }
+            warn!("The offloaded curve of pwm{} at {:?} is no longer running, reprogramming it", pwm_number, driver.path);
+            match curve.program(
+                &driver.path, offloaded_curve.temp_number, &offloaded_curve.normalized_profile,
+            ).await {
+                // the chip's original values are kept, not the ones that replaced our curve:
+                Ok((programmed_values, _)) => offloaded_curve.programmed_values = programmed_values,
+                Err(err) => {
+                    error!("Error reprogramming the offloaded curve of pwm{} at {:?}: {}", pwm_number, driver.path, err);
+                    failed_curves.push((device_uid.clone(), *pwm_number));
+                }
+            }
+        }
+        for (device_uid, pwm_number) in failed_curves {
+            let offloaded_curve = offloaded_curves.remove(&(device_uid.clone(), pwm_number)).unwrap();
+            let (_, driver) = self.devices.get(&device_uid).unwrap();
+            auto_curve::restore(&driver.path, &offloaded_curve.original_values).await;
+            if let Some(channel_info) = driver.channels.iter()
+                .find(|channel| channel.hwmon_type == HwmonChannelType::Fan && channel.number == pwm_number) {
+                if let Err(err) = fans::set_pwm_enable_to_default(&driver.path, channel_info).await {
+                    error!("Error resetting pwm{} at {:?}: {}", pwm_number, driver.path, err);
+                }
+            }
+        }
+    }
 }
 
 #[async_trait]
@@ -149,7 +217,11 @@ impl Repository for HwmonRepo {
             return Err(anyhow!("No HWMon devices were found, try running sensors-detect"));
         }
         let mut hwmon_drivers: Vec<HwmonDriverInfo> = vec![];
+        let mut auto_curves_by_path = HashMap::new();
         for path in base_paths {
+            if self.claimed_paths.contains(&path) {
+                continue;
+            }
             let device_name = devices::get_device_name(&path).await;
             if devices::is_already_used_by_other_repo(&device_name) {
                 continue;
@@ -166,6 +238,13 @@ impl Repository for HwmonRepo {
             if channels.is_empty() {  // we only add hwmon drivers that have usable data
                 continue;
             }
+            let mut auto_curves = HashMap::new();
+            for channel in channels.iter().filter(|channel| channel.hwmon_type == HwmonChannelType::Fan) {
+                if let Some(curve) = AutoCurve::detect(&path, &device_name, channel.number).await {
+                    auto_curves.insert(channel.number, curve);
+                }
+            }
+            auto_curves_by_path.insert(path.clone(), auto_curves);
             let model = devices::get_device_model_name(&path).await;
             let u_id = devices::get_device_unique_id(&path).await;
             let hwmon_driver_info = HwmonDriverInfo {
@@ -181,6 +260,11 @@ impl Repository for HwmonRepo {
         // re-sorted by name to help keep some semblance of order after reboots & device changes.
         hwmon_drivers.sort_by(|d1, d2| d1.name.cmp(&d2.name));
         self.map_into_our_device_model(hwmon_drivers).await;
+        for (uid, (_, hwmon_info)) in self.devices.iter() {
+            if let Some(auto_curves) = auto_curves_by_path.remove(&hwmon_info.path) {
+                self.auto_curves.insert(uid.clone(), auto_curves);
+            }
+        }
 
         let mut init_devices = HashMap::new();
         for (uid, (device, hwmon_info)) in self.devices.iter() {
@@ -219,6 +303,7 @@ impl Repository for HwmonRepo {
             debug!("Hwmon device: {} status was updated with: {:?}", device.read().await.name, status);
             device.write().await.set_status(status);
         }
+        self.monitor_offloaded_curves().await;
         debug!(
             "Time taken to update status for all HWMON devices: {:?}",
             start_update.elapsed()
@@ -227,11 +312,12 @@ impl Repository for HwmonRepo {
     }
 
     async fn shutdown(&self) -> Result<()> {
-        for (_, hwmon_driver) in self.devices.values() {
+        for (device_uid, (_, hwmon_driver)) in self.devices.iter() {
             for channel_info in hwmon_driver.channels.iter() {
                 if channel_info.hwmon_type != HwmonChannelType::Fan {
                     continue;
                 }
+                self.release_offloaded_curve(device_uid, &hwmon_driver.path, channel_info.number).await;
                 fans::set_pwm_enable_to_default(&hwmon_driver.path, channel_info).await?
             }
         }
@@ -247,6 +333,7 @@ impl Repository for HwmonRepo {
                 channel.hwmon_type == HwmonChannelType::Fan && channel.name == setting.channel_name
             ).with_context(|| format!("Searching for channel name: {}", setting.channel_name))?;
         info!("Applying device: {} settings: {:?}", device_uid, setting);
+        self.release_offloaded_curve(device_uid, &hwmon_driver.path, channel_info.number).await;
         if let Some(true) = setting.reset_to_default {
             return fans::set_pwm_enable_to_default(
                 &hwmon_driver.path, channel_info,
@@ -262,4 +349,239 @@ impl Repository for HwmonRepo {
             Err(anyhow!("Only fixed speeds are currently supported for Hwmon devices"))
         }
     }
+
+    /// Speed profiles with a temp source on the same chip are offloaded to the chip's auto curve,
+    /// when the chip has one.
+    async fn offload_speed_profile(&self, device_uid: &UID, setting: &Setting) -> Result<bool> {
+        let (profile, temp_source) = match (&setting.speed_profile, &setting.temp_source) {
+            (Some(profile), Some(temp_source)) => (profile, temp_source),
+            _ => return Ok(false),
+        };
+        if &temp_source.device_uid != device_uid
+            || setting.speed_pid.is_some() || setting.speed_feed_forward.is_some() {
+            return Ok(false);
+        }
+        let (device_lock, hwmon_driver) = self.devices.get(device_uid)
+            .with_context(|| format!("Device UID not found! {}", device_uid))?;
+        let channel_info = hwmon_driver.channels.iter()
+            .find(|channel|
+                channel.hwmon_type == HwmonChannelType::Fan && channel.name == setting.channel_name
+            ).with_context(|| format!("Searching for channel name: {}", setting.channel_name))?;
+        let curve = match self.auto_curves.get(device_uid)
+            .and_then(|curves| curves.get(&channel_info.number)) {
+            Some(curve) => curve,
+            None => return Ok(false),
+        };
+        let temp_channel = match hwmon_driver.channels.iter()
+            .find(|channel| channel.hwmon_type == HwmonChannelType::Temp && channel.name == temp_source.temp_name) {
+            Some(temp_channel) => temp_channel,
+            None => return Ok(false),  // the temp source is not on this chip
+        };
+        let max_temp = device_lock.read().await.info.as_ref().map(|info| info.temp_max).unwrap_or(100);
+        let normalized_profile = utils::normalize_profile(profile, max_temp, 100);
+        let mut offloaded_curves = self.offloaded_curves.write().await;
+        let previous_curve = offloaded_curves.remove(&(device_uid.clone(), channel_info.number));
+        match curve.program(&hwmon_driver.path, temp_channel.number, &normalized_profile).await {
+            Ok((programmed_values, original_values)) => {
+                info!(
+                    "Offloaded the speed profile of device: {} channel: {} to the chip's auto curve",
+                    device_uid, setting.channel_name
+                );
+                offloaded_curves.insert(
+                    (device_uid.clone(), channel_info.number),
+                    OffloadedCurve {
+                        temp_number: temp_channel.number,
+                        normalized_profile,
+                        programmed_values,
+                        // the chip's original curve, not the one we programmed before:
+                        original_values: previous_curve
+                            .map(|previous_curve| previous_curve.original_values)
+                            .unwrap_or(original_values),
+                    },
+                );
+                Ok(true)
+            }
+            Err(err) => {
+                warn!(
+                    "Could not offload the speed profile of device: {} channel: {}, it will be scheduled instead: {}",
+                    device_uid, setting.channel_name, err
+                );
+                if let Some(previous_curve) = previous_curve {
+                    auto_curve::restore(&hwmon_driver.path, &previous_curve.original_values).await;
+                }
+                Ok(false)
+            }
+        }
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::path::Path;
+
+    use test_context::{AsyncTestContext, test_context};
+    use uuid::Uuid;
+
+    use crate::setting::TempSource;
+
+    use super::*;
+
+    const TEST_BASE_PATH_STR: &str = "/tmp/coolercontrol-tests-";
+
+    struct HwmonFileContext {
+        test_base_path: PathBuf,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncTestContext for HwmonFileContext {
+        async fn setup() -> HwmonFileContext {
+            let test_base_path = Path::new(
+                &(TEST_BASE_PATH_STR.to_string() + &Uuid::new_v4().to_string())
+            ).to_path_buf();
+            tokio::fs::create_dir_all(&test_base_path).await.unwrap();
+            HwmonFileContext { test_base_path }
+        }
+
+        async fn teardown(self) {
+            tokio::fs::remove_dir_all(&self.test_base_path).await.unwrap();
+        }
+    }
+
+    /// A nct6775 chip with a fan on pwm2, which has 5 auto points and the BIOS curve on temp 1,
+    /// and a temp on temp3
+    async fn nct6775_repo(base_path: &PathBuf) -> (HwmonRepo, UID) {
+        tokio::fs::write(base_path.join("fan2_input"), b"900").await.unwrap();
+        tokio::fs::write(base_path.join("pwm2"), b"102").await.unwrap();
+        tokio::fs::write(base_path.join("pwm2_enable"), b"5").await.unwrap();
+        tokio::fs::write(base_path.join("pwm2_temp_sel"), b"1").await.unwrap();
+        for point in 1..=5 {
+            tokio::fs::write(base_path.join(format!("pwm2_auto_point{}_temp", point)), format!("{}", point * 15000)).await.unwrap();
+            tokio::fs::write(base_path.join(format!("pwm2_auto_point{}_pwm", point)), format!("{}", point * 51)).await.unwrap();
+        }
+        tokio::fs::write(base_path.join("temp3_input"), b"45000").await.unwrap();
+        let driver = HwmonDriverInfo {
+            name: "nct6798".to_string(),
+            path: base_path.clone(),
+            model: None,
+            u_id: "nct6798-test".to_string(),
+            channels: vec![
+                HwmonChannelInfo {
+                    hwmon_type: HwmonChannelType::Fan,
+                    number: 2,
+                    pwm_enable_default: Some(5),
+                    name: "fan2".to_string(),
+                    pwm_mode_supported: false,
+                },
+                HwmonChannelInfo {
+                    hwmon_type: HwmonChannelType::Temp,
+                    number: 3,
+                    name: "temp3".to_string(),
+                    ..Default::default()
+                },
+            ],
+        };
+        let curve = AutoCurve::detect(base_path, "nct6798", 2).await.unwrap();
+        let mut repo = HwmonRepo::new(Vec::new()).await.unwrap();
+        repo.map_into_our_device_model(vec![driver]).await;
+        let device_uid = repo.devices.keys().next().unwrap().clone();
+        repo.auto_curves.insert(device_uid.clone(), HashMap::from([(2, curve)]));
+        (repo, device_uid)
+    }
+
+    fn profile_setting(temp_source_uid: &UID) -> Setting {
+        Setting {
+            channel_name: "fan2".to_string(),
+            speed_profile: Some(vec![(30, 20), (50, 40), (70, 100)]),
+            temp_source: Some(TempSource {
+                temp_name: "temp3".to_string(),
+                device_uid: temp_source_uid.clone(),
+            }),
+            ..Default::default()
+        }
+    }
+
+    async fn read(base_path: &PathBuf, file_name: &str) -> String {
+        tokio::fs::read_to_string(base_path.join(file_name)).await.unwrap().trim().to_string()
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn offload_speed_profile_to_the_chip(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        let (repo, device_uid) = nct6775_repo(test_base_path).await;
+
+        // when:
+        let offloaded = repo.offload_speed_profile(&device_uid, &profile_setting(&device_uid)).await.unwrap();
+
+        // then:
+        assert!(offloaded);
+        assert_eq!(read(test_base_path, "pwm2_temp_sel").await, "3");
+        assert_eq!(read(test_base_path, "pwm2_auto_point1_temp").await, "30000");
+        assert_eq!(read(test_base_path, "pwm2_enable").await, "5");
+        assert!(repo.offloaded_curves.read().await.contains_key(&(device_uid, 2)));
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn profile_with_another_temp_source_is_not_offloaded(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        let (repo, device_uid) = nct6775_repo(test_base_path).await;
+
+        // when:
+        let offloaded = repo.offload_speed_profile(
+            &device_uid, &profile_setting(&"other-device".to_string()),
+        ).await.unwrap();
+
+        // then:
+        assert!(!offloaded);
+        assert_eq!(read(test_base_path, "pwm2_temp_sel").await, "1");
+        assert!(repo.offloaded_curves.read().await.is_empty());
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn monitor_reprograms_a_restored_bios_curve(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        let (repo, device_uid) = nct6775_repo(test_base_path).await;
+        repo.offload_speed_profile(&device_uid, &profile_setting(&device_uid)).await.unwrap();
+        // like after resuming from sleep, with the channel still in auto mode:
+        tokio::fs::write(test_base_path.join("pwm2_temp_sel"), b"1").await.unwrap();
+        tokio::fs::write(test_base_path.join("pwm2_auto_point1_temp"), b"15000").await.unwrap();
+
+        // when:
+        repo.monitor_offloaded_curves().await;
+
+        // then:
+        assert_eq!(read(test_base_path, "pwm2_temp_sel").await, "3");
+        assert_eq!(read(test_base_path, "pwm2_auto_point1_temp").await, "30000");
+        assert_eq!(read(test_base_path, "pwm2_enable").await, "5");
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn fixed_speed_releases_the_offloaded_curve(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        let (repo, device_uid) = nct6775_repo(test_base_path).await;
+        repo.offload_speed_profile(&device_uid, &profile_setting(&device_uid)).await.unwrap();
+        let fixed_setting = Setting {
+            channel_name: "fan2".to_string(),
+            speed_fixed: Some(60),
+            ..Default::default()
+        };
+
+        // when:
+        repo.apply_setting(&device_uid, &fixed_setting).await.unwrap();
+
+        // then:
+        assert_eq!(read(test_base_path, "pwm2_temp_sel").await, "1");
+        assert_eq!(read(test_base_path, "pwm2_auto_point1_temp").await, "15000");
+        assert_eq!(read(test_base_path, "pwm2_enable").await, "1");
+        assert_eq!(read(test_base_path, "pwm2").await, "153");
+        assert!(repo.offloaded_curves.read().await.is_empty());
+    }
 }
@@ -17,6 +17,7 @@
  ******************************************************************************/
 
 pub mod hwmon_repo;
+mod auto_curve;
 pub mod devices;
 pub mod fans;
 pub mod temps;
\ No newline at end of file
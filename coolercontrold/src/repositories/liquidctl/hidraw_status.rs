@@ -0,0 +1,536 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::io::Read;
+use std::os::unix::io::AsRawFd;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, RwLock};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::time::{Duration, Instant};
+
+use log::{debug, error, info, warn};
+use nix::errno::Errno;
+use nix::poll::{poll, PollFd, PollFlags};
+
+use crate::repositories::liquidctl::base_driver::BaseDriver;
+use crate::repositories::liquidctl::liquidctl_repo::DeviceProperties;
+
+type LCStatus = Vec<(String, String, String)>;
+
+const HIDRAW_CLASS_PATH: &str = "/sys/class/hidraw";
+const NZXT_VENDOR_ID: &str = "00001E71";
+const REPORT_LENGTH: usize = 64;
+/// These devices push a status report about every half second.
+/// A reader that hasn't received one for longer is considered broken.
+const MAX_STATUS_AGE: Duration = Duration::from_secs(2);
+const FIRST_REPORT_POLL_INTERVAL: Duration = Duration::from_millis(50);
+/// How long the reader waits for a report before checking if it has been stopped
+const REPORT_WAIT_TIMEOUT: Duration = Duration::from_millis(500);
+/// The Smart Device V2 fan mode of a fan that isn't connected. Connected fans are DC (1) or PWM (2).
+const FAN_MODE_NOT_CONNECTED: u8 = 0;
+
+/// The layouts of the status reports that devices push on their own, without being asked.
+/// The Kraken Z3 only answers status requests, so it isn't included.
+#[derive(Debug, Clone, PartialEq)]
+pub enum StatusReportFormat {
+    KrakenX3,
+    SmartDevice2 { speed_channel_count: usize },
+}
+
+impl StatusReportFormat {
+    pub fn for_driver(driver_type: &BaseDriver, device_props: &DeviceProperties) -> Option<Self> {
+        match driver_type {
+            BaseDriver::KrakenX3 => Some(StatusReportFormat::KrakenX3),
+            BaseDriver::SmartDevice2 => Some(StatusReportFormat::SmartDevice2 {
+                speed_channel_count: device_props.speed_channels.len(),
+            }),
+            _ => None,
+        }
+    }
+
+    /// Decodes a status report into the same format liqctld returns, like liquidctl does.
+    /// Returns None for other reports.
+    pub fn decode(&self, report: &[u8]) -> Option<LCStatus> {
+        match self {
+            StatusReportFormat::KrakenX3 => Self::decode_kraken_x3(report),
+            StatusReportFormat::SmartDevice2 { speed_channel_count } =>
+                Self::decode_smart_device2(report, *speed_channel_count),
+        }
+    }
+
+    fn decode_kraken_x3(report: &[u8]) -> Option<LCStatus> {
+        if report.len() < 20 || report[0] != 0x75 || report[1] != 0x02 {
+            return None;
+        }
+        let mut lc_status = Vec::with_capacity(3);
+        if report[15..17] != [0xff, 0xff] {  // a firmware fault, for ex. after waking from sleep
+            let temp = report[15] as f64 + report[16] as f64 / 10.0;
+            lc_status.push(("liquid temperature".to_string(), temp.to_string(), "°C".to_string()));
+        }
+        let pump_rpm = u16::from_le_bytes([report[17], report[18]]);
+        lc_status.push(("pump speed".to_string(), pump_rpm.to_string(), "rpm".to_string()));
+        lc_status.push(("pump duty".to_string(), report[19].to_string(), "%".to_string()));
+        Some(lc_status)
+    }
+
+    fn decode_smart_device2(report: &[u8], speed_channel_count: usize) -> Option<LCStatus> {
+        const MODE_OFFSET: usize = 16;
+        const RPM_OFFSET: usize = 24;
+        const DUTY_OFFSET: usize = 40;
+        const NOISE_OFFSET: usize = 56;
+        if report.len() <= NOISE_OFFSET || report[0] != 0x67 || report[1] != 0x02 {
+            return None;
+        }
+        let mut lc_status = Vec::with_capacity(speed_channel_count * 2 + 1);
+        for channel_index in 0..speed_channel_count.min((DUTY_OFFSET - RPM_OFFSET) / 2) {
+            // like liquidctl, fans that aren't connected are left out, but stopped fans are kept
+            if report[MODE_OFFSET + channel_index] == FAN_MODE_NOT_CONNECTED {
+                continue;
+            }
+            let rpm = u16::from_le_bytes(
+                [report[RPM_OFFSET + channel_index * 2], report[RPM_OFFSET + channel_index * 2 + 1]]
+            );
+            let fan_number = channel_index + 1;
+            lc_status.push((
+                format!("fan {} speed", fan_number), rpm.to_string(), "rpm".to_string()
+            ));
+            lc_status.push((
+                format!("fan {} duty", fan_number), report[DUTY_OFFSET + channel_index].to_string(), "%".to_string()
+            ));
+        }
+        lc_status.push(("noise level".to_string(), report[NOISE_OFFSET].to_string(), "dB".to_string()));
+        Some(lc_status)
+    }
+}
+
+struct LatestStatus {
+    received: Instant,
+    status: Option<LCStatus>,
+}
+
+/// Reads the status reports a device pushes through its hidraw node in a separate thread.
+/// Every open hidraw node receives its own copy of the reports, so this doesn't take them away from liqctld,
+/// which is still used for writes and initialization.
+pub struct HidrawStatusReader {
+    hidraw_path: PathBuf,
+    latest: Arc<RwLock<LatestStatus>>,
+    stopped: Arc<AtomicBool>,
+    fallen_back: AtomicBool,
+}
+
+impl HidrawStatusReader {
+    /// Starts reading status reports from the hidraw node of the device with this serial number.
+    /// Returns None if there is no such node, or if the device doesn't push a status report in time.
+    pub async fn start(format: StatusReportFormat, serial_number: &Option<String>) -> Option<Self> {
+        let serial_number = serial_number.as_ref()?;
+        let hidraw_path = find_hidraw_node(Path::new(HIDRAW_CLASS_PATH), serial_number)?;
+        let file = File::open(&hidraw_path)
+            .map_err(|err| warn!("Could not open {:?} for status reports: {}", hidraw_path, err))
+            .ok()?;
+        let reader = Self {
+            hidraw_path: hidraw_path.clone(),
+            latest: Arc::new(RwLock::new(LatestStatus { received: Instant::now(), status: None })),
+            stopped: Arc::new(AtomicBool::new(false)),
+            fallen_back: AtomicBool::new(false),
+        };
+        let latest = Arc::clone(&reader.latest);
+        let stopped = Arc::clone(&reader.stopped);
+        std::thread::Builder::new()
+            .name("hidraw-status".to_string())
+            .spawn(move || {
+                read_status_reports(&file, &format, &latest, &stopped, || wait_for_report(&file));
+                stopped.store(true, Ordering::SeqCst);
+                // the hidraw node is closed when the file is dropped here
+            })
+            .map_err(|err| error!("Could not start hidraw status reader: {}", err))
+            .ok()?;
+        let start = Instant::now();
+        while start.elapsed() < MAX_STATUS_AGE {
+            if reader.latest_status().is_some() {
+                info!("Reading status reports directly from {:?}", hidraw_path);
+                return Some(reader);
+            }
+            tokio::time::sleep(FIRST_REPORT_POLL_INTERVAL).await;
+        }
+        warn!("No status reports received from {:?}, using liqctld for status instead", hidraw_path);
+        None  // dropping the reader stops the thread after the current wait for a report
+    }
+
+    /// The most recently received status, if it isn't outdated.
+    /// After falling back to liqctld, there is never a status from this reader again.
+    pub fn latest_status(&self) -> Option<LCStatus> {
+        if self.fallen_back.load(Ordering::SeqCst) {
+            return None;
+        }
+        let latest = self.latest.read().expect("Status report lock should not be poisoned");
+        if latest.received.elapsed() > MAX_STATUS_AGE {
+            return None;
+        }
+        latest.status.clone()
+    }
+
+    /// Whether the reader stopped or no status reports have been received for a while
+    pub fn is_broken(&self) -> bool {
+        self.stopped.load(Ordering::SeqCst)
+            || self.latest.read().expect("Status report lock should not be poisoned").received.elapsed() > MAX_STATUS_AGE
+    }
+
+    /// Returns true only the first time, so that the fallback to liqctld is only set up once.
+    /// The fallback is permanent: the reader is stopped, so that the status doesn't switch back and forth
+    /// between both sources, and the liqctld queue is consumed on every update from now on.
+    pub fn start_fallback(&self) -> bool {
+        let is_first_fallback = !self.fallen_back.swap(true, Ordering::SeqCst);
+        if is_first_fallback {
+            warn!("Status reports from {:?} stopped, using liqctld for status instead", self.hidraw_path);
+            self.stopped.store(true, Ordering::SeqCst);
+        }
+        is_first_fallback
+    }
+}
+
+impl Drop for HidrawStatusReader {
+    fn drop(&mut self) {
+        self.stopped.store(true, Ordering::SeqCst);
+    }
+}
+
+/// Each read from a hidraw node returns a single report.
+/// Reads only happen once a report is ready, so that a device that stops sending reports
+/// doesn't keep the reader from noticing that it has been stopped.
+fn read_status_reports(
+    mut source: impl Read, format: &StatusReportFormat, latest: &RwLock<LatestStatus>, stopped: &AtomicBool,
+    mut wait_for_report: impl FnMut() -> nix::Result<bool>,
+) {
+    let mut report = [0u8; REPORT_LENGTH];
+    while !stopped.load(Ordering::SeqCst) {
+        match wait_for_report() {
+            Ok(true) => {}
+            Ok(false) => continue,
+            Err(err) => {
+                error!("Error waiting for hidraw status report: {}", err);
+                break;
+            }
+        }
+        let report_length = match source.read(&mut report) {
+            Ok(0) => break,
+            Ok(report_length) => report_length,
+            Err(err) => {
+                error!("Error reading hidraw status report: {}", err);
+                break;
+            }
+        };
+        if let Some(status) = format.decode(&report[..report_length]) {
+            let mut latest = latest.write().expect("Status report lock should not be poisoned");
+            latest.received = Instant::now();
+            latest.status = Some(status);
+        }
+    }
+    debug!("Hidraw status reader stopped");
+}
+
+/// Returns true when a report can be read, or false when none arrived within the REPORT_WAIT_TIMEOUT
+fn wait_for_report(file: &File) -> nix::Result<bool> {
+    let mut poll_fds = [PollFd::new(file.as_raw_fd(), PollFlags::POLLIN)];
+    match poll(&mut poll_fds, REPORT_WAIT_TIMEOUT.as_millis() as i32) {
+        Ok(ready_count) => Ok(ready_count > 0),
+        Err(Errno::EINTR) => Ok(false),
+        Err(err) => Err(err),
+    }
+}
+
+/// Finds the /dev/hidraw* node of the NZXT device with this serial number
+fn find_hidraw_node(hidraw_class_path: &Path, serial_number: &str) -> Option<PathBuf> {
+    let entries = std::fs::read_dir(hidraw_class_path).ok()?;
+    for entry in entries.filter_map(|entry| entry.ok()) {
+        let uevent = std::fs::read_to_string(entry.path().join("device").join("uevent"))
+            .unwrap_or_default();
+        let details: HashMap<&str, &str> = uevent.lines()
+            .filter_map(|line| line.split_once('='))
+            .map(|(key, value)| (key.trim(), value.trim()))
+            .collect();
+        let is_nzxt_device = details.get("HID_ID")
+            .map_or(false, |hid_id| hid_id.to_uppercase().contains(NZXT_VENDOR_ID));
+        let has_serial_number = details.get("HID_UNIQ")
+            .map_or(false, |uniq| uniq.eq_ignore_ascii_case(serial_number));
+        if is_nzxt_device && has_serial_number {
+            return Some(Path::new("/dev").join(entry.file_name()));
+        }
+    }
+    None
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::io::Cursor;
+
+    use super::*;
+
+    /// Captured status reports
+    const KRAKEN_X3_STATUS_REPORT: &str = concat!(
+        "7502200036000b51535834353320012101a80635350000000000000000000000",
+        "0000000000000000000000000000000000000000000000000000000000000000",
+    );
+    const SMART_DEVICE2_STATUS_REPORT: &str = concat!(
+        "67023a003f00185732533230312003000100000000000000ff03000000000000",
+        "0000000000000000323232000000000032323200000000003000000000000000",
+    );
+    /// A firmware info report, which also arrives on the same node
+    const KRAKEN_X3_FIRMWARE_REPORT: &str = concat!(
+        "1102000000000000000000000000000000010203000000000000000000000000",
+        "0000000000000000000000000000000000000000000000000000000000000000",
+    );
+
+    fn report(hex: &str) -> Vec<u8> {
+        (0..hex.len()).step_by(2)
+            .map(|index| u8::from_str_radix(&hex[index..index + 2], 16).unwrap())
+            .collect()
+    }
+
+    fn status(entries: &[(&str, &str, &str)]) -> LCStatus {
+        entries.iter()
+            .map(|(key, value, unit)| (key.to_string(), value.to_string(), unit.to_string()))
+            .collect()
+    }
+
+    #[test]
+    fn decode_kraken_x3_status() {
+        // when:
+        let lc_status = StatusReportFormat::KrakenX3.decode(&report(KRAKEN_X3_STATUS_REPORT));
+
+        // then:
+        assert_eq!(lc_status, Some(status(&[
+            ("liquid temperature", "33.1", "°C"),
+            ("pump speed", "1704", "rpm"),
+            ("pump duty", "53", "%"),
+        ])));
+    }
+
+    #[test]
+    fn decode_kraken_x3_temp_fault() {
+        // given:
+        let mut faulty_report = report(KRAKEN_X3_STATUS_REPORT);
+        faulty_report[15] = 0xff;
+        faulty_report[16] = 0xff;
+
+        // when:
+        let lc_status = StatusReportFormat::KrakenX3.decode(&faulty_report).unwrap();
+
+        // then:
+        assert_eq!(lc_status.len(), 2);
+        assert_eq!(lc_status[0].0, "pump speed");
+    }
+
+    #[test]
+    fn decode_smart_device2_status() {
+        // given:
+        let format = StatusReportFormat::SmartDevice2 { speed_channel_count: 3 };
+
+        // when:
+        let lc_status = format.decode(&report(SMART_DEVICE2_STATUS_REPORT));
+
+        // then:
+        assert_eq!(lc_status, Some(status(&[
+            ("fan 1 speed", "1023", "rpm"),
+            ("fan 1 duty", "50", "%"),
+            ("noise level", "48", "dB"),
+        ])));
+    }
+
+    #[test]
+    fn decode_smart_device2_speeds_with_a_zero_byte() {
+        // given:
+        let format = StatusReportFormat::SmartDevice2 { speed_channel_count: 3 };
+        let mut speeds_report = report(SMART_DEVICE2_STATUS_REPORT);
+        speeds_report[17] = 0x02;  // fan 2 connected as PWM
+        speeds_report[24..28].copy_from_slice(&[0x00, 0x03, 0xc8, 0x00]);  // 0x0300 and 0x00C8
+
+        // when:
+        let lc_status = format.decode(&speeds_report);
+
+        // then:
+        assert_eq!(lc_status, Some(status(&[
+            ("fan 1 speed", "768", "rpm"),
+            ("fan 1 duty", "50", "%"),
+            ("fan 2 speed", "200", "rpm"),
+            ("fan 2 duty", "50", "%"),
+            ("noise level", "48", "dB"),
+        ])));
+    }
+
+    #[test]
+    fn other_reports_are_ignored() {
+        // when:
+        let firmware_status = StatusReportFormat::KrakenX3.decode(&report(KRAKEN_X3_FIRMWARE_REPORT));
+        let other_device_status = StatusReportFormat::KrakenX3.decode(&report(SMART_DEVICE2_STATUS_REPORT));
+        let short_status = StatusReportFormat::KrakenX3.decode(&report(KRAKEN_X3_STATUS_REPORT)[..10]);
+
+        // then:
+        assert_eq!(firmware_status, None);
+        assert_eq!(other_device_status, None);
+        assert_eq!(short_status, None);
+    }
+
+    #[test]
+    fn replay_captured_reports() {
+        // given:
+        let mut second_status_report = report(KRAKEN_X3_STATUS_REPORT);
+        second_status_report[19] = 0x40;  // pump duty changed
+        let capture: Vec<u8> = [
+            report(KRAKEN_X3_STATUS_REPORT),
+            report(KRAKEN_X3_FIRMWARE_REPORT),
+            second_status_report,
+            report(KRAKEN_X3_FIRMWARE_REPORT),
+        ].concat();
+        let latest = RwLock::new(LatestStatus { received: Instant::now(), status: None });
+        let stopped = AtomicBool::new(false);
+
+        // when:
+        read_status_reports(Cursor::new(capture), &StatusReportFormat::KrakenX3, &latest, &stopped, || Ok(true));
+
+        // then:
+        let latest_status = latest.read().unwrap().status.clone().unwrap();
+        assert_eq!(latest_status[2], ("pump duty".to_string(), "64".to_string(), "%".to_string()));
+    }
+
+    #[test]
+    fn replay_captured_reports_with_a_stopped_fan() {
+        // given:
+        let format = StatusReportFormat::SmartDevice2 { speed_channel_count: 3 };
+        let mut stopped_fan_report = report(SMART_DEVICE2_STATUS_REPORT);
+        stopped_fan_report[24..26].copy_from_slice(&[0x00, 0x00]);  // fan 1 is connected, but stopped
+        stopped_fan_report[40] = 0x00;
+        let capture: Vec<u8> = [
+            report(SMART_DEVICE2_STATUS_REPORT),
+            stopped_fan_report,
+        ].concat();
+        let latest = RwLock::new(LatestStatus { received: Instant::now(), status: None });
+        let stopped = AtomicBool::new(false);
+
+        // when:
+        read_status_reports(Cursor::new(capture), &format, &latest, &stopped, || Ok(true));
+
+        // then:
+        assert_eq!(latest.read().unwrap().status, Some(status(&[
+            ("fan 1 speed", "0", "rpm"),
+            ("fan 1 duty", "0", "%"),
+            ("noise level", "48", "dB"),
+        ])));
+    }
+
+    #[test]
+    fn stopped_reader_does_not_wait_for_reports() {
+        // given:
+        let latest = RwLock::new(LatestStatus { received: Instant::now(), status: None });
+        let stopped = AtomicBool::new(false);
+        let mut waits = 0;
+
+        // when:
+        read_status_reports(
+            Cursor::new(Vec::new()), &StatusReportFormat::KrakenX3, &latest, &stopped,
+            || {  // the device doesn't send anything until the reader is stopped
+                waits += 1;
+                stopped.store(waits == 3, Ordering::SeqCst);
+                Ok(false)
+            },
+        );
+
+        // then:
+        assert_eq!(waits, 3);
+        assert_eq!(latest.read().unwrap().status, None);
+    }
+
+    #[test]
+    fn fallback_is_permanent() {
+        // given:
+        let reader = HidrawStatusReader {
+            hidraw_path: PathBuf::from("/dev/hidraw3"),
+            latest: Arc::new(RwLock::new(LatestStatus {
+                received: Instant::now(),
+                status: StatusReportFormat::KrakenX3.decode(&report(KRAKEN_X3_STATUS_REPORT)),
+            })),
+            stopped: Arc::new(AtomicBool::new(false)),
+            fallen_back: AtomicBool::new(false),
+        };
+
+        // when:
+        let first_fallback = reader.start_fallback();
+        let second_fallback = reader.start_fallback();
+
+        // then:
+        assert!(first_fallback);
+        assert!(!second_fallback);
+        assert!(reader.stopped.load(Ordering::SeqCst));
+        assert_eq!(reader.latest_status(), None);  // even though a recent status is there
+    }
+
+    #[test]
+    fn find_hidraw_node_by_serial_number() {
+        // given:
+        let class_path = std::env::temp_dir().join(format!("coolercontrol-tests-hidraw-{}", uuid::Uuid::new_v4()));
+        for (name, hid_id, uniq) in [
+            ("hidraw0", "0003:0000046D:0000C52B", "1234"),
+            ("hidraw3", "0003:00001E71:00002007", "61A9A2B4DE07"),
+        ] {
+            let device_path = class_path.join(name).join("device");
+            std::fs::create_dir_all(&device_path).unwrap();
+            std::fs::write(
+                device_path.join("uevent"),
+                format!("DRIVER=hid-generic\nHID_ID={}\nHID_NAME=Test\nHID_UNIQ={}\n", hid_id, uniq),
+            ).unwrap();
+        }
+
+        // when:
+        let found = find_hidraw_node(&class_path, "61a9a2b4de07");
+        let not_found = find_hidraw_node(&class_path, "1234");
+
+        // then:
+        std::fs::remove_dir_all(&class_path).unwrap();
+        assert_eq!(found, Some(PathBuf::from("/dev/hidraw3")));
+        assert_eq!(not_found, None);
+    }
+
+    /// Run with: cargo test decode_benchmark -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn decode_benchmark() {
+        // given:
+        let iterations = 1_000_000;
+        let kraken_report = report(KRAKEN_X3_STATUS_REPORT);
+        let smart_device_report = report(SMART_DEVICE2_STATUS_REPORT);
+        let smart_device_format = StatusReportFormat::SmartDevice2 { speed_channel_count: 3 };
+
+        // when:
+        let kraken_start = Instant::now();
+        for _ in 0..iterations {
+            std::hint::black_box(StatusReportFormat::KrakenX3.decode(std::hint::black_box(&kraken_report)));
+        }
+        let kraken_elapsed = kraken_start.elapsed();
+        let smart_device_start = Instant::now();
+        for _ in 0..iterations {
+            std::hint::black_box(smart_device_format.decode(std::hint::black_box(&smart_device_report)));
+        }
+        let smart_device_elapsed = smart_device_start.elapsed();
+
+        // then:
+        println!("Kraken X3 status decode: {:?} per report", kraken_elapsed / iterations);
+        println!("Smart Device V2 status decode: {:?} per report", smart_device_elapsed / iterations);
+    }
+}
@@ -0,0 +1,330 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::path::PathBuf;
+
+use anyhow::{Context, Result};
+use log::{debug, info};
+
+use crate::repositories::hwmon::{devices, fans};
+use crate::repositories::hwmon::hwmon_repo::{HwmonChannelInfo, HwmonChannelType};
+use crate::repositories::liquidctl::base_driver::BaseDriver;
+
+type LCStatus = Vec<(String, String, String)>;
+
+/// A fan or pump of a kernel driver:
+/// (hwmon number, our channel name, liquidctl status prefix, whether the kernel driver can set its duty)
+type KernelFanSpec = (u8, &'static str, &'static str, bool);
+/// A temperature of a kernel driver: (hwmon number, liquidctl status name)
+type KernelTempSpec = (u8, &'static str);
+/// The hwmon names of a kernel driver, with its fans and temps
+type KernelDriverSpec = (&'static [&'static str], &'static [KernelFanSpec], &'static [KernelTempSpec]);
+
+const KRAKEN_X3_FANS: [KernelFanSpec; 1] = [(1, "pump", "pump", true)];
+const KRAKEN_Z3_FANS: [KernelFanSpec; 2] = [(1, "pump", "pump", true), (2, "fan", "fan", true)];
+const KRAKEN2_FANS: [KernelFanSpec; 2] = [(1, "fan", "fan", false), (2, "pump", "pump", false)];
+const SMART_DEVICE2_FANS: [KernelFanSpec; 3] =
+    [(1, "fan1", "fan 1", true), (2, "fan2", "fan 2", true), (3, "fan3", "fan 3", true)];
+const LIQUID_TEMP: [KernelTempSpec; 1] = [(1, "liquid temperature")];
+
+/// The hwmon names the kernel drivers use for a liquidctl driver, and which of its readings they offer.
+/// Features the kernel drivers lack, like lighting and LCD screens, are always handled by liqctld.
+fn kernel_driver_spec(driver_type: &BaseDriver) -> Option<KernelDriverSpec> {
+    match driver_type {
+        BaseDriver::KrakenX3 => Some((&["kraken3", "x53"], &KRAKEN_X3_FANS, &LIQUID_TEMP)),
+        BaseDriver::KrakenZ3 => Some((&["kraken3", "z53"], &KRAKEN_Z3_FANS, &LIQUID_TEMP)),
+        BaseDriver::Kraken2 => Some((&["kraken2"], &KRAKEN2_FANS, &LIQUID_TEMP)),
+        BaseDriver::SmartDevice2 => Some((&["nzxtsmart2"], &SMART_DEVICE2_FANS, &[])),
+        _ => None,
+    }
+}
+
+#[derive(Debug, Clone)]
+struct KernelFan {
+    channel: HwmonChannelInfo,
+    status_prefix: &'static str,
+    duty_settable: bool,
+}
+
+/// A mainline kernel hwmon driver bound to a liquidctl device.
+/// Its readings are cheap sysfs reads, instead of a liqctld request and a USB transaction each.
+#[derive(Debug, Clone)]
+pub struct KernelDriver {
+    path: PathBuf,
+    fans: Vec<KernelFan>,
+    temps: Vec<KernelTempSpec>,
+}
+
+impl KernelDriver {
+    /// Looks for a kernel driver bound to the liquidctl device with this serial number.
+    /// Paths that were already matched to another device are skipped.
+    pub async fn find(
+        driver_type: &BaseDriver, serial_number: &Option<String>, claimed_paths: &[PathBuf],
+    ) -> Option<Self> {
+        let (hwmon_names, fan_specs, temp_specs) = kernel_driver_spec(driver_type)?;
+        let mut candidates = Vec::new();
+        for path in devices::find_all_hwmon_device_paths() {
+            if claimed_paths.contains(&path) {
+                continue;
+            }
+            let device_name = devices::get_device_name(&path).await;
+            if hwmon_names.contains(&device_name.as_str()) {
+                let hwmon_serial = devices::get_device_serial_number(&path).await;
+                candidates.push((path, hwmon_serial));
+            }
+        }
+        let path = Self::select_path(serial_number, candidates)?;
+        let mut kernel_fans = Vec::new();
+        for (number, channel_name, status_prefix, duty_settable) in fan_specs {
+            if tokio::fs::metadata(path.join(format!("fan{}_input", number))).await.is_err() {
+                continue;
+            }
+            let pwm_enable_default = tokio::fs::read_to_string(path.join(format!("pwm{}_enable", number))).await
+                .and_then(fans::check_parsing_8)
+                .ok();
+            kernel_fans.push(KernelFan {
+                channel: HwmonChannelInfo {
+                    hwmon_type: HwmonChannelType::Fan,
+                    number: *number,
+                    pwm_enable_default,
+                    name: channel_name.to_string(),
+                    pwm_mode_supported: false,
+                },
+                status_prefix,
+                duty_settable: *duty_settable,
+            });
+        }
+        info!("Using kernel hwmon driver at {:?} for {} device status and speeds", path, driver_type);
+        Some(Self {
+            path,
+            fans: kernel_fans,
+            temps: temp_specs.to_vec(),
+        })
+    }
+
+    /// Matches by serial number. Without a serial number on either side, only an unambiguous candidate is used.
+    fn select_path(serial_number: &Option<String>, candidates: Vec<(PathBuf, Option<String>)>) -> Option<PathBuf> {
+        let candidate_count = candidates.len();
+        let mut fallback = None;
+        for (path, hwmon_serial) in candidates {
+            match (serial_number, &hwmon_serial) {
+                (Some(serial), Some(hwmon_serial)) if serial.eq_ignore_ascii_case(hwmon_serial.trim()) =>
+                    return Some(path),
+                (None, _) | (_, None) if candidate_count == 1 => fallback = Some(path),
+                _ => {}
+            }
+        }
+        fallback
+    }
+
+    pub fn path(&self) -> &PathBuf {
+        &self.path
+    }
+
+    /// Reads the status from sysfs in the same format liqctld returns,
+    /// so that it is mapped to exactly the same channels and temps.
+    pub async fn status(&self) -> LCStatus {
+        let mut lc_status = Vec::new();
+        for temp in self.temps.iter() {
+            let millidegrees = tokio::fs::read_to_string(self.path.join(format!("temp{}_input", temp.0))).await
+                .ok()
+                .and_then(|content| content.trim().parse::<i32>().ok());
+            if let Some(millidegrees) = millidegrees {
+                lc_status.push((temp.1.to_string(), (millidegrees as f64 / 1000.0).to_string(), "°C".to_string()));
+            }
+        }
+        for fan in self.fans.iter() {
+            let rpm = tokio::fs::read_to_string(self.path.join(format!("fan{}_input", fan.channel.number))).await
+                .ok()
+                .and_then(|content| content.trim().parse::<u32>().ok());
+            if let Some(rpm) = rpm {
+                lc_status.push((format!("{} speed", fan.status_prefix), rpm.to_string(), "rpm".to_string()));
+            }
+            if !fan.duty_settable {
+                continue;  // read-only drivers don't report a duty
+            }
+            let duty = tokio::fs::read_to_string(self.path.join(format!("pwm{}", fan.channel.number))).await
+                .and_then(fans::check_parsing_8)
+                .map(fans::pwm_value_to_duty)
+                .ok();
+            if let Some(duty) = duty {
+                lc_status.push((format!("{} duty", fan.status_prefix), duty.to_string(), "%".to_string()));
+            }
+        }
+        debug!("Kernel driver status read from {:?}: {:?}", self.path, lc_status);
+        lc_status
+    }
+
+    /// Whether the duty of this channel is set through the kernel driver
+    pub fn controls_duty(&self, channel_name: &str) -> bool {
+        self.fans.iter().any(|fan| fan.duty_settable && fan.channel.name == channel_name)
+    }
+
+    pub async fn set_duty(&self, channel_name: &str, duty: u8) -> Result<()> {
+        let fan = self.fans.iter()
+            .find(|fan| fan.duty_settable && fan.channel.name == channel_name)
+            .with_context(|| format!("Searching for kernel driver channel name: {}", channel_name))?;
+        fans::set_pwm_duty(&self.path, &fan.channel, duty).await
+            .with_context(|| format!("Setting duty through kernel driver at {:?}", self.path))
+    }
+
+    /// Gives control back to the kernel driver's default mode
+    pub async fn reset(&self) -> Result<()> {
+        for fan in self.fans.iter().filter(|fan| fan.duty_settable) {
+            fans::set_pwm_enable_to_default(&self.path, &fan.channel).await?;
+        }
+        Ok(())
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::path::Path;
+
+    use test_context::{AsyncTestContext, test_context};
+    use uuid::Uuid;
+
+    use super::*;
+
+    const TEST_BASE_PATH_STR: &str = "/tmp/coolercontrol-tests-";
+
+    struct HwmonFileContext {
+        test_base_path: PathBuf,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncTestContext for HwmonFileContext {
+        async fn setup() -> HwmonFileContext {
+            let test_base_path = Path::new(
+                &(TEST_BASE_PATH_STR.to_string() + &Uuid::new_v4().to_string())
+            ).to_path_buf();
+            tokio::fs::create_dir_all(&test_base_path).await.unwrap();
+            HwmonFileContext { test_base_path }
+        }
+
+        async fn teardown(self) {
+            tokio::fs::remove_dir_all(&self.test_base_path).await.unwrap();
+        }
+    }
+
+    fn kraken_z3_driver(path: &PathBuf) -> KernelDriver {
+        KernelDriver {
+            path: path.clone(),
+            fans: KRAKEN_Z3_FANS.iter()
+                .map(|(number, channel_name, status_prefix, duty_settable)| KernelFan {
+                    channel: HwmonChannelInfo {
+                        number: *number,
+                        name: channel_name.to_string(),
+                        ..Default::default()
+                    },
+                    status_prefix,
+                    duty_settable: *duty_settable,
+                })
+                .collect(),
+            temps: LIQUID_TEMP.to_vec(),
+        }
+    }
+
+    #[test]
+    fn select_path_by_serial_number() {
+        // given:
+        let candidates = vec![
+            (PathBuf::from("/sys/class/hwmon/hwmon3"), Some("AAAA".to_string())),
+            (PathBuf::from("/sys/class/hwmon/hwmon4"), Some("BBBB".to_string())),
+        ];
+
+        // when:
+        let path = KernelDriver::select_path(&Some("bbbb".to_string()), candidates);
+
+        // then:
+        assert_eq!(path, Some(PathBuf::from("/sys/class/hwmon/hwmon4")));
+    }
+
+    #[test]
+    fn select_path_without_serial_only_when_unambiguous() {
+        // given:
+        let single = vec![(PathBuf::from("/sys/class/hwmon/hwmon3"), None)];
+        let multiple = vec![
+            (PathBuf::from("/sys/class/hwmon/hwmon3"), None),
+            (PathBuf::from("/sys/class/hwmon/hwmon4"), None),
+        ];
+
+        // when:
+        let single_path = KernelDriver::select_path(&Some("AAAA".to_string()), single);
+        let multiple_path = KernelDriver::select_path(&None, multiple);
+
+        // then:
+        assert_eq!(single_path, Some(PathBuf::from("/sys/class/hwmon/hwmon3")));
+        assert_eq!(multiple_path, None);
+    }
+
+    #[test]
+    fn select_path_with_other_serial() {
+        // given:
+        let candidates = vec![(PathBuf::from("/sys/class/hwmon/hwmon3"), Some("AAAA".to_string()))];
+
+        // when:
+        let path = KernelDriver::select_path(&Some("BBBB".to_string()), candidates);
+
+        // then:
+        assert_eq!(path, None);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn status_in_liquidctl_format(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        tokio::fs::write(test_base_path.join("temp1_input"), b"31500").await.unwrap();
+        tokio::fs::write(test_base_path.join("fan1_input"), b"2100").await.unwrap();
+        tokio::fs::write(test_base_path.join("pwm1"), b"153").await.unwrap();
+        tokio::fs::write(test_base_path.join("fan2_input"), b"800").await.unwrap();
+        let driver = kraken_z3_driver(test_base_path);
+
+        // when:
+        let status = driver.status().await;
+
+        // then:
+        assert_eq!(status, vec![
+            ("liquid temperature".to_string(), "31.5".to_string(), "°C".to_string()),
+            ("pump speed".to_string(), "2100".to_string(), "rpm".to_string()),
+            ("pump duty".to_string(), "60".to_string(), "%".to_string()),
+            ("fan speed".to_string(), "800".to_string(), "rpm".to_string()),
+        ]);
+    }
+
+    #[test_context(HwmonFileContext)]
+    #[tokio::test]
+    async fn set_duty_through_pwm(ctx: &mut HwmonFileContext) {
+        // given:
+        let test_base_path = &ctx.test_base_path;
+        tokio::fs::write(test_base_path.join("pwm2"), b"0").await.unwrap();
+        let driver = kraken_z3_driver(test_base_path);
+
+        // when:
+        let result = driver.set_duty("fan", 50).await;
+
+        // then:
+        assert!(result.is_ok());
+        let pwm = tokio::fs::read_to_string(test_base_path.join("pwm2")).await.unwrap();
+        assert_eq!(pwm, "128");
+        assert!(driver.controls_duty("pump"));
+        assert!(!driver.controls_duty("external"));
+    }
+}
@@ -26,7 +26,7 @@ use tokio::sync::RwLock;
 use tokio::time::Instant;
 use zbus::export::futures_util::future::join_all;
 
-use crate::repositories::liquidctl::liquidctl_repo::{LIQCTLD_ADDRESS, StatusResponse};
+use crate::repositories::liquidctl::liquidctl_repo::{LIQCTLD_ADDRESS, STATUS_DEADLINE, StatusResponse, WithDeadline};
 
 const LIQCTLD_STATUS: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/status");
 
@@ -89,6 +89,7 @@ impl LiqctldUpdateClient {
     async fn call_status(&self, device_id: &u8) -> Result<LCStatus> {
         let status_response = self.client
             .get(LIQCTLD_STATUS.replace("{}", device_id.to_string().as_str()))
+            .with_deadline(STATUS_DEADLINE)
             .send().await
             .with_context(|| format!("Trying to get status for device_id: {}", device_id))?
             .json::<StatusResponse>().await?;
@@ -20,9 +20,11 @@
 use std::borrow::Borrow;
 use std::clone::Clone;
 use std::collections::HashMap;
+use std::path::PathBuf;
 use std::str::FromStr;
 use std::string::ToString;
 use std::sync::Arc;
+use std::sync::atomic::{AtomicUsize, Ordering};
 use std::time::{Duration, Instant};
 
 use anyhow::{anyhow, bail, Context, Result};
@@ -30,7 +32,7 @@ use async_trait::async_trait;
 use const_format::concatcp;
 use log::{debug, error, info, warn};
 use regex::Regex;
-use reqwest::Client;
+use reqwest::{Client, RequestBuilder};
 use serde::{Deserialize, Serialize};
 use tokio::sync::RwLock;
 use tokio::time::sleep;
@@ -41,9 +43,13 @@ use crate::Device;
 use crate::device::{DeviceType, LcInfo, Status, UID};
 use crate::repositories::liquidctl::base_driver::BaseDriver;
 use crate::repositories::liquidctl::device_mapper::DeviceMapper;
+use crate::repositories::liquidctl::hidraw_status::{HidrawStatusReader, StatusReportFormat};
+use crate::repositories::liquidctl::kernel_driver::KernelDriver;
 use crate::repositories::liquidctl::liqctld_client::LiqctldUpdateClient;
+use crate::repositories::liquidctl::pump_mode::PumpMode;
+use crate::repositories::liquidctl::screen_state::{ScreenContent, ScreenState};
 use crate::repositories::repository::{DeviceList, DeviceLock, Repository};
-use crate::setting::Setting;
+use crate::setting::{LcdSettings, Setting};
 
 pub const LIQCTLD_ADDRESS: &str = "http://127.0.0.1:11986";
 const LIQCTLD_HANDSHAKE: &str = concatcp!(LIQCTLD_ADDRESS, "/handshake");
@@ -52,10 +58,19 @@ const LIQCTLD_DEVICES_CONNECT: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/conne
 const LIQCTLD_LEGACY690: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/legacy690");
 const LIQCTLD_INITIALIZE: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/initialize");
 const LIQCTLD_FIXED_SPEED: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/speed/fixed");
+const LIQCTLD_FIXED_SPEED_BATCH: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/speed/fixed/batch");
 const LIQCTLD_SPEED_PROFILE: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/speed/profile");
 const LIQCTLD_COLOR: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/color");
-const LIQCTLD_SCREEN: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/screen");
+const LIQCTLD_SCREEN_BATCH: &str = concatcp!(LIQCTLD_ADDRESS, "/devices/{}/screen/batch");
 const LIQCTLD_QUIT: &str = concatcp!(LIQCTLD_ADDRESS, "/quit");
+const LIQCTLD_DEADLINE_HEADER: &str = "deadline-ms";
+/// liqctld skips jobs that haven't started by their deadline and answers with a timeout.
+/// The client waits a little longer, so that this answer arrives before the client gives up.
+const DEADLINE_RESPONSE_MARGIN: Duration = Duration::from_millis(500);
+pub const STATUS_DEADLINE: Duration = Duration::from_secs(2);
+const CONTROL_DEADLINE: Duration = Duration::from_secs(5);
+const LIGHTING_DEADLINE: Duration = Duration::from_secs(5);
+const SCREEN_DEADLINE: Duration = Duration::from_secs(30);  // gif uploads can take a while
 const PATTERN_TEMP_SOURCE_NUMBER: &str = r"(?P<number>\d+)$";
 
 type LCStatus = Vec<(String, String, String)>;
@@ -66,6 +81,16 @@ pub struct LiquidctlRepo {
     device_mapper: DeviceMapper,
     devices: HashMap<UID, DeviceLock>,
     pub liqctld_update_client: Arc<LiqctldUpdateClient>,
+    /// The last applied state per LCD channel: (device uid, channel name)
+    screen_states: RwLock<HashMap<(UID, String), ScreenState>>,
+    /// The last applied pump mode per device, for drivers whose pump is set through initialization
+    pump_modes: RwLock<HashMap<UID, PumpMode>>,
+    /// Kernel hwmon drivers bound to devices, which are used for status and speeds instead of liqctld
+    kernel_drivers: HashMap<UID, KernelDriver>,
+    /// Readers of the status reports devices push on their own, which are used for status instead of liqctld
+    hidraw_readers: HashMap<UID, HidrawStatusReader>,
+    /// The number of speed writes currently in progress per device, which lighting frames yield to
+    pending_control_writes: HashMap<UID, AtomicUsize>,
 }
 
 impl LiquidctlRepo {
@@ -83,6 +108,11 @@ impl LiquidctlRepo {
             device_mapper: DeviceMapper::new(),
             devices: HashMap::new(),
             liqctld_update_client: Arc::new(liqctld_update_client),
+            screen_states: RwLock::new(HashMap::new()),
+            pump_modes: RwLock::new(HashMap::new()),
+            kernel_drivers: HashMap::new(),
+            hidraw_readers: HashMap::new(),
+            pending_control_writes: HashMap::new(),
         })
     }
 
@@ -118,6 +148,8 @@ impl LiquidctlRepo {
         let devices_response = self.client.get(LIQCTLD_DEVICES)
             .send().await?
             .json::<DevicesResponse>().await?;
+        let hidraw_status_enabled = self.config.get_settings().await
+            .map_or(false, |settings| settings.hidraw_status);
         for device_response in devices_response.devices {
             let driver_type = match self.map_driver_type(&device_response) {
                 None => {
@@ -126,7 +158,15 @@ impl LiquidctlRepo {
                 }
                 Some(d_type) => d_type
             };
-            self.liqctld_update_client.create_update_queue(&device_response.id).await;
+            let kernel_driver = self.find_kernel_driver(&driver_type, &device_response.serial_number).await;
+            let hidraw_reader = match StatusReportFormat::for_driver(&driver_type, &device_response.properties) {
+                Some(format) if hidraw_status_enabled && kernel_driver.is_none() =>
+                    HidrawStatusReader::start(format, &device_response.serial_number).await,
+                _ => None,
+            };
+            if kernel_driver.is_none() && hidraw_reader.is_none() {
+                self.liqctld_update_client.create_update_queue(&device_response.id).await;
+            }
             let device_info = self.device_mapper
                 .extract_info(&driver_type, &device_response.id, &device_response.properties);
             let mut device = Device::new(
@@ -143,6 +183,13 @@ impl LiquidctlRepo {
                 device_response.serial_number,
             );
             self.check_for_legacy_690(&mut device).await?;
+            self.pending_control_writes.insert(device.uid.clone(), AtomicUsize::new(0));
+            if let Some(kernel_driver) = kernel_driver {
+                self.kernel_drivers.insert(device.uid.clone(), kernel_driver);
+            }
+            if let Some(hidraw_reader) = hidraw_reader {
+                self.hidraw_readers.insert(device.uid.clone(), hidraw_reader);
+            }
             self.devices.insert(
                 device.uid.clone(),
                 Arc::new(RwLock::new(device)),
@@ -152,6 +199,17 @@ impl LiquidctlRepo {
         Ok(())
     }
 
+    /// The hwmon paths of the kernel drivers used for devices, which the Hwmon Repo should leave alone.
+    pub fn kernel_driver_paths(&self) -> Vec<PathBuf> {
+        self.kernel_drivers.values()
+            .map(|kernel_driver| kernel_driver.path().clone())
+            .collect()
+    }
+
+    async fn find_kernel_driver(&self, driver_type: &BaseDriver, serial_number: &Option<String>) -> Option<KernelDriver> {
+        KernelDriver::find(driver_type, serial_number, &self.kernel_driver_paths()).await
+    }
+
     pub async fn connect_devices(&self) -> Result<()> {
         let connection_response = self.client.post(LIQCTLD_DEVICES_CONNECT)
             .send().await?
@@ -279,48 +337,17 @@ impl LiquidctlRepo {
             .expect("lc_info for LC Device should always be present")
             .driver_type.clone();
         let fixed_speed = setting.speed_fixed.with_context(|| "speed_fixed should be present")?;
-        if driver_type == BaseDriver::HydroPlatinum && setting.channel_name == "pump" {
-            // limits from tested Hydro H150i Pro XT
-            let pump_mode =
-                if fixed_speed < 56 {
-                    "quiet".to_string()
-                } else if fixed_speed > 75 {
-                    "extreme".to_string()
-                } else {
-                    "balanced".to_string()
-                };
-            self.client.borrow()
-                .post(LIQCTLD_INITIALIZE
-                    .replace("{}", type_index.to_string().as_str())
-                )
-                .json(&InitializeRequest { pump_mode: Some(pump_mode) })
-                .send().await?
-                .error_for_status()
-                .map(|_| ())  // ignore successful result
-                .with_context(|| format!("Setting fixed speed through initialization for Liquidctl Device #{}: {}", type_index, uid))
-        } else if driver_type == BaseDriver::HydroPro && setting.channel_name == "pump" {
-            let pump_mode =
-                if fixed_speed < 34 {
-                    "quiet".to_string()
-                } else if fixed_speed > 66 {
-                    "performance".to_string()
-                } else {
-                    "balanced".to_string()
-                };
-            self.client.borrow()
-                .post(LIQCTLD_INITIALIZE
-                    .replace("{}", type_index.to_string().as_str())
-                )
-                .json(&InitializeRequest { pump_mode: Some(pump_mode) })
-                .send().await?
-                .error_for_status()
-                .map(|_| ())  // ignore successful result
-                .with_context(|| format!("Setting fixed speed through initialization for Liquidctl Device #{}: {}", type_index, uid))
+        if let Some(kernel_driver) = self.kernel_driver_for(&uid, &setting.channel_name) {
+            kernel_driver.set_duty(&setting.channel_name, fixed_speed).await
+                .with_context(|| format!("Setting fixed speed for Liquidctl Device #{}: {}", type_index, uid))
+        } else if setting.channel_name == "pump" && PumpMode::is_supported(&driver_type) {
+            self.set_pump_mode(fixed_speed, &driver_type, type_index, &uid).await
         } else {
             self.client.borrow()
                 .put(LIQCTLD_FIXED_SPEED
                     .replace("{}", type_index.to_string().as_str())
                 )
+                .with_deadline(CONTROL_DEADLINE)
                 .json(&FixedSpeedRequest {
                     channel: setting.channel_name.clone(),
                     duty: fixed_speed,
@@ -332,6 +359,76 @@ impl LiquidctlRepo {
         }
     }
 
+    /// Returns the kernel driver if it controls the duty of this device channel
+    fn kernel_driver_for(&self, device_uid: &UID, channel_name: &str) -> Option<&KernelDriver> {
+        self.kernel_drivers.get(device_uid)
+            .filter(|kernel_driver| kernel_driver.controls_duty(channel_name))
+    }
+
+    /// Pump modes are set by reinitializing the device, so this is only done when the mode changes.
+    async fn set_pump_mode(&self, duty: u8, driver_type: &BaseDriver, type_index: u8, uid: &UID) -> Result<()> {
+        // the mode is taken out while applying, so that a failed request leaves it unknown
+        let current_mode = self.pump_modes.write().await.remove(uid);
+        let pump_mode = PumpMode::for_duty(driver_type, duty, current_mode)
+            .with_context(|| format!("Pump mode for driver {}", driver_type))?;
+        if current_mode == Some(pump_mode) {
+            debug!("Pump mode for Liquidctl Device #{} is unchanged", type_index);
+        } else {
+            self.client.borrow()
+                .post(LIQCTLD_INITIALIZE
+                    .replace("{}", type_index.to_string().as_str())
+                )
+                .json(&InitializeRequest { pump_mode: Some(pump_mode.name(driver_type).to_string()) })
+                .send().await?
+                .error_for_status()
+                .map(|_| ())  // ignore successful result
+                .with_context(|| format!("Setting fixed speed through initialization for Liquidctl Device #{}: {}", type_index, uid))?;
+        }
+        self.pump_modes.write().await.insert(uid.clone(), pump_mode);
+        Ok(())
+    }
+
+    /// Pump channels of these drivers are set through initialization with a pump mode,
+    /// and can not be combined with other fixed speeds.
+    fn is_plain_fixed_speed(driver_type: &BaseDriver, setting: &Setting) -> bool {
+        setting.speed_fixed.is_some()
+            && !(setting.channel_name == "pump" && PumpMode::is_supported(driver_type))
+    }
+
+    /// Sets the fixed speeds of several channels of the same device with a single request,
+    /// so that liqctld only needs to take the device lock once.
+    async fn set_fixed_speeds(&self, settings: &[&Setting], device_lock: &DeviceLock) -> Result<()> {
+        let device = device_lock.read().await;
+        let type_index = device.type_index;
+        let uid = device.uid.clone();
+        let mut speeds = Vec::with_capacity(settings.len());
+        for setting in settings {
+            let duty = setting.speed_fixed.with_context(|| "speed_fixed should be present")?;
+            if let Some(kernel_driver) = self.kernel_driver_for(&uid, &setting.channel_name) {
+                kernel_driver.set_duty(&setting.channel_name, duty).await
+                    .with_context(|| format!("Setting fixed speeds for Liquidctl Device #{}: {}", type_index, uid))?;
+                continue;
+            }
+            speeds.push(FixedSpeedRequest {
+                channel: setting.channel_name.clone(),
+                duty,
+            });
+        }
+        if speeds.is_empty() {
+            return Ok(());
+        }
+        self.client.borrow()
+            .put(LIQCTLD_FIXED_SPEED_BATCH
+                .replace("{}", type_index.to_string().as_str())
+            )
+            .with_deadline(CONTROL_DEADLINE)
+            .json(&FixedSpeedBatchRequest { speeds })
+            .send().await?
+            .error_for_status()
+            .map(|_| ())  // ignore successful result
+            .with_context(|| format!("Setting fixed speeds for Liquidctl Device #{}: {}", type_index, uid))
+    }
+
     async fn set_speed_profile(&self, setting: &Setting, device_lock: &DeviceLock) -> Result<()> {
         let device = device_lock.read().await;
         let type_index = device.type_index;
@@ -353,6 +450,7 @@ impl LiquidctlRepo {
             .put(LIQCTLD_SPEED_PROFILE
                 .replace("{}", type_index.to_string().as_str())
             )
+            .with_deadline(CONTROL_DEADLINE)
             .json(&SpeedProfileRequest {
                 channel: setting.channel_name.clone(),
                 profile,
@@ -394,6 +492,7 @@ impl LiquidctlRepo {
             .put(LIQCTLD_COLOR
                 .replace("{}", type_index.to_string().as_str())
             )
+            .with_deadline(LIGHTING_DEADLINE)
             .json(&ColorRequest {
                 channel: setting.channel_name.clone(),
                 mode,
@@ -408,72 +507,84 @@ impl LiquidctlRepo {
             .with_context(|| format!("Setting Lighting for Liquidctl Device #{}: {}", type_index, uid))
     }
 
+    /// Marks a speed write for the device as in progress, until the returned guard is dropped.
+    fn start_control_write(&self, device_uid: &UID) -> Option<ControlWriteGuard> {
+        self.pending_control_writes.get(device_uid).map(|pending_writes| {
+            pending_writes.fetch_add(1, Ordering::SeqCst);
+            ControlWriteGuard { pending_writes }
+        })
+    }
+
+    /// Only the screen settings that differ from the last applied state of the channel are sent,
+    /// together in one liqctld request that is executed back to back on the device.
     async fn set_screen(&self, setting: &Setting, device_lock: &DeviceLock) -> Result<()> {
         let device = device_lock.read().await;
         let type_index = device.type_index;
         let uid = device.uid.clone();
         let lcd_settings = setting.lcd.as_ref()
             .with_context(|| "LcdSettings should be present")?;
-        // We set several settings at once for lcd/screen settings
-        if let Some(brightness) = lcd_settings.brightness {
-            if let Err(err) = self.send_screen_request(
-                &ScreenRequest {
-                    channel: setting.channel_name.clone(),
-                    mode: "brightness".to_string(),
-                    value: Some(brightness.to_string()),  // liquidctl handles conversion to int
-                }, &type_index, &uid,
-            ).await { error!("Error setting lcd/screen brightness {} | {}", brightness, err); }
-            // we don't abort if there are brightness or orientation setting errors
+        let content = Self::screen_content(lcd_settings).await?;
+        let state_key = (uid.clone(), setting.channel_name.clone());
+        // the state is taken out while applying, so that a failed request leaves it unknown
+        let current_state = self.screen_states.write().await
+            .remove(&state_key)
+            .unwrap_or_default();
+        let mut desired_state = current_state.desired(lcd_settings, content);
+        let changes = current_state.changes_to(&desired_state);
+        if changes.is_empty() {
+            debug!("LCD screen settings for Liquidctl Device #{} are unchanged", type_index);
+            self.screen_states.write().await.insert(state_key, desired_state);
+            return Ok(());
         }
-        if let Some(orientation) = lcd_settings.orientation {
-            if let Err(err) = self.send_screen_request(
-                &ScreenRequest {
-                    channel: setting.channel_name.clone(),
-                    mode: "orientation".to_string(),
-                    value: Some(orientation.to_string()),  // liquidctl handles conversion to int
-                }, &type_index, &uid,
-            ).await { error!("Error setting lcd/screen orientation {} | {}", orientation, err); }
-            // we don't abort if there are brightness or orientation setting errors
+        let screens = changes.into_iter()
+            .map(|change| ScreenRequest {
+                channel: setting.channel_name.clone(),
+                mode: change.mode,
+                value: change.value,
+            })
+            .collect();
+        let batch_response = self.client.borrow()
+            .put(LIQCTLD_SCREEN_BATCH
+                .replace("{}", type_index.to_string().as_str())
+            )
+            .with_deadline(SCREEN_DEADLINE)
+            .json(&ScreenBatchRequest { screens })
+            .send().await?
+            .error_for_status()
+            .with_context(|| format!("Setting screen for Liquidctl Device #{}: {}", type_index, uid))?
+            .json::<ScreenBatchResponse>().await?;
+        // we don't abort if there are brightness or orientation setting errors
+        for failed_mode in batch_response.failed_modes {
+            error!("Error setting lcd/screen {} for Liquidctl Device #{}", failed_mode, type_index);
+            desired_state.forget(&failed_mode);
         }
+        self.screen_states.write().await.insert(state_key, desired_state);
+        Ok(())
+    }
+
+    async fn screen_content(lcd_settings: &LcdSettings) -> Result<Option<ScreenContent>> {
         if lcd_settings.mode == "image" {
             if let Some(image_file) = &lcd_settings.image_file_processed {
-                let mode = if image_file.contains(".gif") {  // tmp image is pre-processed
-                    "gif".to_string()
-                } else {
-                    "static".to_string()
-                };
-                self.send_screen_request(
-                    &ScreenRequest {
-                        channel: setting.channel_name.clone(),
-                        mode,
-                        value: Some(image_file.clone()),
-                    }, &type_index, &uid,
-                ).await.with_context(|| "Setting lcd/screen 'image/gif'")?;
+                let image_contents = tokio::fs::read(image_file).await
+                    .with_context(|| format!("Reading processed LCD image: {}", image_file))?;
+                return Ok(Some(ScreenContent::image(image_file, &image_contents)));
             }
         } else if lcd_settings.mode == "liquid" {
-            self.send_screen_request(
-                &ScreenRequest {
-                    channel: setting.channel_name.clone(),
-                    mode: lcd_settings.mode.clone(),
-                    value: None,
-                }, &type_index, &uid,
-            ).await.with_context(|| "Setting lcd/screen 'liquid' mode")?;
+            return Ok(Some(ScreenContent::Liquid));
         }
-        Ok(())
+        Ok(None)
     }
+}
 
-    async fn send_screen_request(
-        &self, screen_request: &ScreenRequest, type_index: &u8, uid: &String,
-    ) -> Result<()> {
-        self.client.borrow()
-            .put(LIQCTLD_SCREEN
-                .replace("{}", type_index.to_string().as_str())
-            )
-            .json(screen_request)
-            .send().await?
-            .error_for_status()
-            .map(|_| ())  // ignore successful result
-            .with_context(|| format!("Setting screen for Liquidctl Device #{}: {}", type_index, uid))
+pub trait WithDeadline {
+    fn with_deadline(self, deadline: Duration) -> Self;
+}
+
+impl WithDeadline for RequestBuilder {
+    /// Sends the time budget along with the request, so that liqctld can drop the job once nobody waits for it.
+    fn with_deadline(self, deadline: Duration) -> Self {
+        self.header(LIQCTLD_DEADLINE_HEADER, deadline.as_millis().to_string())
+            .timeout(deadline + DEADLINE_RESPONSE_MARGIN)
     }
 }
 
@@ -510,14 +621,30 @@ impl Repository for LiquidctlRepo {
     /// This works differently than by other repositories, because we preload the status in a
     /// liqctld_update_client queue so we don't lock the repositories for long periods of time.
     /// This keeps the response time for UI Device Status calls nice and low.
+    /// Devices with a kernel driver are read directly from sysfs instead,
+    /// and devices with a hidraw reader use the last status report they pushed,
+    /// until the reports stop and liqctld takes over for good.
     async fn update_statuses(&self) -> Result<()> {
-        for device_lock in self.devices.values() {
+        for (device_uid, device_lock) in self.devices.iter() {
             let status = {
                 let device = device_lock.read().await;
-                let lc_status = self.liqctld_update_client
-                    // needs write access to queues and will essentially block if
-                    // updates are stacked due to device latency
-                    .get_update_for_device(&device.type_index).await;
+                let lc_status = if let Some(kernel_driver) = self.kernel_drivers.get(device_uid) {
+                    Ok(kernel_driver.status().await)
+                } else if let Some(lc_status) = self.hidraw_readers.get(device_uid)
+                    .and_then(|hidraw_reader| hidraw_reader.latest_status()) {
+                    Ok(lc_status)
+                } else {
+                    if let Some(hidraw_reader) = self.hidraw_readers.get(device_uid) {
+                        if hidraw_reader.is_broken() && hidraw_reader.start_fallback() {
+                            // status is available again from the next preload on
+                            self.liqctld_update_client.create_update_queue(&device.type_index).await;
+                        }
+                    }
+                    self.liqctld_update_client
+                        // needs write access to queues and will essentially block if
+                        // updates are stacked due to device latency
+                        .get_update_for_device(&device.type_index).await
+                };
                 if let Err(err) = lc_status {
                     error!("{}", err);
                     continue;
@@ -538,6 +665,11 @@ impl Repository for LiquidctlRepo {
     }
 
     async fn shutdown(&self) -> Result<()> {
+        for kernel_driver in self.kernel_drivers.values() {
+            if let Err(err) = kernel_driver.reset().await {
+                error!("Error resetting kernel driver at {:?}: {}", kernel_driver.path(), err);
+            }
+        }
         let quit_response = self.client
             .post(LIQCTLD_QUIT)
             .send().await?
@@ -556,8 +688,10 @@ impl Repository for LiquidctlRepo {
             .with_context(|| format!("Device UID not found! {}", device_uid))?;
         info!("Applying device: {} settings: {:?}", device_uid, setting);
         if setting.speed_fixed.is_some() {
+            let _control_write = self.start_control_write(device_uid);
             self.set_fixed_speed(setting, device_lock).await
         } else if setting.speed_profile.is_some() {
+            let _control_write = self.start_control_write(device_uid);
             self.set_speed_profile(setting, device_lock).await
         } else if setting.lighting.is_some() {
             self.set_color(setting, device_lock).await
@@ -568,6 +702,64 @@ impl Repository for LiquidctlRepo {
         }
     }
 
+    /// Plain fixed speeds for multiple channels of the same device are combined into one
+    /// liqctld request. Everything else is applied individually.
+    async fn apply_settings_batch(&self, settings: &[(UID, Setting)]) -> Vec<Result<()>> {
+        let mut results: Vec<Option<Result<()>>> = settings.iter().map(|_| None).collect();
+        let mut fixed_speeds_per_device: HashMap<&UID, Vec<usize>> = HashMap::new();
+        for (position, (device_uid, setting)) in settings.iter().enumerate() {
+            if let Some(device_lock) = self.devices.get(device_uid) {
+                let driver_type = device_lock.read().await.lc_info.as_ref()
+                    .expect("lc_info for LC Device should always be present")
+                    .driver_type.clone();
+                if Self::is_plain_fixed_speed(&driver_type, setting) {
+                    fixed_speeds_per_device.entry(device_uid).or_default().push(position);
+                    continue;
+                }
+            }
+            results[position] = Some(self.apply_setting(device_uid, setting).await);
+        }
+        for (device_uid, positions) in fixed_speeds_per_device {
+            if positions.len() == 1 {
+                results[positions[0]] = Some(self.apply_setting(device_uid, &settings[positions[0]].1).await);
+                continue;
+            }
+            let device_settings: Vec<&Setting> = positions.iter()
+                .map(|position| &settings[*position].1)
+                .collect();
+            info!("Applying device: {} settings: {:?}", device_uid, device_settings);
+            let device_lock = self.devices.get(device_uid)
+                .expect("Device should be present as it was checked above");
+            let batch_result = {
+                let _control_write = self.start_control_write(device_uid);
+                self.set_fixed_speeds(&device_settings, device_lock).await
+            };
+            for position in positions {
+                results[position] = Some(match &batch_result {
+                    Ok(_) => Ok(()),
+                    Err(err) => Err(anyhow!("{}", err)),
+                });
+            }
+        }
+        results.into_iter()
+            .map(|result| result.unwrap_or_else(|| Err(anyhow!("Setting was not applied"))))
+            .collect()
+    }
+
+    /// Lighting frames are dropped while a speed write to the same device is in progress,
+    /// so that they never hold up cooling commands in the device's liqctld queue.
+    async fn apply_lighting_frame(&self, device_uid: &UID, setting: &Setting) -> Result<bool> {
+        let device_lock = self.devices.get(device_uid)
+            .with_context(|| format!("Device UID not found! {}", device_uid))?;
+        let has_pending_control_writes = self.pending_control_writes.get(device_uid)
+            .map_or(false, |pending_writes| pending_writes.load(Ordering::SeqCst) > 0);
+        if has_pending_control_writes {
+            return Ok(false);
+        }
+        debug!("Applying device: {} lighting frame: {:?}", device_uid, setting);
+        self.set_color(setting, device_lock).await.map(|_| true)
+    }
+
     async fn reinitialize_devices(&self) {
         let no_init = match self.config.get_settings().await {
             Ok(settings) => settings.no_init,
@@ -579,6 +771,19 @@ impl Repository for LiquidctlRepo {
         if !no_init {
             self.call_reinitialize_concurrently().await
         }
+        // screens are sent again in full, as reinitializing can reset them
+        self.screen_states.write().await.clear();
+        self.pump_modes.write().await.clear();
+    }
+}
+
+struct ControlWriteGuard<'a> {
+    pending_writes: &'a AtomicUsize,
+}
+
+impl Drop for ControlWriteGuard<'_> {
+    fn drop(&mut self) {
+        self.pending_writes.fetch_sub(1, Ordering::SeqCst);
     }
 }
 
@@ -638,6 +843,11 @@ struct FixedSpeedRequest {
     duty: u8,
 }
 
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct FixedSpeedBatchRequest {
+    speeds: Vec<FixedSpeedRequest>,
+}
+
 #[derive(Debug, Clone, Serialize, Deserialize)]
 struct SpeedProfileRequest {
     channel: String,
@@ -661,3 +871,13 @@ struct ScreenRequest {
     mode: String,
     value: Option<String>,
 }
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct ScreenBatchRequest {
+    screens: Vec<ScreenRequest>,
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct ScreenBatchResponse {
+    failed_modes: Vec<String>,
+}
@@ -19,5 +19,9 @@
 pub mod base_driver;
 pub mod liquidctl_repo;
 pub mod liqctld_client;
+pub mod supported_devices;
 mod device_mapper;
-mod supported_devices;
+mod hidraw_status;
+mod kernel_driver;
+mod pump_mode;
+mod screen_state;
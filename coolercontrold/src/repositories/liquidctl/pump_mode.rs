@@ -0,0 +1,158 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use crate::repositories::liquidctl::base_driver::BaseDriver;
+
+/// How far a duty has to cross a bucket limit before the pump mode changes,
+/// so that a duty hovering around a limit doesn't reinitialize the device on every change.
+const PUMP_MODE_HYSTERESIS: u8 = 3;
+
+/// Some drivers have no fixed pump speeds, but a pump mode that is set through initialization.
+/// Duties are mapped to these modes in buckets.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+pub enum PumpMode {
+    Quiet,
+    Balanced,
+    Extreme,
+}
+
+impl PumpMode {
+    /// Returns the pump mode for the given duty, or None if the driver's pump is not set through pump modes.
+    /// Starting from the current mode, the duty has to cross a bucket limit by the hysteresis to change modes.
+    pub fn for_duty(driver_type: &BaseDriver, duty: u8, current: Option<PumpMode>) -> Option<PumpMode> {
+        let bucket = Self::bucket(driver_type, duty)?;
+        let mode = match current {
+            Some(current) if bucket > current => Self::bucket(driver_type, duty.saturating_sub(PUMP_MODE_HYSTERESIS))?
+                .max(current),
+            Some(current) if bucket < current => Self::bucket(driver_type, duty.saturating_add(PUMP_MODE_HYSTERESIS))?
+                .min(current),
+            _ => bucket,
+        };
+        Some(mode)
+    }
+
+    /// Whether the driver's pump is set through pump modes
+    pub fn is_supported(driver_type: &BaseDriver) -> bool {
+        Self::bucket_limits(driver_type).is_some()
+    }
+
+    /// The duty below which the pump is quiet and the duty above which it is extreme
+    fn bucket_limits(driver_type: &BaseDriver) -> Option<(u8, u8)> {
+        match driver_type {
+            BaseDriver::HydroPlatinum => Some((56, 75)),  // limits from tested Hydro H150i Pro XT
+            BaseDriver::HydroPro => Some((34, 66)),
+            _ => None,
+        }
+    }
+
+    fn bucket(driver_type: &BaseDriver, duty: u8) -> Option<PumpMode> {
+        let (quiet_below, extreme_above) = Self::bucket_limits(driver_type)?;
+        let mode = if duty < quiet_below {
+            PumpMode::Quiet
+        } else if duty > extreme_above {
+            PumpMode::Extreme
+        } else {
+            PumpMode::Balanced
+        };
+        Some(mode)
+    }
+
+    /// The name liquidctl uses for this pump mode
+    pub fn name(&self, driver_type: &BaseDriver) -> &'static str {
+        match self {
+            PumpMode::Quiet => "quiet",
+            PumpMode::Balanced => "balanced",
+            PumpMode::Extreme if driver_type == &BaseDriver::HydroPro => "performance",
+            PumpMode::Extreme => "extreme",
+        }
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn unknown_mode_uses_plain_buckets() {
+        // given:
+        let driver_type = BaseDriver::HydroPlatinum;
+
+        // when:
+        let modes: Vec<Option<PumpMode>> = [0, 55, 56, 75, 76, 100].iter()
+            .map(|duty| PumpMode::for_duty(&driver_type, *duty, None))
+            .collect();
+
+        // then:
+        assert_eq!(modes, vec![
+            Some(PumpMode::Quiet), Some(PumpMode::Quiet), Some(PumpMode::Balanced),
+            Some(PumpMode::Balanced), Some(PumpMode::Extreme), Some(PumpMode::Extreme),
+        ]);
+    }
+
+    #[test]
+    fn other_drivers_have_no_pump_mode() {
+        // when:
+        let mode = PumpMode::for_duty(&BaseDriver::Kraken2, 50, None);
+
+        // then:
+        assert_eq!(mode, None);
+        assert!(!PumpMode::is_supported(&BaseDriver::Kraken2));
+        assert!(PumpMode::is_supported(&BaseDriver::HydroPro));
+    }
+
+    #[test]
+    fn small_crossings_keep_the_current_mode() {
+        // given:
+        let driver_type = BaseDriver::HydroPlatinum;
+
+        // when:
+        let from_balanced_down = PumpMode::for_duty(&driver_type, 54, Some(PumpMode::Balanced));
+        let from_quiet_up = PumpMode::for_duty(&driver_type, 58, Some(PumpMode::Quiet));
+        let from_extreme_down = PumpMode::for_duty(&driver_type, 73, Some(PumpMode::Extreme));
+
+        // then:
+        assert_eq!(from_balanced_down, Some(PumpMode::Balanced));
+        assert_eq!(from_quiet_up, Some(PumpMode::Quiet));
+        assert_eq!(from_extreme_down, Some(PumpMode::Extreme));
+    }
+
+    #[test]
+    fn crossings_beyond_the_hysteresis_change_the_mode() {
+        // given:
+        let driver_type = BaseDriver::HydroPro;
+
+        // when:
+        let from_balanced_down = PumpMode::for_duty(&driver_type, 30, Some(PumpMode::Balanced));
+        let from_quiet_up = PumpMode::for_duty(&driver_type, 37, Some(PumpMode::Quiet));
+        let from_quiet_to_top = PumpMode::for_duty(&driver_type, 100, Some(PumpMode::Quiet));
+
+        // then:
+        assert_eq!(from_balanced_down, Some(PumpMode::Quiet));
+        assert_eq!(from_quiet_up, Some(PumpMode::Balanced));
+        assert_eq!(from_quiet_to_top, Some(PumpMode::Extreme));
+    }
+
+    #[test]
+    fn liquidctl_names_per_driver() {
+        // then:
+        assert_eq!(PumpMode::Extreme.name(&BaseDriver::HydroPlatinum), "extreme");
+        assert_eq!(PumpMode::Extreme.name(&BaseDriver::HydroPro), "performance");
+        assert_eq!(PumpMode::Quiet.name(&BaseDriver::HydroPro), "quiet");
+    }
+}
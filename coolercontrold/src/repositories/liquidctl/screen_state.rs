@@ -0,0 +1,200 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use sha2::{Digest, Sha256};
+
+use crate::setting::LcdSettings;
+
+/// The last successfully applied state of an LCD screen channel.
+/// A value of None means the state on the device is unknown and is sent again on the next apply.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct ScreenState {
+    brightness: Option<u8>,
+    orientation: Option<u16>,
+    content: Option<ScreenContent>,
+}
+
+/// What is displayed on the screen
+#[derive(Debug, Clone, PartialEq)]
+pub enum ScreenContent {
+    /// A pre-processed static or gif image, identified by the hash of the file contents, so that
+    /// re-applying the same image is free, even when the file was rewritten in between.
+    Image { mode: String, file: String, hash: Vec<u8> },
+    Liquid,
+}
+
+/// A single liqctld screen change, in the form of liquidctl's set_screen(mode, value)
+#[derive(Debug, Clone, PartialEq)]
+pub struct ScreenChange {
+    pub mode: String,
+    pub value: Option<String>,
+}
+
+impl ScreenContent {
+    pub fn image(file: &str, contents: &[u8]) -> Self {
+        let mode = if file.contains(".gif") {  // tmp image is pre-processed
+            "gif".to_string()
+        } else {
+            "static".to_string()
+        };
+        ScreenContent::Image {
+            mode,
+            file: file.to_string(),
+            hash: Sha256::digest(contents).to_vec(),
+        }
+    }
+}
+
+impl ScreenState {
+    /// Returns the state the screen should have after applying the given settings.
+    /// Settings that are not set keep their current state.
+    pub fn desired(&self, lcd_settings: &LcdSettings, content: Option<ScreenContent>) -> Self {
+        ScreenState {
+            brightness: lcd_settings.brightness.or(self.brightness),
+            orientation: lcd_settings.orientation.or(self.orientation),
+            content: content.or_else(|| self.content.clone()),
+        }
+    }
+
+    /// Returns only the changes needed to get from this state to the desired state,
+    /// in the order they should be applied.
+    pub fn changes_to(&self, desired: &ScreenState) -> Vec<ScreenChange> {
+        let mut changes = Vec::new();
+        if desired.brightness != self.brightness {
+            if let Some(brightness) = desired.brightness {
+                changes.push(ScreenChange {
+                    mode: "brightness".to_string(),
+                    value: Some(brightness.to_string()),  // liquidctl handles conversion to int
+                });
+            }
+        }
+        if desired.orientation != self.orientation {
+            if let Some(orientation) = desired.orientation {
+                changes.push(ScreenChange {
+                    mode: "orientation".to_string(),
+                    value: Some(orientation.to_string()),  // liquidctl handles conversion to int
+                });
+            }
+        }
+        if desired.content != self.content {
+            match &desired.content {
+                Some(ScreenContent::Image { mode, file, .. }) => changes.push(ScreenChange {
+                    mode: mode.clone(),
+                    value: Some(file.clone()),
+                }),
+                Some(ScreenContent::Liquid) => changes.push(ScreenChange {
+                    mode: "liquid".to_string(),
+                    value: None,
+                }),
+                None => {}
+            }
+        }
+        changes
+    }
+
+    /// Forgets the state of a change that failed, so that it is sent again next time.
+    pub fn forget(&mut self, mode: &str) {
+        match mode {
+            "brightness" => self.brightness = None,
+            "orientation" => self.orientation = None,
+            _ => self.content = None,
+        }
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn lcd_settings(brightness: Option<u8>, orientation: Option<u16>) -> LcdSettings {
+        LcdSettings {
+            mode: "image".to_string(),
+            brightness,
+            orientation,
+            image_file_src: None,
+            image_file_processed: None,
+            colors: vec![],
+        }
+    }
+
+    #[test]
+    fn unknown_state_sends_everything_in_order() {
+        // given:
+        let current = ScreenState::default();
+        let content = ScreenContent::image("/tmp/image.png", b"image");
+
+        // when:
+        let desired = current.desired(&lcd_settings(Some(50), Some(90)), Some(content));
+        let changes = current.changes_to(&desired);
+
+        // then:
+        let modes: Vec<&str> = changes.iter().map(|change| change.mode.as_str()).collect();
+        assert_eq!(modes, vec!["brightness", "orientation", "static"]);
+        assert_eq!(changes[2].value, Some("/tmp/image.png".to_string()));
+    }
+
+    #[test]
+    fn unchanged_image_is_free() {
+        // given:
+        let settings = lcd_settings(Some(50), Some(90));
+        let applied = ScreenState::default()
+            .desired(&settings, Some(ScreenContent::image("/tmp/image.gif", b"image")));
+
+        // when:
+        let desired = applied.desired(&settings, Some(ScreenContent::image("/tmp/image.gif", b"image")));
+
+        // then:
+        assert!(applied.changes_to(&desired).is_empty());
+    }
+
+    #[test]
+    fn only_changed_fields_are_sent() {
+        // given:
+        let applied = ScreenState::default()
+            .desired(&lcd_settings(Some(50), Some(90)), Some(ScreenContent::image("/tmp/image.bmp", b"frame 1")));
+
+        // when:
+        let desired = applied.desired(
+            &lcd_settings(Some(80), None), Some(ScreenContent::image("/tmp/image.bmp", b"frame 2")),
+        );
+        let changes = applied.changes_to(&desired);
+
+        // then:
+        assert_eq!(changes, vec![
+            ScreenChange { mode: "brightness".to_string(), value: Some("80".to_string()) },
+            ScreenChange { mode: "static".to_string(), value: Some("/tmp/image.bmp".to_string()) },
+        ]);
+    }
+
+    #[test]
+    fn forgotten_change_is_sent_again() {
+        // given:
+        let settings = lcd_settings(Some(50), None);
+        let mut applied = ScreenState::default().desired(&settings, Some(ScreenContent::Liquid));
+
+        // when:
+        applied.forget("brightness");
+        let changes = applied.changes_to(&applied.desired(&settings, Some(ScreenContent::Liquid)));
+
+        // then:
+        assert_eq!(changes, vec![
+            ScreenChange { mode: "brightness".to_string(), value: Some("50".to_string()) },
+        ]);
+    }
+}
\ No newline at end of file
@@ -24,6 +24,7 @@ use lazy_static::lazy_static;
 use regex::Regex;
 
 use crate::device::{ChannelStatus, DeviceInfo, LightingMode, LightingModeType, Status, TempStatus};
+use crate::lighting_scheduler::{BREATHING_MODE, COLOR_CYCLE_MODE, FRAME_MODE, TEMP_GRADIENT_MODE};
 use crate::repositories::liquidctl::base_driver::BaseDriver;
 use crate::repositories::liquidctl::liquidctl_repo::DeviceProperties;
 
@@ -329,8 +330,45 @@ pub trait DeviceSupport: Debug + Sync + Send {
                 }
             );
         }
+        let supports_fixed_color = channel_lighting_modes.iter()
+            .any(|lighting_mode| lighting_mode.name == FRAME_MODE && lighting_mode.max_colors > 0);
+        if supports_fixed_color {  // software effects are sent frame by frame as fixed colors
+            channel_lighting_modes.extend(self.custom_lighting_modes());
+        }
         channel_lighting_modes
     }
+
+    fn custom_lighting_modes(&self) -> Vec<LightingMode> {
+        vec![
+            LightingMode {
+                name: COLOR_CYCLE_MODE.to_string(),
+                frontend_name: "Color Cycle (Software)".to_string(),
+                min_colors: 0,
+                max_colors: 4,
+                speed_enabled: true,
+                backward_enabled: true,
+                type_: LightingModeType::Custom,
+            },
+            LightingMode {
+                name: BREATHING_MODE.to_string(),
+                frontend_name: "Breathing (Software)".to_string(),
+                min_colors: 1,
+                max_colors: 1,
+                speed_enabled: true,
+                backward_enabled: false,
+                type_: LightingModeType::Custom,
+            },
+            LightingMode {
+                name: TEMP_GRADIENT_MODE.to_string(),
+                frontend_name: "Temperature Gradient (Software)".to_string(),
+                min_colors: 2,
+                max_colors: 2,
+                speed_enabled: false,
+                backward_enabled: false,
+                type_: LightingModeType::Custom,
+            },
+        ]
+    }
 }
 
 /// Tests
@@ -105,6 +105,16 @@ impl DeviceSupport for KrakenZ3Support {
                         colors_max: 0,
                         type_: LcdModeType::Liquidctl,
                     },
+                    LcdMode {
+                        name: "sensors".to_string(),
+                        frontend_name: "Sensor Gauge".to_string(),
+                        brightness: true,
+                        orientation: true,
+                        image: false,
+                        colors_min: 0, // text and background colors, white on black by default
+                        colors_max: 2,
+                        type_: LcdModeType::Custom,
+                    },
                 ],
                 ..Default::default()
             },
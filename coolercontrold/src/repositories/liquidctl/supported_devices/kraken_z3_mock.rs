@@ -47,3 +47,34 @@ impl DeviceSupport for KrakenZ3MockSupport {
         self.kraken_z3_support.get_color_channel_modes(_channel_name)
     }
 }
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use crate::device::LcdModeType;
+
+    use super::*;
+
+    #[test]
+    fn mock_offers_daemon_rendered_lcd_mode() {
+        // given:
+        let device_props = DeviceProperties {
+            speed_channels: vec!["pump".to_string(), "fan".to_string()],
+            color_channels: vec!["external".to_string()],
+            supports_cooling: Some(true),
+            supports_cooling_profiles: Some(true),
+            supports_lighting: Some(true),
+            led_count: None,
+        };
+
+        // when:
+        let info = KrakenZ3MockSupport::new().extract_info(&1, &device_props);
+
+        // then:
+        let lcd_modes = &info.channels["lcd"].lcd_modes;
+        let sensors_mode = lcd_modes.iter().find(|lcd_mode| lcd_mode.name == "sensors").unwrap();
+        assert_eq!(sensors_mode.type_, LcdModeType::Custom);
+        assert!(sensors_mode.brightness && sensors_mode.orientation);
+        assert_eq!(sensors_mode.colors_max, 2);
+    }
+}
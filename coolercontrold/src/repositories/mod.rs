@@ -20,5 +20,8 @@ pub mod repository;
 pub mod liquidctl;
 pub mod hwmon;
 pub mod cpu_repo;
+pub mod cpu_power;
 pub mod gpu_repo;
+pub mod nvidia_settings;
+pub mod amd_gpu_metrics;
 pub mod composite_repo;
@@ -0,0 +1,331 @@
+/*
+ * CoolerControl - monitor and control your cooling and other devices
+ * Copyright (c) 2022  Guy Boldon
+ * |
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * |
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * |
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+use std::collections::HashSet;
+
+use anyhow::{anyhow, Result};
+use log::{debug, info};
+use tokio::process::Command;
+use tokio::sync::RwLock;
+
+const NVIDIA_SETTINGS_COMMAND: &str = "nvidia-settings";
+
+/// A single pending nvidia-settings change.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum NvidiaWrite {
+    /// Take manual control of the GPU's fans (if not already held) and set the fan duty.
+    Duty { gpu_index: u8, fan_index: u8, duty: u8 },
+    /// Hand fan control back to the driver.
+    Reset { gpu_index: u8 },
+}
+
+/// Collects Nvidia fan changes and applies them with a single nvidia-settings invocation.
+/// Each nvidia-settings call starts a new X client, which can take hundreds of milliseconds,
+/// so we combine all changes for all GPUs and fans into one call with multiple `-a` arguments.
+/// We also keep track of which GPUs we already hold manual fan control for, so that
+/// `GPUFanControlState=1` is only sent when needed.
+pub struct NvidiaSettingsBatcher {
+    command: String,
+    gpus_under_control: RwLock<HashSet<u8>>,
+}
+
+impl NvidiaSettingsBatcher {
+    pub fn new() -> Self {
+        Self::with_command(NVIDIA_SETTINGS_COMMAND)
+    }
+
+    /// Allows using a different nvidia-settings binary, i.e. a stub for testing.
+    pub fn with_command(command: &str) -> Self {
+        Self {
+            command: command.to_string(),
+            gpus_under_control: RwLock::new(HashSet::new()),
+        }
+    }
+
+    /// Applies all the given writes in one nvidia-settings call.
+    /// If multiple writes are given for the same fan, the last one wins.
+    pub async fn apply(&self, writes: &[NvidiaWrite]) -> Result<()> {
+        if writes.is_empty() {
+            return Ok(());
+        }
+        let args = self.build_args(writes).await;
+        if args.is_empty() {
+            return Ok(());
+        }
+        debug!("Nvidia-settings batched arguments: {:?}", args);
+        match self.send_args_to_nvidia_settings(&args).await {
+            Ok(_) => {
+                self.update_control_state(writes).await;
+                Ok(())
+            }
+            Err(err) => {
+                // the control state is unknown after an error, so we re-assert it next time.
+                self.gpus_under_control.write().await.clear();
+                Err(err)
+            }
+        }
+    }
+
+    /// The driver hands fan control back when waking from sleep,
+    /// so the control state has to be sent again with the next duty.
+    pub async fn forget_control_state(&self) {
+        self.gpus_under_control.write().await.clear();
+    }
+
+    async fn build_args(&self, writes: &[NvidiaWrite]) -> Vec<String> {
+        let gpus_under_control = self.gpus_under_control.read().await;
+        let mut gpus_to_take_control = Vec::new();
+        let mut gpus_to_reset = Vec::new();
+        let mut fan_duties: Vec<(u8, u8)> = Vec::new();
+        for write in writes {
+            match write {
+                NvidiaWrite::Duty { gpu_index, fan_index, duty } => {
+                    gpus_to_reset.retain(|index| index != gpu_index);
+                    if !gpus_under_control.contains(gpu_index)
+                        && !gpus_to_take_control.contains(gpu_index) {
+                        gpus_to_take_control.push(*gpu_index);
+                    }
+                    fan_duties.retain(|(index, _)| index != fan_index);
+                    fan_duties.push((*fan_index, *duty));
+                }
+                NvidiaWrite::Reset { gpu_index } => {
+                    gpus_to_take_control.retain(|index| index != gpu_index);
+                    if !gpus_to_reset.contains(gpu_index) {
+                        gpus_to_reset.push(*gpu_index);
+                    }
+                }
+            }
+        }
+        let mut args = Vec::new();
+        for gpu_index in gpus_to_take_control {
+            args.push("-a".to_string());
+            args.push(format!("[gpu:{}]/GPUFanControlState=1", gpu_index));
+        }
+        for (fan_index, duty) in fan_duties {
+            args.push("-a".to_string());
+            args.push(format!("[fan:{}]/GPUTargetFanSpeed={}", fan_index, duty));
+        }
+        for gpu_index in gpus_to_reset {
+            args.push("-a".to_string());
+            args.push(format!("[gpu:{}]/GPUFanControlState=0", gpu_index));
+        }
+        args
+    }
+
+    async fn update_control_state(&self, writes: &[NvidiaWrite]) {
+        let mut gpus_under_control = self.gpus_under_control.write().await;
+        for write in writes {
+            match write {
+                NvidiaWrite::Duty { gpu_index, .. } => gpus_under_control.insert(*gpu_index),
+                NvidiaWrite::Reset { gpu_index } => gpus_under_control.remove(gpu_index),
+            };
+        }
+    }
+
+    /// Runs nvidia-settings directly, without a shell.
+    async fn send_args_to_nvidia_settings(&self, args: &[String]) -> Result<()> {
+        let output = Command::new(&self.command)
+            .args(args)
+            .output().await;
+        match output {
+            Ok(out) => if out.status.success() {
+                let out_std = String::from_utf8_lossy(&out.stdout).trim().to_owned();
+                let out_err = String::from_utf8_lossy(&out.stderr).trim().to_owned();
+                debug!("Nvidia-settings output: {}\n{}", out_std, out_err);
+                if out_err.is_empty() {
+                    info!("Nvidia-settings applied {} change(s)", args.len() / 2);
+                    Ok(())
+                } else {
+                    Err(anyhow!("Error trying to set nvidia fan speed settings: {}", out_err))
+                }
+            } else {
+                let out_err = String::from_utf8_lossy(&out.stderr).trim().to_owned();
+                Err(anyhow!("Error communicating with nvidia-settings: {}", out_err))
+            },
+            Err(err) => Err(anyhow!("Nvidia-settings not found: {}", err))
+        }
+    }
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::os::unix::fs::PermissionsExt;
+    use std::path::{Path, PathBuf};
+
+    use test_context::{AsyncTestContext, test_context};
+    use uuid::Uuid;
+
+    use super::*;
+
+    const TEST_BASE_PATH_STR: &str = "/tmp/coolercontrol-tests-";
+    const STUB_SCRIPT: &str = "#!/bin/sh\nprintf '%s\\n' \"$@\" >> \"$(dirname \"$0\")/argv\"\necho '--' >> \"$(dirname \"$0\")/argv\"\n";
+
+    struct NvidiaStubContext {
+        test_base_path: PathBuf,
+        stub_command: String,
+    }
+
+    #[async_trait::async_trait]
+    impl AsyncTestContext for NvidiaStubContext {
+        async fn setup() -> NvidiaStubContext {
+            let test_base_path = Path::new(
+                &(TEST_BASE_PATH_STR.to_string() + &Uuid::new_v4().to_string())
+            ).to_path_buf();
+            tokio::fs::create_dir_all(&test_base_path).await.unwrap();
+            let stub_path = test_base_path.join("nvidia-settings");
+            tokio::fs::write(&stub_path, STUB_SCRIPT.as_bytes()).await.unwrap();
+            tokio::fs::set_permissions(&stub_path, std::fs::Permissions::from_mode(0o755)).await.unwrap();
+            let stub_command = stub_path.to_str().unwrap().to_string();
+            NvidiaStubContext { test_base_path, stub_command }
+        }
+
+        async fn teardown(self) {
+            tokio::fs::remove_dir_all(&self.test_base_path).await.unwrap();
+        }
+    }
+
+    /// Returns the recorded argv for each invocation of the stub
+    async fn recorded_invocations(ctx: &NvidiaStubContext) -> Vec<Vec<String>> {
+        let recorded = tokio::fs::read_to_string(ctx.test_base_path.join("argv")).await
+            .unwrap_or_default();
+        recorded.split("--\n")
+            .filter(|invocation| !invocation.is_empty())
+            .map(|invocation| invocation.lines().map(|arg| arg.to_string()).collect())
+            .collect()
+    }
+
+    #[test_context(NvidiaStubContext)]
+    #[tokio::test]
+    async fn batch_multiple_gpus_in_one_call(ctx: &mut NvidiaStubContext) {
+        // given:
+        let batcher = NvidiaSettingsBatcher::with_command(&ctx.stub_command);
+        let writes = vec![
+            NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 40 },
+            NvidiaWrite::Duty { gpu_index: 1, fan_index: 1, duty: 55 },
+        ];
+
+        // when:
+        let result = batcher.apply(&writes).await;
+
+        // then:
+        assert!(result.is_ok());
+        let invocations = recorded_invocations(ctx).await;
+        assert_eq!(invocations.len(), 1);
+        assert_eq!(invocations[0], vec![
+            "-a", "[gpu:0]/GPUFanControlState=1",
+            "-a", "[gpu:1]/GPUFanControlState=1",
+            "-a", "[fan:0]/GPUTargetFanSpeed=40",
+            "-a", "[fan:1]/GPUTargetFanSpeed=55",
+        ]);
+    }
+
+    #[test_context(NvidiaStubContext)]
+    #[tokio::test]
+    async fn skip_control_state_when_already_held(ctx: &mut NvidiaStubContext) {
+        // given:
+        let batcher = NvidiaSettingsBatcher::with_command(&ctx.stub_command);
+        batcher.apply(&[NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 40 }]).await.unwrap();
+
+        // when:
+        let result = batcher.apply(&[NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 60 }]).await;
+
+        // then:
+        assert!(result.is_ok());
+        let invocations = recorded_invocations(ctx).await;
+        assert_eq!(invocations.len(), 2);
+        assert_eq!(invocations[1], vec!["-a", "[fan:0]/GPUTargetFanSpeed=60"]);
+    }
+
+    #[test_context(NvidiaStubContext)]
+    #[tokio::test]
+    async fn reset_releases_control(ctx: &mut NvidiaStubContext) {
+        // given:
+        let batcher = NvidiaSettingsBatcher::with_command(&ctx.stub_command);
+        batcher.apply(&[NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 40 }]).await.unwrap();
+        batcher.apply(&[NvidiaWrite::Reset { gpu_index: 0 }]).await.unwrap();
+
+        // when:
+        let result = batcher.apply(&[NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 50 }]).await;
+
+        // then:
+        assert!(result.is_ok());
+        let invocations = recorded_invocations(ctx).await;
+        assert_eq!(invocations.len(), 3);
+        assert_eq!(invocations[1], vec!["-a", "[gpu:0]/GPUFanControlState=0"]);
+        assert_eq!(invocations[2], vec![
+            "-a", "[gpu:0]/GPUFanControlState=1",
+            "-a", "[fan:0]/GPUTargetFanSpeed=50",
+        ]);
+    }
+
+    #[test_context(NvidiaStubContext)]
+    #[tokio::test]
+    async fn retake_control_after_forgetting_it(ctx: &mut NvidiaStubContext) {
+        // given:
+        let batcher = NvidiaSettingsBatcher::with_command(&ctx.stub_command);
+        batcher.apply(&[NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 40 }]).await.unwrap();
+
+        // when:
+        batcher.forget_control_state().await;
+        let result = batcher.apply(&[NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 60 }]).await;
+
+        // then:
+        assert!(result.is_ok());
+        let invocations = recorded_invocations(ctx).await;
+        assert_eq!(invocations[1], vec![
+            "-a", "[gpu:0]/GPUFanControlState=1",
+            "-a", "[fan:0]/GPUTargetFanSpeed=60",
+        ]);
+    }
+
+    #[test_context(NvidiaStubContext)]
+    #[tokio::test]
+    async fn last_duty_per_fan_wins(ctx: &mut NvidiaStubContext) {
+        // given:
+        let batcher = NvidiaSettingsBatcher::with_command(&ctx.stub_command);
+        let writes = vec![
+            NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 40 },
+            NvidiaWrite::Duty { gpu_index: 0, fan_index: 0, duty: 70 },
+        ];
+
+        // when:
+        let result = batcher.apply(&writes).await;
+
+        // then:
+        assert!(result.is_ok());
+        let invocations = recorded_invocations(ctx).await;
+        assert_eq!(invocations[0], vec![
+            "-a", "[gpu:0]/GPUFanControlState=1",
+            "-a", "[fan:0]/GPUTargetFanSpeed=70",
+        ]);
+    }
+
+    #[tokio::test]
+    async fn missing_binary_is_an_error() {
+        // given:
+        let batcher = NvidiaSettingsBatcher::with_command("/tmp/does_not_exist/nvidia-settings");
+
+        // when:
+        let result = batcher.apply(&[NvidiaWrite::Reset { gpu_index: 0 }]).await;
+
+        // then:
+        assert!(result.is_err());
+        assert!(result.unwrap_err().to_string().contains("Nvidia-settings not found"));
+    }
+}
\ No newline at end of file
@@ -47,6 +47,29 @@ pub trait Repository: Send + Sync {
 
     async fn apply_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()>;
 
+    /// Applies several settings at once, returning a result per setting in the same order.
+    /// Repositories that are able to combine hardware writes should override this,
+    /// otherwise each setting is applied one after another.
+    async fn apply_settings_batch(&self, settings: &[(UID, Setting)]) -> Vec<Result<()>> {
+        let mut results = Vec::with_capacity(settings.len());
+        for (device_uid, setting) in settings {
+            results.push(self.apply_setting(device_uid, setting).await);
+        }
+        results
+    }
+
+    /// Applies a single frame of a software lighting effect and returns whether it was applied.
+    /// Frames are disposable, so repositories can drop them in favor of cooling commands.
+    async fn apply_lighting_frame(&self, device_uid: &UID, setting: &Setting) -> Result<bool> {
+        self.apply_setting(device_uid, setting).await.map(|_| true)
+    }
+
+    /// Hands a speed profile over to the device, so that the device runs the curve itself,
+    /// and returns whether it was offloaded. Otherwise the profile has to be scheduled.
+    async fn offload_speed_profile(&self, _device_uid: &UID, _setting: &Setting) -> Result<bool> {
+        Ok(false)
+    }
+
     /// This is helpful/necessary after waking from sleep
     async fn reinitialize_devices(&self) {
         error!("Reinitializing Devices is not supported for this Repository")
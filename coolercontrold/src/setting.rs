@@ -25,7 +25,7 @@ use crate::device::UID;
 
 /// Setting is a passed struct used to apply various settings to a specific device.
 /// Usually only one specific lighting or speed setting is applied at a time.
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct Setting {
     pub channel_name: String,
 
@@ -38,6 +38,12 @@ pub struct Setting {
     /// The associated temperature source
     pub temp_source: Option<TempSource>,
 
+    /// An optional duty boost from a load or power signal, added to the speed profile duty
+    pub speed_feed_forward: Option<FeedForward>,
+
+    /// Holds a target temperature with a PID controller instead of following a speed profile
+    pub speed_pid: Option<PidSettings>,
+
     /// Settings for lighting
     pub lighting: Option<LightingSettings>,
 
@@ -59,6 +65,8 @@ impl Default for Setting {
             speed_fixed: None,
             speed_profile: None,
             temp_source: None,
+            speed_feed_forward: None,
+            speed_pid: None,
             lighting: None,
             lcd: None,
             pwm_mode: None,
@@ -67,7 +75,7 @@ impl Default for Setting {
     }
 }
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct LightingSettings {
     /// The lighting mode name
     pub mode: String,
@@ -82,7 +90,7 @@ pub struct LightingSettings {
     pub colors: Vec<(u8, u8, u8)>,
 }
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct TempSource {
     /// The internal name for this Temperature Source. Not the frontend_name or external_name
     pub temp_name: String,
@@ -91,7 +99,83 @@ pub struct TempSource {
     pub device_uid: UID,
 }
 
+/// A fan group lets many channels, also across devices, follow one speed profile and temp source.
+/// The profile is evaluated once per update and all member channels are set to the same duty.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct FanGroup {
+    /// The unique name of the group. eg: "front-intake"
+    pub name: String,
+
+    /// The channels that are controlled by this group
+    pub members: Vec<FanGroupMember>,
+
+    /// The profile temp/duty speeds to set. eg: [(20, 50), (25, 80)]
+    pub speed_profile: Vec<(u8, u8)>,
+
+    /// The associated temperature source
+    pub temp_source: TempSource,
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct FanGroupMember {
+    pub device_uid: UID,
+    pub channel_name: String,
+}
+
+/// A named set of channel settings, like "quiet" or "performance", that can be switched as a whole.
 #[derive(Debug, Clone, Serialize, Deserialize)]
+pub struct ProfileSet {
+    /// The unique name of the set. eg: "quiet"
+    pub name: String,
+
+    /// The channel settings of this set per device uid
+    pub settings: Vec<(UID, Setting)>,
+}
+
+/// Feed-forward lets fans react to load changes before the temperature follows.
+/// The signal is a load or power channel with values from 0-100, like "CPU Load" or "CPU Power".
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct FeedForward {
+    /// The associated device uid containing the signal channel
+    pub device_uid: UID,
+
+    /// The name of the load or power channel
+    pub channel_name: String,
+
+    /// The signal value under which no duty boost is applied. eg: 30 (%)
+    pub threshold: u8,
+
+    /// The duty to add per 1% of signal above the threshold. eg: 0.5
+    pub gain: f64,
+
+    /// The duty to add per 1% rise of the signal since the last status. eg: 1.0
+    pub rate_gain: f64,
+
+    /// The maximum duty boost. eg: 30 (%)
+    pub max_boost: u8,
+}
+
+/// Closed-loop control settings that hold the temp_source at a target temperature.
+/// The output duty is limited to the channel's min and max duty.
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
+pub struct PidSettings {
+    /// The temperature to hold. eg: 35.0
+    pub target_temp: f64,
+
+    /// The proportional gain, in duty per degree from the target
+    pub kp: f64,
+
+    /// The integral gain, in duty per degree-second from the target
+    pub ki: f64,
+
+    /// The derivative gain, in duty per degree/second change of the temperature
+    pub kd: f64,
+
+    /// The time constant in seconds of the derivative low-pass filter. eg: 2.0
+    pub derivative_filter: f64,
+}
+
+#[derive(Debug, Clone, PartialEq, Serialize, Deserialize)]
 pub struct LcdSettings {
     /// The Lcd mode name
     pub mode: String,
@@ -117,6 +201,7 @@ pub struct LcdSettings {
 pub struct CoolerControlSettings {
     pub apply_on_boot: bool,
     pub no_init: bool,
+    pub hidraw_status: bool,
     pub handle_dynamic_temps: bool,
     pub startup_delay: Duration,
     pub smoothing_level: u8,
@@ -20,15 +20,20 @@ use std::collections::{HashMap, VecDeque};
 use std::sync::Arc;
 
 use anyhow::{anyhow, Context, Result};
+use chrono::{DateTime, Local};
 use log::{debug, error, info};
 use serde::{Deserialize, Serialize};
 use tokio::sync::RwLock;
 
 use crate::{AllDevices, utils};
 use crate::config::Config;
-use crate::device::{DeviceType, UID};
+use crate::device::{DeviceType, Status, UID};
 use crate::device_commander::ReposByType;
-use crate::setting::Setting;
+use crate::lcd_scheduler::{LcdScheduler, SENSORS_MODE};
+use crate::lighting_scheduler::{is_effect_mode, LightingScheduler};
+use crate::pid_controller::PidController;
+use crate::setting::{FanGroup, FeedForward, ProfileSet, Setting, TempSource};
+use crate::utils::TempMovingAverage;
 
 const MAX_SAMPLE_SIZE: usize = 20;
 const APPLY_DUTY_THRESHOLD: u8 = 2;
@@ -44,22 +49,56 @@ pub struct SpeedScheduler {
     repos: ReposByType,
     scheduled_settings: RwLock<HashMap<UID, HashMap<String, Setting>>>,
     scheduled_settings_metadata: RwLock<HashMap<UID, HashMap<String, SettingMetadata>>>,
+    temp_source_averages: RwLock<HashMap<TempSourceKey, TempSourceAverage>>,
+    fan_groups: RwLock<HashMap<String, ScheduledFanGroup>>,
+    profile_sets: RwLock<HashMap<String, Arc<CompiledProfileSet>>>,
+    active_profile_set: RwLock<Option<Arc<CompiledProfileSet>>>,
+    lcd_scheduler: Arc<LcdScheduler>,
+    lighting_scheduler: Arc<LightingScheduler>,
     config: Arc<Config>,
 }
 
 impl SpeedScheduler {
-    pub fn new(all_devices: AllDevices, repos: ReposByType, config: Arc<Config>) -> Self {
+    pub fn new(
+        all_devices: AllDevices,
+        repos: ReposByType,
+        lcd_scheduler: Arc<LcdScheduler>,
+        lighting_scheduler: Arc<LightingScheduler>,
+        config: Arc<Config>,
+    ) -> Self {
         Self {
             all_devices,
             repos,
             scheduled_settings: RwLock::new(HashMap::new()),
             scheduled_settings_metadata: RwLock::new(HashMap::new()),
+            temp_source_averages: RwLock::new(HashMap::new()),
+            fan_groups: RwLock::new(HashMap::new()),
+            profile_sets: RwLock::new(HashMap::new()),
+            active_profile_set: RwLock::new(None),
+            lcd_scheduler,
+            lighting_scheduler,
             config,
         }
     }
 
     pub async fn schedule_setting(&self, device_uid: &UID, setting: &Setting) -> Result<()> {
-        if setting.temp_source.is_none() || setting.speed_profile.is_none() {
+        let (normalized_setting, metadata) = self.compile_setting(device_uid, setting).await?;
+        self.remove_fan_group_member(device_uid, &setting.channel_name).await;
+        self.scheduled_settings.write().await
+            .entry(device_uid.clone())
+            .or_insert(HashMap::new())
+            .insert(setting.channel_name.clone(), normalized_setting);
+        self.scheduled_settings_metadata.write().await
+            .entry(device_uid.clone())
+            .or_insert(HashMap::new())
+            .insert(setting.channel_name.clone(), metadata);
+        Ok(())
+    }
+
+    /// Validates and normalizes a setting for scheduling, and creates its initial metadata.
+    async fn compile_setting(&self, device_uid: &UID, setting: &Setting) -> Result<(Setting, SettingMetadata)> {
+        if setting.temp_source.is_none()
+            || (setting.speed_profile.is_none() && setting.speed_pid.is_none()) {
             return Err(anyhow!("Not enough info to schedule a manual speed profile"));
         }
         let temp_source = setting.temp_source.as_ref().unwrap();
@@ -68,33 +107,45 @@ impl SpeedScheduler {
         let max_temp = temp_source_device.read().await.info.as_ref().map_or(100, |info| info.temp_max);
         let device_to_schedule = self.all_devices.get(device_uid)
             .with_context(|| format!("Target Device to schedule speed must be present: {}", device_uid))?;
-        let max_duty = device_to_schedule.read().await.info.as_ref()
+        let speed_options = device_to_schedule.read().await.info.as_ref()
             .with_context(|| format!("Device Info must be present for target device: {}", device_uid))?
             .channels.get(setting.channel_name.as_str())
             .with_context(|| format!("Channel Info for channel: {} in setting must be present for target device: {}", setting.channel_name, device_uid))?
-            .speed_options.as_ref()
-            .with_context(|| format!("Speed Options must be present for target device: {}", device_uid))?
-            .max_duty;
-        let normalized_profile = utils::normalize_profile(
-            setting.speed_profile.as_ref().unwrap(),
-            max_temp,
-            max_duty,
-        );
+            .speed_options.clone()
+            .with_context(|| format!("Speed Options must be present for target device: {}", device_uid))?;
+        if let Some(feed_forward) = &setting.speed_feed_forward {
+            self.all_devices.get(feed_forward.device_uid.as_str())
+                .with_context(|| format!("Feed-forward Device must currently be present to schedule speed: {}", feed_forward.device_uid))?;
+            if feed_forward.gain < 0. || feed_forward.rate_gain < 0. {
+                return Err(anyhow!("Feed-forward gains must not be negative: {:?}", feed_forward));
+            }
+            if feed_forward.threshold > 100 || feed_forward.max_boost > 100 {
+                return Err(anyhow!("Feed-forward threshold and max_boost must be values between 0-100: {:?}", feed_forward));
+            }
+        }
+        let mut metadata = SettingMetadata::new();
+        // a target temperature takes precedence over a speed profile
+        let normalized_profile = if let Some(pid_settings) = &setting.speed_pid {
+            metadata.pid_controller = Some(PidController::new(
+                pid_settings.clone(), speed_options.min_duty, speed_options.max_duty,
+            ));
+            None
+        } else {
+            Some(utils::normalize_profile(
+                setting.speed_profile.as_ref().unwrap(),
+                max_temp,
+                speed_options.max_duty,
+            ))
+        };
         let normalized_setting = Setting {
             channel_name: setting.channel_name.clone(),
-            speed_profile: Some(normalized_profile),
+            speed_profile: normalized_profile,
             temp_source: Some(temp_source.clone()),
+            speed_feed_forward: setting.speed_feed_forward.clone(),
+            speed_pid: setting.speed_pid.clone(),
             ..Default::default()
         };
-        self.scheduled_settings.write().await
-            .entry(device_uid.clone())
-            .or_insert(HashMap::new())
-            .insert(setting.channel_name.clone(), normalized_setting);
-        self.scheduled_settings_metadata.write().await
-            .entry(device_uid.clone())
-            .or_insert(HashMap::new())
-            .insert(setting.channel_name.clone(), SettingMetadata::new());
-        Ok(())
+        Ok((normalized_setting, metadata))
     }
 
     pub async fn clear_channel_setting(&self, device_uid: &UID, channel_name: &str) {
@@ -104,18 +155,291 @@ impl SpeedScheduler {
         if let Some(device_channel_settings) = self.scheduled_settings_metadata.write().await.get_mut(device_uid) {
             device_channel_settings.remove(channel_name);
         }
+        self.remove_fan_group_member(device_uid, channel_name).await;
+    }
+
+    /// Schedules a fan group, replacing any group with the same name.
+    /// Member channels are removed from their individual schedules and any other fan group,
+    /// as a channel can only be controlled by one setting at a time.
+    pub async fn schedule_fan_group(&self, fan_group: &FanGroup) -> Result<()> {
+        if fan_group.members.is_empty() {
+            return Err(anyhow!("A fan group needs at least one member: {}", fan_group.name));
+        }
+        let temp_source = &fan_group.temp_source;
+        let temp_source_device = self.all_devices.get(temp_source.device_uid.as_str())
+            .with_context(|| format!("temp_source Device must currently be present to schedule a fan group: {}", temp_source.device_uid))?;
+        let max_temp = temp_source_device.read().await.info.as_ref().map_or(100, |info| info.temp_max);
+        let mut members = Vec::new();
+        let mut max_duty = u8::MAX;
+        for member in fan_group.members.iter() {
+            let member_device = self.all_devices.get(member.device_uid.as_str())
+                .with_context(|| format!("Fan group member Device must be present: {}", member.device_uid))?;
+            let member_device = member_device.read().await;
+            let speed_options = member_device.info.as_ref()
+                .with_context(|| format!("Device Info must be present for fan group member: {}", member.device_uid))?
+                .channels.get(member.channel_name.as_str())
+                .with_context(|| format!("Channel Info for channel: {} must be present for fan group member: {}", member.channel_name, member.device_uid))?
+                .speed_options.as_ref()
+                .with_context(|| format!("Speed Options must be present for fan group member: {}", member.device_uid))?;
+            if !speed_options.fixed_enabled {
+                return Err(anyhow!("Fixed speeds are not enabled for fan group member: {} channel: {}", member.device_uid, member.channel_name));
+            }
+            max_duty = max_duty.min(speed_options.max_duty);
+            members.push((member.device_uid.clone(), member.channel_name.clone(), member_device.d_type.clone()));
+        }
+        let normalized_setting = Setting {
+            channel_name: fan_group.name.clone(),
+            speed_profile: Some(utils::normalize_profile(&fan_group.speed_profile, max_temp, max_duty)),
+            temp_source: Some(temp_source.clone()),
+            ..Default::default()
+        };
+        for (device_uid, channel_name, _) in members.iter() {
+            self.clear_channel_setting(device_uid, channel_name).await;
+        }
+        self.fan_groups.write().await.insert(
+            fan_group.name.clone(),
+            ScheduledFanGroup {
+                members,
+                setting: normalized_setting,
+                metadata: SettingMetadata::new(),
+            },
+        );
+        Ok(())
+    }
+
+    pub async fn clear_fan_group(&self, group_name: &str) {
+        self.fan_groups.write().await.remove(group_name);
+    }
+
+    /// Only the scheduled fan groups are changed. The config is changed by the caller when the user
+    /// moves the channel out of its group, as replaying saved settings, for ex. on boot or wake,
+    /// and rescheduling a group also pass through here.
+    async fn remove_fan_group_member(&self, device_uid: &UID, channel_name: &str) {
+        let mut fan_groups = self.fan_groups.write().await;
+        for fan_group in fan_groups.values_mut() {
+            fan_group.members.retain(|(member_uid, member_channel_name, _)|
+                member_uid != device_uid || member_channel_name != channel_name
+            );
+        }
+        fan_groups.retain(|_, fan_group| !fan_group.members.is_empty());
+    }
+
+    /// Prepares a profile set so that switching to it is cheap: every scheduled curve is normalized
+    /// here once. Settings that are handled by the hardware itself, like fixed speeds, hardware
+    /// profiles, lighting and LCD, are kept to be applied directly. LCD sensor screens and lighting
+    /// effects are kept with them, and are handed to their schedulers on activation.
+    pub async fn compile_profile_set(&self, profile_set: &ProfileSet) -> Result<()> {
+        let mut scheduled = HashMap::new();
+        let mut direct = Vec::new();
+        for (device_uid, setting) in profile_set.settings.iter() {
+            if setting.reset_to_default.unwrap_or(false) {
+                return Err(anyhow!("reset_to_default is not supported in Profile Set: {}", profile_set.name));
+            }
+            let device_lock = self.all_devices.get(device_uid)
+                .with_context(|| format!("Profile Set Device must currently be present: {}", device_uid))?;
+            if self.needs_scheduling(device_uid, setting).await {
+                scheduled.entry(device_uid.clone())
+                    .or_insert_with(HashMap::new)
+                    .insert(setting.channel_name.clone(), self.compile_setting(device_uid, setting).await?);
+            } else {
+                let device_type = device_lock.read().await.d_type.clone();
+                direct.push((device_type, device_uid.clone(), setting.clone()));
+            }
+        }
+        self.profile_sets.write().await.insert(
+            profile_set.name.clone(),
+            Arc::new(CompiledProfileSet { name: profile_set.name.clone(), scheduled, direct }),
+        );
+        Ok(())
+    }
+
+    /// Speed profiles are only scheduled when the hardware doesn't support them itself.
+    async fn needs_scheduling(&self, device_uid: &UID, setting: &Setting) -> bool {
+        if setting.speed_fixed.is_some() {
+            false
+        } else if setting.speed_pid.is_some() {
+            true
+        } else if setting.speed_profile.is_some() {
+            let profiles_enabled = match self.all_devices.get(device_uid) {
+                Some(device_lock) => device_lock.read().await.info.as_ref()
+                    .and_then(|info| info.channels.get(&setting.channel_name))
+                    .and_then(|channel_info| channel_info.speed_options.as_ref())
+                    .map_or(false, |speed_options| speed_options.profiles_enabled),
+                None => false,
+            };
+            !profiles_enabled
+        } else {
+            false
+        }
+    }
+
+    pub async fn profile_set_names(&self) -> Vec<String> {
+        let mut names: Vec<String> = self.profile_sets.read().await.keys().cloned().collect();
+        names.sort();
+        names
+    }
+
+    pub async fn active_profile_set_name(&self) -> Option<String> {
+        self.active_profile_set.read().await.as_ref()
+            .map(|profile_set| profile_set.name.clone())
+    }
+
+    /// Called when settings are changed outside of a profile set, after which the hardware state
+    /// no longer matches the active set. It is also cleared in the config, so that the set
+    /// doesn't override the changed settings on the next start or wake. The caller saves the config.
+    pub async fn clear_active_profile_set(&self) {
+        *self.active_profile_set.write().await = None;
+        self.config.clear_active_profile_set().await;
+    }
+
+    /// Switches to a prepared profile set. The scheduled settings of the set's channels are swapped in
+    /// at once, and only the direct settings that differ from the previously active set are written.
+    /// Channels that are not part of the set keep their current settings.
+    pub async fn activate_profile_set(&self, set_name: &str) -> Result<()> {
+        let profile_set = self.profile_sets.read().await.get(set_name).cloned()
+            .with_context(|| format!("Profile Set not found: {}", set_name))?;
+        let previous_set = self.active_profile_set.write().await.replace(Arc::clone(&profile_set));
+        for (_, device_uid, setting) in profile_set.direct.iter() {
+            self.remove_fan_group_member(device_uid, &setting.channel_name).await;
+        }
+        for (device_uid, channel_settings) in profile_set.scheduled.iter() {
+            for channel_name in channel_settings.keys() {
+                self.remove_fan_group_member(device_uid, channel_name).await;
+            }
+        }
+        {
+            let mut scheduled_settings = self.scheduled_settings.write().await;
+            let mut scheduled_metadata = self.scheduled_settings_metadata.write().await;
+            for (_, device_uid, setting) in profile_set.direct.iter() {
+                if let Some(channel_settings) = scheduled_settings.get_mut(device_uid) {
+                    channel_settings.remove(&setting.channel_name);
+                }
+                if let Some(channel_metadata) = scheduled_metadata.get_mut(device_uid) {
+                    channel_metadata.remove(&setting.channel_name);
+                }
+            }
+            for (device_uid, channel_settings) in profile_set.scheduled.iter() {
+                let device_settings = scheduled_settings.entry(device_uid.clone())
+                    .or_insert_with(HashMap::new);
+                let device_metadata = scheduled_metadata.entry(device_uid.clone())
+                    .or_insert_with(HashMap::new);
+                for (channel_name, (setting, metadata)) in channel_settings.iter() {
+                    // an unchanged setting keeps its metadata, so the current duty isn't re-applied
+                    if device_settings.get(channel_name) == Some(setting) {
+                        continue;
+                    }
+                    device_settings.insert(channel_name.clone(), setting.clone());
+                    device_metadata.insert(channel_name.clone(), metadata.clone());
+                }
+            }
+        }
+        let mut settings_to_apply: HashMap<DeviceType, Vec<(UID, Setting)>> = HashMap::new();
+        let mut error_count = 0;
+        for direct_setting in profile_set.direct.iter() {
+            let already_applied = previous_set.as_ref()
+                .map_or(false, |previous| previous.direct.contains(direct_setting));
+            if already_applied {
+                continue;
+            }
+            let (device_type, device_uid, setting) = direct_setting;
+            match self.schedule_lcd_or_lighting(device_uid, setting).await {
+                Ok(true) => continue,
+                Ok(false) => settings_to_apply.entry(device_type.clone())
+                    .or_insert_with(Vec::new)
+                    .push((device_uid.clone(), setting.clone())),
+                Err(err) => {
+                    error!("Error scheduling Profile Set setting: {}", err);
+                    error_count += 1;
+                }
+            }
+        }
+        for (device_type, settings) in settings_to_apply {
+            let repo = match self.repos.get(&device_type) {
+                Some(repo) => repo,
+                None => {
+                    error_count += settings.len();
+                    continue;
+                }
+            };
+            for (device_uid, setting) in settings.iter() {
+                info!("Applying Profile Set: {} setting for device: {}", set_name, device_uid);
+                debug!("Applying Profile Set setting: {:?}", setting);
+            }
+            for result in repo.apply_settings_batch(&settings).await {
+                if let Err(err) = result {
+                    error!("Error applying Profile Set setting: {}", err);
+                    error_count += 1;
+                }
+            }
+        }
+        if error_count > 0 {
+            // the hardware state is unknown, so the next switch should write everything
+            *self.active_profile_set.write().await = None;
+            Err(anyhow!("{} setting(s) of Profile Set: {} could not be applied", error_count, set_name))
+        } else {
+            Ok(())
+        }
+    }
+
+    /// LCD sensor screens and lighting effects are rendered by the daemon, so they are handed to
+    /// their schedulers the same way as in DeviceCommander. Other LCD and lighting settings replace
+    /// what is scheduled for the channel and are applied directly.
+    /// Returns true when the setting has been scheduled.
+    async fn schedule_lcd_or_lighting(&self, device_uid: &UID, setting: &Setting) -> Result<bool> {
+        if let Some(lcd_settings) = &setting.lcd {
+            if lcd_settings.mode == SENSORS_MODE {
+                self.lcd_scheduler.schedule_setting(device_uid, setting).await?;
+                return Ok(true);
+            }
+            self.lcd_scheduler.clear_channel_setting(device_uid, &setting.channel_name).await;
+        } else if let Some(lighting) = &setting.lighting {
+            if is_effect_mode(&lighting.mode) {
+                self.lighting_scheduler.schedule_setting(device_uid, setting).await?;
+                return Ok(true);
+            }
+            self.lighting_scheduler.clear_for_device_mode(device_uid, &setting.channel_name).await;
+        }
+        Ok(false)
     }
 
     pub async fn update_speed(&self) {
+        let handle_dynamic_temps = match self.config.get_settings().await {
+            Ok(cooler_control_settings) => cooler_control_settings.handle_dynamic_temps,
+            Err(err) => {
+                error!("Could not read CoolerControl configuration settings: {}", err);
+                return;
+            }
+        };
+        let mut settings_to_apply: HashMap<DeviceType, Vec<(UID, Setting)>> = HashMap::new();
+        let mut tick_source_temps: HashMap<TempSourceKey, Option<f64>> = HashMap::new();
         for (device_uid, channel_settings) in self.scheduled_settings.read().await.iter() {
             for (channel_name, scheduler_setting) in channel_settings {
                 if scheduler_setting.temp_source.is_none() {
                     continue;
                 }
-                if let Some(current_source_temp) = self.get_source_temp(scheduler_setting).await {
-                    let duty_to_set = utils::interpolate_profile(scheduler_setting.speed_profile.as_ref().unwrap(), current_source_temp);
+                if let Some(current_source_temp) = self.get_source_temp(
+                    scheduler_setting.temp_source.as_ref().unwrap(),
+                    handle_dynamic_temps,
+                    &mut tick_source_temps,
+                ).await {
+                    let (calculated_duty, max_duty) = if scheduler_setting.speed_pid.is_some() {
+                        self.calculate_pid_duty(device_uid, channel_name, current_source_temp).await
+                    } else {
+                        let profile = scheduler_setting.speed_profile.as_ref().unwrap();
+                        (
+                            utils::interpolate_profile(profile, current_source_temp),
+                            profile.last().map_or(100, |(_, duty)| *duty)
+                        )
+                    };
+                    let duty_to_set = self.add_feed_forward_boost(
+                        device_uid, scheduler_setting, calculated_duty, max_duty,
+                    ).await;
                     if self.duty_is_above_threshold(device_uid, scheduler_setting, duty_to_set).await {
-                        self.set_speed(device_uid, scheduler_setting, duty_to_set).await;
+                        let fixed_setting = self.prepare_speed_setting(device_uid, scheduler_setting, duty_to_set).await;
+                        let device_type = self.all_devices[device_uid].read().await.d_type.clone();
+                        settings_to_apply.entry(device_type)
+                            .or_insert_with(Vec::new)
+                            .push((device_uid.clone(), fixed_setting));
                     } else {
                         self.scheduled_settings_metadata.write().await.get_mut(device_uid).unwrap()
                             .get_mut(channel_name).unwrap().under_threshold_counter += 1;
@@ -127,43 +451,196 @@ impl SpeedScheduler {
                 }
             }
         }
+        self.collect_fan_group_settings(handle_dynamic_temps, &mut tick_source_temps, &mut settings_to_apply).await;
+        // drop the averages of temp sources that are no longer used:
+        self.temp_source_averages.write().await
+            .retain(|key, _| tick_source_temps.contains_key(key));
+        self.apply_speed_settings(settings_to_apply).await;
+    }
+
+    /// Returns the current temp of the temp source, calculating it only once per tick.
+    /// All channels that use the same temp source share the result.
+    async fn get_source_temp(
+        &self,
+        temp_source: &TempSource,
+        handle_dynamic_temps: bool,
+        tick_source_temps: &mut HashMap<TempSourceKey, Option<f64>>,
+    ) -> Option<f64> {
+        let key = TempSourceKey {
+            device_uid: temp_source.device_uid.clone(),
+            temp_name: temp_source.temp_name.clone(),
+        };
+        if let Some(source_temp) = tick_source_temps.get(&key) {
+            return *source_temp;
+        }
+        let source_temp = self.calculate_source_temp(&key, handle_dynamic_temps).await;
+        tick_source_temps.insert(key, source_temp);
+        source_temp
     }
 
-    async fn get_source_temp(&self, setting: &Setting) -> Option<f64> {
-        if let Some(temp_source_device_lock) = self.all_devices
-            .get(setting.temp_source.as_ref().unwrap().device_uid.as_str()) {
+    async fn calculate_source_temp(&self, key: &TempSourceKey, handle_dynamic_temps: bool) -> Option<f64> {
+        if let Some(temp_source_device_lock) = self.all_devices.get(key.device_uid.as_str()) {
             let temp_source_device = temp_source_device_lock.read().await;
-            let mut temps = temp_source_device.status_history.iter().rev()
-                // we only need the last (sample_size ) temps for EMA:
+            let temp_source_device_type = &temp_source_device.d_type;
+            let find_temp = |status: &Status| status.temps.iter()
+                .find(|temp_status| temp_status.name == key.temp_name)
+                .map(|temp_status| temp_status.temp);
+            if !handle_dynamic_temps
+                // in the future this will be controllable by config settings:
+                || (temp_source_device_type != &DeviceType::CPU && temp_source_device_type != &DeviceType::GPU)
+            {
+                return temp_source_device.status_history.iter().rev()
+                    .take(utils::SAMPLE_SIZE as usize)
+                    .find_map(find_temp);
+            }
+            let mut source_averages = self.temp_source_averages.write().await;
+            let last_timestamp = source_averages.get(key)
+                .map(|source_average| source_average.last_timestamp);
+            // we only need the statuses since the last tick, up to sample_size, for the EMA:
+            let new_statuses = temp_source_device.status_history.iter().rev()
                 .take(utils::SAMPLE_SIZE as usize)
-                .flat_map(|status| status.temps.as_slice())
-                .filter(|temp_status| temp_status.name == setting.temp_source.as_ref().unwrap().temp_name)
-                .map(|temp_status| temp_status.temp)
+                .take_while(|status|
+                    last_timestamp.map_or(true, |timestamp| status.timestamp > timestamp)
+                )
+                .collect::<Vec<&Status>>();
+            // when sample_size statuses are new, the average is recalculated from them:
+            let needs_reset = last_timestamp.is_none()
+                || new_statuses.len() >= utils::SAMPLE_SIZE as usize;
+            let newest_timestamp = match new_statuses.first() {
+                Some(status) => status.timestamp,
+                None => return source_averages.get(key)
+                    .map(|source_average| source_average.average.current()),
+            };
+            let mut new_temps = new_statuses.into_iter()
+                .filter_map(find_temp)
                 .collect::<Vec<f64>>();
-            temps.reverse(); // re-order temps so last is last
-            if temps.is_empty() {
-                return None;
-            }
-            let temp_source_device_type = &temp_source_device.d_type;
-            match self.config.get_settings().await {
-                Ok(cooler_control_settings) => {
-                    if cooler_control_settings.handle_dynamic_temps
-                        // in the future this will be controllable by config settings:
-                        && (temp_source_device_type == &DeviceType::CPU || temp_source_device_type == &DeviceType::GPU)
-                    {
-                        Some(utils::current_temp_from_exponential_moving_average(&temps))
-                    } else {
-                        Some(temps.last().unwrap().clone())
+            new_temps.reverse(); // re-order temps so last is last
+            if !needs_reset {
+                if let Some(source_average) = source_averages.get_mut(key) {
+                    for temp in new_temps {
+                        source_average.average.next(temp);
                     }
-                }
-                Err(err) => {
-                    error!("Could not read CoolerControl configuration settings: {}", err);
-                    None
+                    source_average.last_timestamp = newest_timestamp;
+                    return Some(source_average.average.current());
                 }
             }
+            if new_temps.is_empty() {
+                source_averages.remove(key);
+                return None;
+            }
+            let average = TempMovingAverage::new(&new_temps);
+            let current_temp = average.current();
+            source_averages.insert(
+                key.clone(),
+                TempSourceAverage { average, last_timestamp: newest_timestamp },
+            );
+            Some(current_temp)
         } else {
             error!("Temperature Source Device for Speed Scheduler is currently not present: {}",
-                setting.temp_source.as_ref().unwrap().device_uid);
+                key.device_uid);
+            None
+        }
+    }
+
+    /// Evaluates each fan group's profile once, and adds a fixed speed setting for every member
+    /// channel, so that the members of a device are applied together.
+    async fn collect_fan_group_settings(
+        &self,
+        handle_dynamic_temps: bool,
+        tick_source_temps: &mut HashMap<TempSourceKey, Option<f64>>,
+        settings_to_apply: &mut HashMap<DeviceType, Vec<(UID, Setting)>>,
+    ) {
+        for (group_name, fan_group) in self.fan_groups.write().await.iter_mut() {
+            let current_source_temp = match self.get_source_temp(
+                fan_group.setting.temp_source.as_ref().unwrap(),
+                handle_dynamic_temps,
+                tick_source_temps,
+            ).await {
+                Some(temp) => temp,
+                None => continue,
+            };
+            let duty_to_set = utils::interpolate_profile(
+                fan_group.setting.speed_profile.as_ref().unwrap(), current_source_temp,
+            );
+            let metadata = &mut fan_group.metadata;
+            if let Some(last_duty) = metadata.last_manual_speeds_set.back() {
+                let threshold = if metadata.under_threshold_counter < MAX_UNDER_THRESHOLD_COUNTER {
+                    APPLY_DUTY_THRESHOLD
+                } else { 0 };
+                if duty_to_set.abs_diff(*last_duty) <= threshold {
+                    metadata.under_threshold_counter += 1;
+                    debug!("Duty not above threshold to be applied to fan group: {}. Skipping", group_name);
+                    continue;
+                }
+            }
+            metadata.last_manual_speeds_set.push_back(duty_to_set);
+            metadata.under_threshold_counter = 0;
+            if metadata.last_manual_speeds_set.len() > MAX_SAMPLE_SIZE {
+                metadata.last_manual_speeds_set.pop_front();
+            }
+            for (device_uid, channel_name, device_type) in fan_group.members.iter() {
+                settings_to_apply.entry(device_type.clone())
+                    .or_insert_with(Vec::new)
+                    .push((device_uid.clone(), Setting {
+                        channel_name: channel_name.clone(),
+                        speed_fixed: Some(duty_to_set),
+                        temp_source: fan_group.setting.temp_source.clone(),
+                        ..Default::default()
+                    }));
+            }
+        }
+    }
+
+    /// Runs the channel's PID controller with the current temp and returns the duty and max duty.
+    async fn calculate_pid_duty(&self, device_uid: &UID, channel_name: &str, current_source_temp: f64) -> (u8, u8) {
+        let mut metadata_lock = self.scheduled_settings_metadata.write().await;
+        let pid_controller = metadata_lock.get_mut(device_uid).unwrap()
+            .get_mut(channel_name).unwrap()
+            .pid_controller.as_mut().unwrap();  // set when scheduled
+        let duty = pid_controller.update(current_source_temp);
+        debug!("PID duty of {} calculated for temp: {}", duty, current_source_temp);
+        (duty, pid_controller.max_duty())
+    }
+
+    /// Adds the feed-forward boost, if set, to the calculated duty.
+    /// The boost is held and decays over the following status updates.
+    /// The result is limited to the given max duty.
+    async fn add_feed_forward_boost(
+        &self, device_uid: &UID, scheduler_setting: &Setting, calculated_duty: u8, max_duty: u8,
+    ) -> u8 {
+        if let Some(feed_forward) = &scheduler_setting.speed_feed_forward {
+            if let Some((signal, previous_signal)) = self.get_feed_forward_signal(feed_forward).await {
+                let boost = utils::feed_forward_boost(feed_forward, signal, previous_signal);
+                let held_boost = {
+                    let mut metadata_lock = self.scheduled_settings_metadata.write().await;
+                    let metadata = metadata_lock.get_mut(device_uid).unwrap()
+                        .get_mut(&scheduler_setting.channel_name).unwrap();
+                    metadata.feed_forward_boost = utils::held_feed_forward_boost(boost, metadata.feed_forward_boost);
+                    metadata.feed_forward_boost.round() as u8
+                };
+                debug!("Feed-forward boost of {} (held: {}) for signal: {} previous: {:?}", boost, held_boost, signal, previous_signal);
+                return calculated_duty.saturating_add(held_boost).min(max_duty.max(calculated_duty));
+            }
+        }
+        calculated_duty
+    }
+
+    /// Returns the current and previous value of the feed-forward signal channel.
+    async fn get_feed_forward_signal(&self, feed_forward: &FeedForward) -> Option<(f64, Option<f64>)> {
+        if let Some(signal_device_lock) = self.all_devices.get(feed_forward.device_uid.as_str()) {
+            let signal_device = signal_device_lock.read().await;
+            let mut signals = signal_device.status_history.iter().rev()
+                .take(2)
+                .filter_map(|status|
+                    status.channels.iter()
+                        .find(|channel_status| channel_status.name == feed_forward.channel_name)
+                        .and_then(|channel_status| channel_status.duty)
+                );
+            let signal = signals.next()?;
+            Some((signal, signals.next()))
+        } else {
+            error!("Feed-forward Device for Speed Scheduler is currently not present: {}",
+                feed_forward.device_uid);
             None
         }
     }
@@ -207,7 +684,8 @@ impl SpeedScheduler {
         }
     }
 
-    async fn set_speed(&self, device_uid: &UID, scheduler_setting: &Setting, duty_to_set: u8) {
+    /// Records the duty to be applied and returns the fixed speed setting for it.
+    async fn prepare_speed_setting(&self, device_uid: &UID, scheduler_setting: &Setting, duty_to_set: u8) -> Setting {
         let fixed_setting = Setting {
             channel_name: scheduler_setting.channel_name.clone(),
             speed_fixed: Some(duty_to_set),
@@ -215,27 +693,66 @@ impl SpeedScheduler {
             pwm_mode: scheduler_setting.pwm_mode.clone(),
             ..Default::default()
         };
-        {
-            let mut metadata_lock = self.scheduled_settings_metadata.write().await;
-            let mut metadata = metadata_lock.get_mut(device_uid).unwrap()
-                .get_mut(&scheduler_setting.channel_name).unwrap();
-            metadata.last_manual_speeds_set.push_back(duty_to_set);
-            metadata.under_threshold_counter = 0;
-            if metadata.last_manual_speeds_set.len() > MAX_SAMPLE_SIZE {
-                metadata.last_manual_speeds_set.pop_front();
-            }
+        let mut metadata_lock = self.scheduled_settings_metadata.write().await;
+        let mut metadata = metadata_lock.get_mut(device_uid).unwrap()
+            .get_mut(&scheduler_setting.channel_name).unwrap();
+        metadata.last_manual_speeds_set.push_back(duty_to_set);
+        metadata.under_threshold_counter = 0;
+        if metadata.last_manual_speeds_set.len() > MAX_SAMPLE_SIZE {
+            metadata.last_manual_speeds_set.pop_front();
         }
-        let device_type = &self.all_devices[device_uid].read().await.d_type;
-        info!("Applying scheduled speed setting for device: {}", device_uid);
-        debug!("Applying scheduled speed setting: {:?}", fixed_setting);
-        if let Some(repo) = self.repos.get(device_type) {
-            if let Err(err) = repo.apply_setting(device_uid, &fixed_setting).await {
-                error!("Error applying scheduled speed setting: {}", err);
+        fixed_setting
+    }
+
+    /// Applies all the speed settings of this tick together, per repository,
+    /// so that repositories are able to combine their hardware writes.
+    async fn apply_speed_settings(&self, settings_to_apply: HashMap<DeviceType, Vec<(UID, Setting)>>) {
+        for (device_type, settings) in settings_to_apply {
+            if let Some(repo) = self.repos.get(&device_type) {
+                for (device_uid, fixed_setting) in settings.iter() {
+                    info!("Applying scheduled speed setting for device: {}", device_uid);
+                    debug!("Applying scheduled speed setting: {:?}", fixed_setting);
+                }
+                for result in repo.apply_settings_batch(&settings).await {
+                    if let Err(err) = result {
+                        error!("Error applying scheduled speed setting: {}", err);
+                    }
+                }
             }
         }
     }
 }
 
+/// A profile set prepared for switching. Scheduled settings hold their normalized setting and
+/// initial metadata per device and channel. Direct settings are applied by the repositories,
+/// or by the LCD and lighting schedulers for the settings that the daemon renders.
+struct CompiledProfileSet {
+    name: String,
+    scheduled: HashMap<UID, HashMap<String, (Setting, SettingMetadata)>>,
+    direct: Vec<(DeviceType, UID, Setting)>,
+}
+
+/// A fan group with its normalized profile, members (device_uid, channel_name, device_type),
+/// and a single metadata for all members.
+struct ScheduledFanGroup {
+    members: Vec<(UID, String, DeviceType)>,
+    setting: Setting,
+    metadata: SettingMetadata,
+}
+
+/// Identifies a temp source, which can be shared by many scheduled channels
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+struct TempSourceKey {
+    device_uid: UID,
+    temp_name: String,
+}
+
+/// The moving average of a dynamic temp source, updated incrementally each tick
+struct TempSourceAverage {
+    average: TempMovingAverage,
+    last_timestamp: DateTime<Local>,
+}
+
 /// This is used by the SpeedScheduler for help in deciding exactly when to apply a setting
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct SettingMetadata {
@@ -248,6 +765,14 @@ pub struct SettingMetadata {
     /// the apply-threshold. This helps mitigate issues where the duty is 1% off target for a long time.
     #[serde(skip_serializing, skip_deserializing)]
     pub under_threshold_counter: usize,
+
+    /// (internal use) the controller state for target temperature settings.
+    #[serde(skip_serializing, skip_deserializing)]
+    pub pid_controller: Option<PidController>,
+
+    /// (internal use) the feed-forward boost that is held and decays between status updates.
+    #[serde(skip_serializing, skip_deserializing)]
+    pub feed_forward_boost: f64,
 }
 
 impl SettingMetadata {
@@ -255,6 +780,87 @@ impl SettingMetadata {
         Self {
             last_manual_speeds_set: VecDeque::with_capacity(MAX_SAMPLE_SIZE + 1),
             under_threshold_counter: 0,
+            pid_controller: None,
+            feed_forward_boost: 0.,
         }
     }
-}
\ No newline at end of file
+}
+
+/// Tests
+#[cfg(test)]
+mod tests {
+    use std::path::PathBuf;
+
+    use crate::device::{ChannelInfo, Device, DeviceInfo, SpeedOptions};
+
+    use super::*;
+
+    fn fan_device() -> Device {
+        let fan_channel = ChannelInfo {
+            speed_options: Some(SpeedOptions {
+                fixed_enabled: true,
+                ..Default::default()
+            }),
+            ..Default::default()
+        };
+        Device::new(
+            "NZXT Smart Device V2".to_string(),
+            DeviceType::Liquidctl,
+            1,
+            None,
+            Some(DeviceInfo {
+                channels: HashMap::from([
+                    ("fan1".to_string(), fan_channel.clone()),
+                    ("fan2".to_string(), fan_channel),
+                ]),
+                temp_max: 60,
+                ..Default::default()
+            }),
+            None,
+            None,
+        )
+    }
+
+    fn speed_scheduler(device: Device, config: Arc<Config>) -> SpeedScheduler {
+        let all_devices: AllDevices = Arc::new(HashMap::from([
+            (device.uid.clone(), Arc::new(RwLock::new(device)))
+        ]));
+        SpeedScheduler::new(
+            all_devices.clone(),
+            HashMap::new(),
+            Arc::new(LcdScheduler::new(all_devices.clone(), HashMap::new())),
+            Arc::new(LightingScheduler::new(all_devices.clone(), HashMap::new())),
+            config,
+        )
+    }
+
+    #[tokio::test]
+    async fn rescheduling_a_fan_group_keeps_it_in_the_config() {
+        // given:
+        let device = fan_device();
+        let device_uid = device.uid.clone();
+        let config = Arc::new(Config::from_contents(
+            PathBuf::from("/tmp/coolercontrol-tests-config.toml"),
+            &format!(
+                "[fan-groups]\n\
+                case = {{ members = [[\"{uid}\", \"fan1\"], [\"{uid}\", \"fan2\"]], \
+                speed_profile = [[20, 30], [50, 100]], \
+                temp_source = {{ temp_name = \"liquid\", device_uid = \"{uid}\" }} }}\n",
+                uid = device_uid
+            ),
+        ).unwrap());
+        let scheduler = speed_scheduler(device, config.clone());
+        let fan_group = config.get_fan_groups().await.unwrap().remove(0);
+
+        // when:
+        scheduler.schedule_fan_group(&fan_group).await.unwrap();
+        scheduler.schedule_fan_group(&fan_group).await.unwrap();
+
+        // then:
+        let fan_groups = config.get_fan_groups().await.unwrap();
+        assert_eq!(fan_groups.len(), 1);
+        assert_eq!(fan_groups[0].name, "case");
+        assert_eq!(fan_groups[0].members, fan_group.members);
+        assert_eq!(scheduler.fan_groups.read().await["case"].members.len(), 2);
+    }
+}
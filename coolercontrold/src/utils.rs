@@ -22,9 +22,14 @@ use std::collections::VecDeque;
 use yata::methods::{SMA, TMA};
 use yata::prelude::Method;
 
+use crate::setting::FeedForward;
+
 const TMA_WINDOW_SIZE: u8 = 8;
 pub const SMA_WINDOW_SIZE: u8 = 3;
 pub const SAMPLE_SIZE: isize = 16;
+/// The part of a feed-forward boost that is kept per status update,
+/// so that a boost fades out over about the 10 seconds temperatures need to follow a load step.
+const FEED_FORWARD_BOOST_DECAY: f64 = 0.8;
 
 /// Sort, cleanup, and set safety levels for the given profile[(temp, duty)].
 /// This will ensure that:
@@ -92,6 +97,27 @@ pub fn interpolate_profile(normalized_profile: &[(u8, u8)], temp_f64: f64) -> u8
     ).round() as u8
 }
 
+/// Calculates the duty boost from a load or power signal (0-100).
+/// The boost is proportional to the signal above the threshold, plus a term for how fast the
+/// signal is rising. The rising term reacts within one status update of a load spike,
+/// and goes away once the signal levels off and the temperature has caught up.
+/// Returned boost is rounded to the nearest integer
+pub fn feed_forward_boost(feed_forward: &FeedForward, signal: f64, previous_signal: Option<f64>) -> u8 {
+    let level_boost = (signal - feed_forward.threshold as f64).max(0.) * feed_forward.gain;
+    let rate_boost = previous_signal
+        .map_or(0., |previous| (signal - previous).max(0.) * feed_forward.rate_gain);
+    (level_boost + rate_boost)
+        .clamp(0., feed_forward.max_boost as f64)
+        .round() as u8
+}
+
+/// Holds a feed-forward boost over the time the temperature needs to catch up.
+/// A new boost replaces the previous one only if it is larger than what is left of the previous one,
+/// otherwise the previous boost decays, so that a load step doesn't just cause a single duty blip.
+pub fn held_feed_forward_boost(boost: u8, previous_held_boost: f64) -> f64 {
+    (boost as f64).max(previous_held_boost * FEED_FORWARD_BOOST_DECAY)
+}
+
 /// Computes a simple moving average from give values and returns the those averages.
 /// Simple is just a moving average with no weight. This is particularly helpful for graphing
 /// dynamic temperature sources like GPU as the constant fluctuations are smoothed out and the recent
@@ -114,6 +140,40 @@ pub fn current_temp_from_exponential_moving_average(all_temps: &[f64]) -> f64 {
     ).round() / 100.
 }
 
+/// Keeps the exponential moving average state of a single temperature source, so that each new
+/// temp is a single update instead of recalculating the average over all the samples.
+/// The current value matches current_temp_from_exponential_moving_average() over the last
+/// SAMPLE_SIZE temps, as the average depends on at most the last (2 * TMA_WINDOW_SIZE - 1) temps.
+#[derive(Debug, Clone)]
+pub struct TempMovingAverage {
+    tma: TMA,
+    current_temp: f64,
+}
+
+impl TempMovingAverage {
+    /// Will panic if initial_temps is empty.
+    pub fn new(initial_temps: &[f64]) -> Self {
+        let initial_temps = get_temps_slice(initial_temps);
+        let mut average = Self {
+            tma: TMA::new(TMA_WINDOW_SIZE, &initial_temps[0]).unwrap(),
+            current_temp: initial_temps[0],
+        };
+        for temp in initial_temps {
+            average.next(*temp);
+        }
+        average
+    }
+
+    pub fn next(&mut self, temp: f64) {
+        self.current_temp = self.tma.next(&temp);
+    }
+
+    /// Rounded to the nearest 100th decimal place
+    pub fn current(&self) -> f64 {
+        (self.current_temp * 100.).round() / 100.
+    }
+}
+
 fn get_temps_slice(all_temps: &[f64]) -> &[f64] {
     // keeping the sample size low allows the average to be more aggressive,
     // otherwise the actual reading and the EMA take quite a while before they are the same value
@@ -127,7 +187,8 @@ fn get_temps_slice(all_temps: &[f64]) -> &[f64] {
 
 #[cfg(test)]
 mod tests {
-    use crate::utils::{all_values_from_simple_moving_average, current_temp_from_exponential_moving_average, interpolate_profile, normalize_profile};
+    use crate::setting::FeedForward;
+    use crate::utils::{all_values_from_simple_moving_average, current_temp_from_exponential_moving_average, feed_forward_boost, interpolate_profile, normalize_profile, SAMPLE_SIZE, TempMovingAverage};
 
     #[test]
     fn normalize_profile_test() {
@@ -190,6 +251,47 @@ mod tests {
         }
     }
 
+    #[test]
+    fn feed_forward_boost_test() {
+        let feed_forward = FeedForward {
+            device_uid: "cpu".to_string(),
+            channel_name: "CPU Load".to_string(),
+            threshold: 30,
+            gain: 0.5,
+            rate_gain: 1.0,
+            max_boost: 30,
+        };
+        let given_expected = vec![
+            ((20., None), 0u8),  // under threshold
+            ((50., None), 10),
+            ((50., Some(50.)), 10),  // steady load
+            ((50., Some(70.)), 10),  // falling load has no rate boost
+            ((50., Some(40.)), 20),
+            ((100., Some(10.)), 30),  // limited to max_boost
+        ];
+        for (given, expected) in given_expected {
+            assert_eq!(
+                feed_forward_boost(&feed_forward, given.0, given.1),
+                expected
+            )
+        }
+    }
+
+    #[test]
+    fn held_feed_forward_boost_test() {
+        // a rate boost from a single load step, followed by steady load:
+        let boosts = [20u8, 10, 10, 10, 10, 10, 10];
+        let mut held_boost = 0.;
+        let mut held_boosts = Vec::new();
+        for boost in boosts {
+            held_boost = held_feed_forward_boost(boost, held_boost);
+            held_boosts.push(held_boost.round() as u8);
+        }
+        assert_eq!(held_boosts, vec![20, 16, 13, 10, 10, 10, 10]);
+        // a larger boost takes over right away:
+        assert_eq!(held_feed_forward_boost(25, 20.), 25.);
+    }
+
     #[test]
     fn current_temp_from_exponential_moving_average_test() {
         let given_expected: Vec<(&[f64], f64)> = vec![
@@ -216,6 +318,27 @@ mod tests {
         }
     }
 
+    #[test]
+    fn temp_moving_average_matches_recalculated_average_test() {
+        let all_temps: Vec<f64> = (0..40)
+            .map(|i| 40. + ((i * 7) % 13) as f64 + if i > 20 { 15. } else { 0. })
+            .collect();
+        let mut average = TempMovingAverage::new(&all_temps[..1]);
+        assert_eq!(average.current(), current_temp_from_exponential_moving_average(&all_temps[..1]));
+        for end in 2..=all_temps.len() {
+            average.next(all_temps[end - 1]);
+            let start = end.saturating_sub(SAMPLE_SIZE as usize);
+            let recalculated = current_temp_from_exponential_moving_average(&all_temps[start..end]);
+            // allow for floating point differences at the rounding boundary
+            assert!((average.current() - recalculated).abs() < 0.011)
+        }
+        // seeded from more than SAMPLE_SIZE temps:
+        assert_eq!(
+            TempMovingAverage::new(&all_temps).current(),
+            current_temp_from_exponential_moving_average(&all_temps)
+        )
+    }
+
     #[test]
     fn current_temp_from_simple_moving_average_test() {
         let given_expected: Vec<(&[f64], &[f64])> = vec![